@@ -0,0 +1,501 @@
+/*
+ * PCIe Simulator - Simulator Daemon
+ *
+ * Copyright (c) 2025 Karan Mamaniya <kmamaniya@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Hosts the simulated devices in a standalone process. Clients connect over
+ * a Unix socket, then submit descriptors through shared-memory SPSC rings
+ * with eventfd doorbells; each client is served by its own engine thread,
+ * optionally pinned to a dedicated CPU.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <getopt.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "../lib/pcie_sim.h"
+#include "../sim/simd.h"
+#include "vfio_user.h"
+
+#define SIMD_MAX_CPUS 256
+
+/* Daemon configuration */
+static const char *g_socket_path = SIMD_DEFAULT_SOCKET;
+static int g_cpus[SIMD_MAX_CPUS];
+static int g_num_cpus = 0;
+static int g_verbose = 0;
+static const char *g_vfio_user_path = NULL;
+static int g_vfio_user_device = 0;
+
+static volatile sig_atomic_t g_running = 1;
+static unsigned int g_next_engine = 0;
+
+/* One connected client and the engine thread serving it */
+struct simd_session {
+    int sock;
+    int submit_fd;
+    int complete_fd;
+    int device_id;
+    int cpu;                        /* -1 = unpinned */
+    pcie_sim_handle_t device;
+    struct simd_region *region;
+};
+
+static void simd_signal_handler(int sig)
+{
+    (void)sig;
+    g_running = 0;
+}
+
+/*
+ * Execute one descriptor against the hosted device model
+ */
+static void simd_execute(struct simd_session *s, const struct simd_desc *desc,
+                         struct simd_cqe *cqe)
+{
+    struct simd_region *r = s->region;
+    uint64_t latency = 0;
+
+    cqe->cookie = desc->cookie;
+    cqe->reserved = 0;
+    cqe->latency_ns = 0;
+
+    switch (desc->opcode) {
+    case SIMD_OP_TRANSFER:
+        if (desc->size == 0 || desc->offset > SIMD_DATA_SIZE ||
+            desc->size > SIMD_DATA_SIZE - desc->offset) {
+            cqe->status = PCIE_SIM_ERROR_PARAM;
+            break;
+        }
+        cqe->status = pcie_sim_transfer(s->device, r->data + desc->offset,
+                                        desc->size, desc->direction, &latency);
+        cqe->latency_ns = latency;
+        break;
+    case SIMD_OP_GET_STATS:
+        cqe->status = pcie_sim_get_stats(s->device, &r->stats);
+        break;
+    case SIMD_OP_GET_STATS_EX:
+    {
+        /* Build the result privately; the client can rewrite the region */
+        struct pcie_sim_stats_ex ex;
+
+        memset(&ex, 0, sizeof(ex));
+        ex.hdr.size = sizeof(ex);
+        ex.since_epoch = __atomic_load_n(&r->stats_ex.since_epoch, __ATOMIC_RELAXED);
+        cqe->status = pcie_sim_get_stats_ex(s->device, &ex);
+        memcpy(&r->stats_ex, &ex, sizeof(ex));
+        break;
+    }
+    case SIMD_OP_RESET_STATS:
+        cqe->status = pcie_sim_reset_stats_epoch(s->device, &r->epoch);
+        break;
+    default:
+        cqe->status = PCIE_SIM_ERROR_PARAM;
+        break;
+    }
+}
+
+/*
+ * Drain the submission ring, posting a completion for each descriptor
+ */
+static int simd_drain(struct simd_session *s)
+{
+    struct simd_region *r = s->region;
+    uint32_t sq_tail = r->sq.tail;
+    uint32_t cq_head = r->cq.head;
+    int done = 0;
+
+    while (sq_tail != __atomic_load_n(&r->sq.head, __ATOMIC_ACQUIRE)) {
+        struct simd_desc desc;
+
+        /* Leave the rest queued until the client reaps completions */
+        if (cq_head - __atomic_load_n(&r->cq.tail, __ATOMIC_ACQUIRE) >= SIMD_RING_ENTRIES)
+            break;
+
+        /*
+         * Validate and execute a private copy. The client can rewrite the
+         * entry at any time; the fence keeps the compiler from reloading it.
+         */
+        memcpy(&desc, &r->sq_entries[sq_tail & (SIMD_RING_ENTRIES - 1)], sizeof(desc));
+        __atomic_signal_fence(__ATOMIC_SEQ_CST);
+
+        simd_execute(s, &desc, &r->cq_entries[cq_head & (SIMD_RING_ENTRIES - 1)]);
+        sq_tail++;
+        cq_head++;
+        __atomic_store_n(&r->sq.tail, sq_tail, __ATOMIC_RELEASE);
+        __atomic_store_n(&r->cq.head, cq_head, __ATOMIC_RELEASE);
+        done++;
+    }
+
+    return done;
+}
+
+static void simd_session_free(struct simd_session *s)
+{
+    if (s->device)
+        pcie_sim_close(s->device);
+    if (s->region)
+        munmap(s->region, sizeof(*s->region));
+    if (s->submit_fd >= 0)
+        close(s->submit_fd);
+    if (s->complete_fd >= 0)
+        close(s->complete_fd);
+    close(s->sock);
+    free(s);
+}
+
+/*
+ * Engine thread: sleeps on the submission doorbell and the client socket.
+ * A socket hangup means the client exited (or crashed); the device model
+ * and its statistics stay alive in the daemon for the next client.
+ */
+static void *simd_engine(void *arg)
+{
+    struct simd_session *s = arg;
+    struct pollfd pfd[2];
+    uint64_t value = 1;
+
+    if (s->cpu >= 0) {
+        cpu_set_t set;
+
+        CPU_ZERO(&set);
+        CPU_SET(s->cpu, &set);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+            fprintf(stderr, "pcie_simd: cannot pin engine to CPU %d\n", s->cpu);
+    }
+
+    pfd[0].fd = s->submit_fd;
+    pfd[0].events = POLLIN;
+    pfd[1].fd = s->sock;
+    pfd[1].events = POLLIN;
+
+    while (g_running) {
+        int n = poll(pfd, 2, 500);
+
+        if (n < 0 && errno != EINTR)
+            break;
+        if (n > 0 && (pfd[1].revents & (POLLIN | POLLHUP | POLLERR)))
+            break;
+        if (n > 0 && (pfd[0].revents & POLLIN)) {
+            (void)!read(s->submit_fd, &value, sizeof(value));
+            if (simd_drain(s) > 0) {
+                value = 1;
+                (void)!write(s->complete_fd, &value, sizeof(value));
+            }
+        }
+    }
+
+    if (g_verbose)
+        printf("pcie_simd: client for device %d disconnected\n", s->device_id);
+
+    simd_session_free(s);
+    return NULL;
+}
+
+/*
+ * Send the welcome reply, with the region and doorbells attached on success
+ */
+static int simd_send_welcome(int sock, const struct simd_welcome *welcome, const int fds[3])
+{
+    char control[CMSG_SPACE(3 * sizeof(int))];
+    struct iovec iov = { (void *)welcome, sizeof(*welcome) };
+    struct msghdr msg;
+    struct cmsghdr *cmsg;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+
+    if (fds) {
+        memset(control, 0, sizeof(control));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(3 * sizeof(int));
+        memcpy(CMSG_DATA(cmsg), fds, 3 * sizeof(int));
+    }
+
+    return sendmsg(sock, &msg, MSG_NOSIGNAL) == (ssize_t)sizeof(*welcome) ? 0 : -1;
+}
+
+/*
+ * Handshake with a new client and start its engine thread
+ */
+static void simd_accept_client(int sock)
+{
+    struct simd_welcome welcome;
+    struct simd_hello hello;
+    struct simd_session *s;
+    struct timeval tv = { 1, 0 };
+    pthread_t thread;
+    int memfd = -1;
+    int fds[3];
+
+    memset(&welcome, 0, sizeof(welcome));
+
+    /* A client that never says hello must not stall the accept loop */
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    if (recv(sock, &hello, sizeof(hello), MSG_WAITALL) != (ssize_t)sizeof(hello) ||
+        hello.magic != SIMD_MAGIC || hello.version != SIMD_VERSION) {
+        welcome.status = PCIE_SIM_ERROR_PARAM;
+        simd_send_welcome(sock, &welcome, NULL);
+        close(sock);
+        return;
+    }
+
+    s = calloc(1, sizeof(*s));
+    if (!s) {
+        welcome.status = PCIE_SIM_ERROR_MEMORY;
+        simd_send_welcome(sock, &welcome, NULL);
+        close(sock);
+        return;
+    }
+    s->sock = sock;
+    s->submit_fd = -1;
+    s->complete_fd = -1;
+    s->device_id = hello.device_id;
+    s->cpu = g_num_cpus ? g_cpus[g_next_engine++ % g_num_cpus] : -1;
+
+    welcome.status = pcie_sim_open(hello.device_id, &s->device);
+    if (welcome.status != PCIE_SIM_SUCCESS) {
+        s->device = NULL;
+        goto err;
+    }
+
+    welcome.status = PCIE_SIM_ERROR_SYSTEM;
+    memfd = memfd_create("pcie_simd", MFD_CLOEXEC);
+    if (memfd < 0 || ftruncate(memfd, sizeof(struct simd_region)) != 0)
+        goto err;
+
+    s->region = mmap(NULL, sizeof(struct simd_region), PROT_READ | PROT_WRITE,
+                     MAP_SHARED, memfd, 0);
+    if (s->region == MAP_FAILED) {
+        s->region = NULL;
+        goto err;
+    }
+
+    s->submit_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    s->complete_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (s->submit_fd < 0 || s->complete_fd < 0)
+        goto err;
+
+    welcome.status = PCIE_SIM_SUCCESS;
+    welcome.ring_entries = SIMD_RING_ENTRIES;
+    welcome.region_size = sizeof(struct simd_region);
+    fds[0] = memfd;
+    fds[1] = s->submit_fd;
+    fds[2] = s->complete_fd;
+    if (simd_send_welcome(sock, &welcome, fds) != 0) {
+        close(memfd);
+        simd_session_free(s);
+        return;
+    }
+    close(memfd);
+
+    if (pthread_create(&thread, NULL, simd_engine, s) != 0) {
+        simd_session_free(s);
+        return;
+    }
+    pthread_detach(thread);
+
+    if (g_verbose)
+        printf("pcie_simd: client attached to device %d (cpu %d)\n", s->device_id, s->cpu);
+    return;
+
+err:
+    if (memfd >= 0)
+        close(memfd);
+    simd_send_welcome(sock, &welcome, NULL);
+    simd_session_free(s);
+}
+
+/*
+ * Parse a comma-separated CPU list such as "2,3,6"
+ */
+static int simd_parse_cpus(const char *list)
+{
+    char *copy = strdup(list);
+    char *save = NULL;
+    char *tok;
+
+    if (!copy)
+        return -1;
+
+    for (tok = strtok_r(copy, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+        int cpu = atoi(tok);
+
+        if (cpu < 0 || cpu >= CPU_SETSIZE || g_num_cpus >= SIMD_MAX_CPUS) {
+            free(copy);
+            return -1;
+        }
+        g_cpus[g_num_cpus++] = cpu;
+    }
+
+    free(copy);
+    return g_num_cpus > 0 ? 0 : -1;
+}
+
+/*
+ * vfio-user server thread, serving QEMU alongside the native clients
+ */
+static void *simd_vfio_user_thread(void *arg)
+{
+    (void)arg;
+    if (vfio_user_serve(g_vfio_user_path, g_vfio_user_device, &g_running, g_verbose) != 0)
+        g_running = 0;
+    return NULL;
+}
+
+static void simd_usage(const char *prog)
+{
+    printf("Usage: %s [options]\n", prog);
+    printf("  -s, --socket PATH       Listen on PATH (default: %s)\n", SIMD_DEFAULT_SOCKET);
+    printf("  -c, --cpus LIST         Pin engine threads round-robin to CPUs, e.g. 2,3\n");
+    printf("  -u, --vfio-user PATH    Also serve a device to QEMU (vfio-user) on PATH\n");
+    printf("  -D, --vfio-device ID    Device exposed over vfio-user (default: 0)\n");
+    printf("  -v, --verbose           Log client connections\n");
+    printf("  -h, --help              Show this help\n");
+    printf("\nClients connect by setting %s to the socket path.\n", SIMD_SOCKET_ENV);
+}
+
+int main(int argc, char *argv[])
+{
+    static const struct option options[] = {
+        { "socket",      required_argument, NULL, 's' },
+        { "cpus",        required_argument, NULL, 'c' },
+        { "vfio-user",   required_argument, NULL, 'u' },
+        { "vfio-device", required_argument, NULL, 'D' },
+        { "verbose",     no_argument,       NULL, 'v' },
+        { "help",        no_argument,       NULL, 'h' },
+        { NULL, 0, NULL, 0 }
+    };
+    struct sockaddr_un addr;
+    struct sigaction sa;
+    struct pollfd pfd;
+    pthread_t vfio_thread;
+    int listen_fd;
+    int opt;
+
+    while ((opt = getopt_long(argc, argv, "s:c:u:D:vh", options, NULL)) != -1) {
+        switch (opt) {
+        case 's':
+            g_socket_path = optarg;
+            break;
+        case 'c':
+            if (simd_parse_cpus(optarg) != 0) {
+                fprintf(stderr, "pcie_simd: invalid CPU list '%s'\n", optarg);
+                return 1;
+            }
+            break;
+        case 'u':
+            g_vfio_user_path = optarg;
+            break;
+        case 'D':
+            g_vfio_user_device = atoi(optarg);
+            break;
+        case 'v':
+            g_verbose = 1;
+            break;
+        case 'h':
+            simd_usage(argv[0]);
+            return 0;
+        default:
+            simd_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    /* Keep the log readable when redirected to a file */
+    setvbuf(stdout, NULL, _IOLBF, 0);
+
+    /* The daemon hosts the models itself; never forward to another daemon */
+    unsetenv(SIMD_SOCKET_ENV);
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = simd_signal_handler;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0) {
+        perror("pcie_simd: socket");
+        return 1;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(g_socket_path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "pcie_simd: socket path too long\n");
+        return 1;
+    }
+    strcpy(addr.sun_path, g_socket_path);
+    unlink(g_socket_path);
+
+    if (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(listen_fd, 16) != 0) {
+        fprintf(stderr, "pcie_simd: cannot listen on %s: %s\n", g_socket_path, strerror(errno));
+        close(listen_fd);
+        return 1;
+    }
+
+    printf("pcie_simd: listening on %s\n", g_socket_path);
+
+    if (g_vfio_user_path &&
+        pthread_create(&vfio_thread, NULL, simd_vfio_user_thread, NULL) != 0) {
+        fprintf(stderr, "pcie_simd: cannot start vfio-user server\n");
+        g_vfio_user_path = NULL;
+    }
+
+    pfd.fd = listen_fd;
+    pfd.events = POLLIN;
+    while (g_running) {
+        int sock;
+
+        if (poll(&pfd, 1, 500) <= 0)
+            continue;
+
+        sock = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC);
+        if (sock >= 0)
+            simd_accept_client(sock);
+    }
+
+    if (g_vfio_user_path)
+        pthread_join(vfio_thread, NULL);
+
+    close(listen_fd);
+    unlink(g_socket_path);
+    printf("pcie_simd: shut down\n");
+    return 0;
+}
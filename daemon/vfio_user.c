@@ -0,0 +1,698 @@
+/*
+ * PCIe Simulator - vfio-user Server
+ *
+ * Copyright (c) 2025 Karan Mamaniya <kmamaniya@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Exposes a simulated device to QEMU (vfio-user-pci) over a Unix socket:
+ * PCI config space, the BAR0 register map from lib/regs.h and INTx. Guest
+ * RAM shared via DMA_MAP file descriptors is mapped directly, so DMA
+ * programmed through BAR0 runs zero-copy against guest memory.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <linux/pci_regs.h>
+#include <linux/vfio.h>
+#include "../lib/pcie_sim.h"
+#include "../sim/mmio_sim.h"
+#include "vfio_user.h"
+
+#define VFU_CONFIG_SIZE     256
+#define VFU_MAX_DMA_MAPS    64
+#define VFU_DEVICE_MEM_SIZE VFIO_USER_MAX_DATA_XFER
+#define VFU_MAX_MSG_SIZE    (VFIO_USER_MAX_DATA_XFER + 4096)
+
+/* PCI identity: REG_DEVICE_ID doubles as the vendor/device dword */
+#define VFU_PCI_CLASS_ACCEL 0x120000    /* Processing accelerator */
+
+/* Guest memory region registered with DMA_MAP */
+struct vfu_dma_map {
+    uint64_t iova;
+    uint64_t size;
+    uint32_t prot;
+    void *host;             /* NULL if the client passed no fd */
+};
+
+/* Per-connection device state */
+struct vfu_ctx {
+    int sock;
+    int verbose;
+    int device_id;
+    pcie_sim_handle_t device;
+
+    uint8_t config[VFU_CONFIG_SIZE];
+    uint32_t bar0_mask;             /* Latched BAR0 sizing probe */
+
+    struct pcie_sim_bar0 bar0;
+
+    struct vfu_dma_map maps[VFU_MAX_DMA_MAPS];
+    int num_maps;
+
+    int intx_fd;
+    int intx_masked;
+
+    uint8_t *device_mem;            /* Backing store for FROM_DEVICE reads */
+};
+
+/*
+ * Reset the PCI config header to its power-on values
+ */
+static void vfu_config_reset(struct vfu_ctx *ctx)
+{
+    uint32_t id = PCIE_SIM_DEVICE_ID_VALUE;
+    uint32_t class_rev = (VFU_PCI_CLASS_ACCEL << 8) | 0x01;
+
+    memset(ctx->config, 0, sizeof(ctx->config));
+    memcpy(&ctx->config[PCI_VENDOR_ID], &id, sizeof(id));
+    memcpy(&ctx->config[PCI_CLASS_REVISION], &class_rev, sizeof(class_rev));
+    memcpy(&ctx->config[PCI_SUBSYSTEM_VENDOR_ID], &id, sizeof(id));
+    ctx->config[PCI_INTERRUPT_PIN] = 1;     /* INTA# */
+    ctx->bar0_mask = 0;
+}
+
+/*
+ * Translate a guest I/O address range to a host pointer in a mapped region
+ */
+static void *vfu_dma_translate(struct vfu_ctx *ctx, uint64_t iova, uint64_t size, uint32_t prot)
+{
+    for (int i = 0; i < ctx->num_maps; i++) {
+        struct vfu_dma_map *m = &ctx->maps[i];
+
+        if (iova >= m->iova && size <= m->size && iova - m->iova <= m->size - size) {
+            if (!m->host || (m->prot & prot) != prot)
+                return NULL;
+            return (uint8_t *)m->host + (iova - m->iova);
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * BAR0 hook: signal INTx, which stays automasked until the client unmasks it
+ */
+static void vfu_irq(void *opaque)
+{
+    struct vfu_ctx *ctx = opaque;
+    uint64_t one = 1;
+
+    if (ctx->intx_fd < 0 || ctx->intx_masked)
+        return;
+
+    ctx->intx_masked = 1;
+    (void)!write(ctx->intx_fd, &one, sizeof(one));
+}
+
+/*
+ * BAR0 hook: run a DMA directly against guest memory
+ */
+static int vfu_dma(void *opaque, uint64_t iova, uint32_t size, uint32_t direction,
+                   uint64_t *latency_ns)
+{
+    struct vfu_ctx *ctx = opaque;
+    void *guest;
+
+    if (size > VFU_DEVICE_MEM_SIZE)
+        return -1;
+
+    /* TO_DEVICE reads guest memory, FROM_DEVICE writes it */
+    guest = vfu_dma_translate(ctx, iova, size,
+                              direction == PCIE_SIM_TO_DEVICE ?
+                              VFIO_USER_F_DMA_REGION_READ : VFIO_USER_F_DMA_REGION_WRITE);
+    if (!guest)
+        return -1;
+
+    if (pcie_sim_transfer(ctx->device, guest, size, direction, latency_ns) != PCIE_SIM_SUCCESS)
+        return -1;
+
+    if (direction == PCIE_SIM_TO_DEVICE)
+        memcpy(ctx->device_mem, guest, size);
+    else
+        memcpy(guest, ctx->device_mem, size);
+
+    return 0;
+}
+
+static int vfu_stats(void *opaque, struct pcie_sim_stats *stats)
+{
+    struct vfu_ctx *ctx = opaque;
+
+    return pcie_sim_get_stats(ctx->device, stats) == PCIE_SIM_SUCCESS ? 0 : -1;
+}
+
+static const struct pcie_sim_bar0_ops vfu_bar0_ops = {
+    vfu_dma,
+    vfu_stats,
+    vfu_irq,
+    NULL,
+};
+
+/*
+ * Config space accesses; only the command register, BAR0 and the
+ * interrupt line are writable
+ */
+static void vfu_config_read(struct vfu_ctx *ctx, uint32_t offset, uint8_t *data, uint32_t count)
+{
+    memcpy(data, &ctx->config[offset], count);
+
+    /* Overlay the BAR0 sizing response */
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t pos = offset + i;
+
+        if (pos >= PCI_BASE_ADDRESS_0 && pos < PCI_BASE_ADDRESS_0 + 4 && ctx->bar0_mask) {
+            uint32_t bar = ~(PCIE_SIM_BAR0_SIZE - 1U);
+            data[i] = (uint8_t)(bar >> (8 * (pos - PCI_BASE_ADDRESS_0)));
+        }
+    }
+}
+
+static void vfu_config_write(struct vfu_ctx *ctx, uint32_t offset, const uint8_t *data, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t pos = offset + i;
+
+        if (pos == PCI_COMMAND || pos == PCI_COMMAND + 1 ||
+            pos == PCI_INTERRUPT_LINE)
+            ctx->config[pos] = data[i];
+    }
+
+    if (offset <= PCI_BASE_ADDRESS_0 && offset + count >= PCI_BASE_ADDRESS_0 + 4) {
+        uint32_t bar;
+
+        memcpy(&bar, data + (PCI_BASE_ADDRESS_0 - offset), sizeof(bar));
+        ctx->bar0_mask = (bar == 0xFFFFFFFF);
+        if (!ctx->bar0_mask) {
+            bar &= ~(PCIE_SIM_BAR0_SIZE - 1U);     /* 32-bit non-prefetchable memory */
+            memcpy(&ctx->config[PCI_BASE_ADDRESS_0], &bar, sizeof(bar));
+        }
+    }
+}
+
+/*
+ * Send a reply (or an error reply when error_no is non-zero)
+ */
+static int vfu_reply(struct vfu_ctx *ctx, const struct vfio_user_header *req,
+                     const void *payload, size_t len, int error_no)
+{
+    struct vfio_user_header hdr;
+    struct iovec iov[2];
+    struct msghdr msg;
+
+    if (req->flags & VFIO_USER_F_NO_REPLY)
+        return 0;
+
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.msg_id = req->msg_id;
+    hdr.command = req->command;
+    hdr.flags = VFIO_USER_F_TYPE_REPLY;
+    if (error_no) {
+        hdr.flags |= VFIO_USER_F_ERROR;
+        hdr.error_no = (uint32_t)error_no;
+        len = 0;
+    }
+    hdr.msg_size = (uint32_t)(sizeof(hdr) + len);
+
+    iov[0].iov_base = &hdr;
+    iov[0].iov_len = sizeof(hdr);
+    iov[1].iov_base = (void *)payload;
+    iov[1].iov_len = len;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = len ? 2 : 1;
+
+    return sendmsg(ctx->sock, &msg, MSG_NOSIGNAL) == (ssize_t)hdr.msg_size ? 0 : -1;
+}
+
+static int vfu_handle_version(struct vfu_ctx *ctx, const struct vfio_user_header *hdr,
+                              const uint8_t *payload, size_t len)
+{
+    static const char caps[] =
+        "{\"capabilities\":{\"max_msg_fds\":8,\"max_data_xfer_size\":1048576,\"pgsizes\":4096}}";
+    uint8_t reply[sizeof(struct vfio_user_version) + sizeof(caps)];
+    struct vfio_user_version *version = (struct vfio_user_version *)reply;
+    const struct vfio_user_version *req = (const void *)payload;
+
+    if (len < sizeof(*req) || req->major != VFIO_USER_MAJOR)
+        return vfu_reply(ctx, hdr, NULL, 0, ENOTSUP);
+
+    version->major = VFIO_USER_MAJOR;
+    version->minor = req->minor < VFIO_USER_MINOR ? req->minor : VFIO_USER_MINOR;
+    memcpy(version->capabilities, caps, sizeof(caps));
+
+    return vfu_reply(ctx, hdr, reply, sizeof(reply), 0);
+}
+
+static int vfu_handle_dma_map(struct vfu_ctx *ctx, const struct vfio_user_header *hdr,
+                              const uint8_t *payload, size_t len, int *fds, int nfds)
+{
+    const struct vfio_user_dma_map *req = (const void *)payload;
+    struct vfu_dma_map *m;
+    int prot = 0;
+
+    if (len < sizeof(*req) || req->size == 0)
+        return vfu_reply(ctx, hdr, NULL, 0, EINVAL);
+    if (ctx->num_maps >= VFU_MAX_DMA_MAPS)
+        return vfu_reply(ctx, hdr, NULL, 0, ENOSPC);
+
+    m = &ctx->maps[ctx->num_maps];
+    m->iova = req->address;
+    m->size = req->size;
+    m->prot = req->flags & (VFIO_USER_F_DMA_REGION_READ | VFIO_USER_F_DMA_REGION_WRITE);
+    m->host = NULL;
+
+    /* With an fd the guest RAM is mapped here and DMA is zero-copy */
+    if (nfds > 0) {
+        if (m->prot & VFIO_USER_F_DMA_REGION_READ)
+            prot |= PROT_READ;
+        if (m->prot & VFIO_USER_F_DMA_REGION_WRITE)
+            prot |= PROT_WRITE;
+        m->host = mmap(NULL, req->size, prot, MAP_SHARED, fds[0], req->offset);
+        close(fds[0]);
+        fds[0] = -1;
+        if (m->host == MAP_FAILED)
+            return vfu_reply(ctx, hdr, NULL, 0, errno);
+    }
+
+    ctx->num_maps++;
+    if (ctx->verbose)
+        printf("vfio-user: DMA map iova=0x%llx size=0x%llx%s\n",
+               (unsigned long long)m->iova, (unsigned long long)m->size,
+               m->host ? "" : " (no fd, not DMA-able)");
+
+    return vfu_reply(ctx, hdr, NULL, 0, 0);
+}
+
+static void vfu_unmap(struct vfu_ctx *ctx, int index)
+{
+    if (ctx->maps[index].host)
+        munmap(ctx->maps[index].host, ctx->maps[index].size);
+    ctx->maps[index] = ctx->maps[--ctx->num_maps];
+}
+
+static int vfu_handle_dma_unmap(struct vfu_ctx *ctx, const struct vfio_user_header *hdr,
+                                const uint8_t *payload, size_t len)
+{
+    const struct vfio_user_dma_unmap *req = (const void *)payload;
+    int found = 0;
+
+    if (len < sizeof(*req))
+        return vfu_reply(ctx, hdr, NULL, 0, EINVAL);
+
+    for (int i = ctx->num_maps - 1; i >= 0; i--) {
+        if (ctx->maps[i].iova == req->address && ctx->maps[i].size == req->size) {
+            vfu_unmap(ctx, i);
+            found = 1;
+        }
+    }
+
+    if (!found)
+        return vfu_reply(ctx, hdr, NULL, 0, ENOENT);
+
+    return vfu_reply(ctx, hdr, req, sizeof(*req), 0);
+}
+
+static int vfu_handle_region_info(struct vfu_ctx *ctx, const struct vfio_user_header *hdr,
+                                  const uint8_t *payload, size_t len)
+{
+    struct vfio_region_info info;
+
+    if (len < sizeof(info))
+        return vfu_reply(ctx, hdr, NULL, 0, EINVAL);
+
+    memcpy(&info, payload, sizeof(info));
+    if (info.index >= VFIO_PCI_NUM_REGIONS)
+        return vfu_reply(ctx, hdr, NULL, 0, EINVAL);
+
+    info.argsz = sizeof(info);
+    info.cap_offset = 0;
+    info.offset = 0;
+    info.flags = 0;
+    info.size = 0;
+
+    if (info.index == VFIO_PCI_BAR0_REGION_INDEX) {
+        info.flags = VFIO_REGION_INFO_FLAG_READ | VFIO_REGION_INFO_FLAG_WRITE;
+        info.size = PCIE_SIM_BAR0_SIZE;
+    } else if (info.index == VFIO_PCI_CONFIG_REGION_INDEX) {
+        info.flags = VFIO_REGION_INFO_FLAG_READ | VFIO_REGION_INFO_FLAG_WRITE;
+        info.size = VFU_CONFIG_SIZE;
+    }
+
+    return vfu_reply(ctx, hdr, &info, sizeof(info), 0);
+}
+
+static int vfu_handle_irq_info(struct vfu_ctx *ctx, const struct vfio_user_header *hdr,
+                               const uint8_t *payload, size_t len)
+{
+    struct vfio_irq_info info;
+
+    if (len < sizeof(info))
+        return vfu_reply(ctx, hdr, NULL, 0, EINVAL);
+
+    memcpy(&info, payload, sizeof(info));
+    if (info.index >= VFIO_PCI_NUM_IRQS)
+        return vfu_reply(ctx, hdr, NULL, 0, EINVAL);
+
+    info.argsz = sizeof(info);
+    info.flags = 0;
+    info.count = 0;
+
+    /* Legacy INTA# only; the config space advertises no MSI capability */
+    if (info.index == VFIO_PCI_INTX_IRQ_INDEX) {
+        info.flags = VFIO_IRQ_INFO_EVENTFD | VFIO_IRQ_INFO_MASKABLE | VFIO_IRQ_INFO_AUTOMASKED;
+        info.count = 1;
+    }
+
+    return vfu_reply(ctx, hdr, &info, sizeof(info), 0);
+}
+
+static int vfu_handle_set_irqs(struct vfu_ctx *ctx, const struct vfio_user_header *hdr,
+                               const uint8_t *payload, size_t len, int *fds, int nfds)
+{
+    struct vfio_irq_set set;
+
+    if (len < sizeof(set))
+        return vfu_reply(ctx, hdr, NULL, 0, EINVAL);
+
+    memcpy(&set, payload, sizeof(set));
+    if (set.index != VFIO_PCI_INTX_IRQ_INDEX)
+        return vfu_reply(ctx, hdr, NULL, 0, set.count ? EINVAL : 0);
+    if (set.start != 0 || set.count > 1)
+        return vfu_reply(ctx, hdr, NULL, 0, EINVAL);
+
+    if (set.flags & VFIO_IRQ_SET_ACTION_MASK) {
+        ctx->intx_masked = 1;
+    } else if (set.flags & VFIO_IRQ_SET_ACTION_UNMASK) {
+        ctx->intx_masked = 0;
+        /* Still-pending interrupts fire again */
+        if ((ctx->bar0.regs[PCIE_SIM_REG_INTERRUPT_STATUS / 4] &
+             ctx->bar0.regs[PCIE_SIM_REG_INTERRUPT_ENABLE / 4]) &&
+            (ctx->bar0.regs[PCIE_SIM_REG_CONTROL / 4] & PCIE_SIM_CONTROL_IRQ_ENABLE))
+            vfu_irq(ctx);
+    } else if (set.flags & VFIO_IRQ_SET_ACTION_TRIGGER) {
+        if (ctx->intx_fd >= 0)
+            close(ctx->intx_fd);
+        ctx->intx_fd = -1;
+        ctx->intx_masked = 0;
+        if ((set.flags & VFIO_IRQ_SET_DATA_EVENTFD) && set.count == 1 && nfds > 0) {
+            ctx->intx_fd = fds[0];
+            fds[0] = -1;
+        }
+    }
+
+    return vfu_reply(ctx, hdr, NULL, 0, 0);
+}
+
+static int vfu_handle_region_rw(struct vfu_ctx *ctx, const struct vfio_user_header *hdr,
+                                const uint8_t *payload, size_t len)
+{
+    const struct vfio_user_region_access *req = (const void *)payload;
+    int is_write = hdr->command == VFIO_USER_REGION_WRITE;
+    struct vfio_user_region_access *reply;
+    size_t reply_len;
+    uint64_t size;
+    int ret;
+
+    if (len < sizeof(*req) || req->count == 0 || req->count > VFIO_USER_MAX_DATA_XFER ||
+        (is_write && len < sizeof(*req) + req->count))
+        return vfu_reply(ctx, hdr, NULL, 0, EINVAL);
+
+    if (req->region == VFIO_PCI_BAR0_REGION_INDEX) {
+        size = PCIE_SIM_BAR0_SIZE;
+        /* Registers are 32 bits wide */
+        if ((req->offset | req->count) & 3)
+            return vfu_reply(ctx, hdr, NULL, 0, EINVAL);
+    } else if (req->region == VFIO_PCI_CONFIG_REGION_INDEX) {
+        size = VFU_CONFIG_SIZE;
+    } else {
+        return vfu_reply(ctx, hdr, NULL, 0, EINVAL);
+    }
+    if (req->offset >= size || req->count > size - req->offset)
+        return vfu_reply(ctx, hdr, NULL, 0, EINVAL);
+
+    reply_len = sizeof(*reply) + (is_write ? 0 : req->count);
+    reply = malloc(reply_len);
+    if (!reply)
+        return vfu_reply(ctx, hdr, NULL, 0, ENOMEM);
+    reply->offset = req->offset;
+    reply->region = req->region;
+    reply->count = req->count;
+
+    if (req->region == VFIO_PCI_BAR0_REGION_INDEX) {
+        for (uint32_t i = 0; i < req->count; i += 4) {
+            uint32_t offset = (uint32_t)req->offset + i;
+            uint32_t value;
+
+            if (is_write) {
+                memcpy(&value, req->data + i, sizeof(value));
+                pcie_sim_bar0_write(&ctx->bar0, offset, value, &vfu_bar0_ops, ctx);
+            } else {
+                value = pcie_sim_bar0_read(&ctx->bar0, offset, &vfu_bar0_ops, ctx);
+                memcpy(reply->data + i, &value, sizeof(value));
+            }
+        }
+    } else if (is_write) {
+        vfu_config_write(ctx, (uint32_t)req->offset, req->data, req->count);
+    } else {
+        vfu_config_read(ctx, (uint32_t)req->offset, reply->data, req->count);
+    }
+
+    ret = vfu_reply(ctx, hdr, reply, reply_len, 0);
+    free(reply);
+    return ret;
+}
+
+/*
+ * Receive one message; returns 0 on success, -1 on hangup or protocol error
+ */
+static int vfu_recv(struct vfu_ctx *ctx, struct vfio_user_header *hdr, uint8_t *payload,
+                    int *fds, int *nfds)
+{
+    char control[CMSG_SPACE(VFIO_USER_MAX_FDS * sizeof(int))];
+    struct iovec iov = { hdr, sizeof(*hdr) };
+    struct cmsghdr *cmsg;
+    struct msghdr msg;
+    size_t got, want;
+    ssize_t n;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    do {
+        n = recvmsg(ctx->sock, &msg, MSG_CMSG_CLOEXEC | MSG_WAITALL);
+    } while (n < 0 && errno == EINTR);
+    if (n != (ssize_t)sizeof(*hdr))
+        return -1;
+
+    *nfds = 0;
+    for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+            int count = (int)((cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+
+            memcpy(fds, CMSG_DATA(cmsg), count * sizeof(int));
+            *nfds = count;
+        }
+    }
+
+    if (hdr->msg_size < sizeof(*hdr) || hdr->msg_size > VFU_MAX_MSG_SIZE)
+        return -1;
+
+    want = hdr->msg_size - sizeof(*hdr);
+    for (got = 0; got < want; got += (size_t)n) {
+        n = recv(ctx->sock, payload + got, want - got, 0);
+        if (n < 0 && errno == EINTR) {
+            n = 0;
+            continue;
+        }
+        if (n <= 0)
+            return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Dispatch messages from one client until it disconnects
+ */
+static void vfu_session(struct vfu_ctx *ctx, volatile sig_atomic_t *running)
+{
+    struct vfio_user_header hdr;
+    int fds[VFIO_USER_MAX_FDS];
+    struct pollfd pfd = { ctx->sock, POLLIN, 0 };
+    uint8_t *payload;
+    int nfds;
+
+    payload = malloc(VFU_MAX_MSG_SIZE);
+    if (!payload)
+        return;
+
+    while (*running) {
+        size_t len;
+        int ret = 0;
+
+        if (poll(&pfd, 1, 500) <= 0)
+            continue;
+        if (vfu_recv(ctx, &hdr, payload, fds, &nfds) != 0)
+            break;
+
+        len = hdr.msg_size - sizeof(hdr);
+        if ((hdr.flags & VFIO_USER_F_TYPE_MASK) != VFIO_USER_F_TYPE_COMMAND) {
+            ret = 0;    /* We never send requests, so never expect replies */
+        } else {
+            switch (hdr.command) {
+            case VFIO_USER_VERSION:
+                ret = vfu_handle_version(ctx, &hdr, payload, len);
+                break;
+            case VFIO_USER_DMA_MAP:
+                ret = vfu_handle_dma_map(ctx, &hdr, payload, len, fds, nfds);
+                break;
+            case VFIO_USER_DMA_UNMAP:
+                ret = vfu_handle_dma_unmap(ctx, &hdr, payload, len);
+                break;
+            case VFIO_USER_DEVICE_GET_INFO: {
+                struct vfio_device_info info;
+
+                memset(&info, 0, sizeof(info));
+                info.argsz = sizeof(info);
+                info.flags = VFIO_DEVICE_FLAGS_PCI | VFIO_DEVICE_FLAGS_RESET;
+                info.num_regions = VFIO_PCI_NUM_REGIONS;
+                info.num_irqs = VFIO_PCI_NUM_IRQS;
+                ret = vfu_reply(ctx, &hdr, &info, sizeof(info), 0);
+                break;
+            }
+            case VFIO_USER_DEVICE_GET_REGION_INFO:
+                ret = vfu_handle_region_info(ctx, &hdr, payload, len);
+                break;
+            case VFIO_USER_DEVICE_GET_IRQ_INFO:
+                ret = vfu_handle_irq_info(ctx, &hdr, payload, len);
+                break;
+            case VFIO_USER_DEVICE_SET_IRQS:
+                ret = vfu_handle_set_irqs(ctx, &hdr, payload, len, fds, nfds);
+                break;
+            case VFIO_USER_REGION_READ:
+            case VFIO_USER_REGION_WRITE:
+                ret = vfu_handle_region_rw(ctx, &hdr, payload, len);
+                break;
+            case VFIO_USER_DEVICE_RESET:
+                pcie_sim_bar0_reset(&ctx->bar0);
+                ret = vfu_reply(ctx, &hdr, NULL, 0, 0);
+                break;
+            default:
+                ret = vfu_reply(ctx, &hdr, NULL, 0, ENOTSUP);
+                break;
+            }
+        }
+
+        /* Close any descriptors the handler did not take */
+        for (int i = 0; i < nfds; i++)
+            if (fds[i] >= 0)
+                close(fds[i]);
+
+        if (ret != 0)
+            break;
+    }
+
+    free(payload);
+}
+
+int vfio_user_serve(const char *socket_path, int device_id,
+                    volatile sig_atomic_t *running, int verbose)
+{
+    struct sockaddr_un addr;
+    struct pollfd pfd;
+    struct vfu_ctx ctx;
+    int listen_fd;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "vfio-user: socket path too long\n");
+        return -1;
+    }
+    strcpy(addr.sun_path, socket_path);
+
+    listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0)
+        return -1;
+    unlink(socket_path);
+    if (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(listen_fd, 1) != 0) {
+        fprintf(stderr, "vfio-user: cannot listen on %s: %s\n", socket_path, strerror(errno));
+        close(listen_fd);
+        return -1;
+    }
+
+    printf("vfio-user: serving device %d on %s\n", device_id, socket_path);
+
+    pfd.fd = listen_fd;
+    pfd.events = POLLIN;
+    while (*running) {
+        if (poll(&pfd, 1, 500) <= 0)
+            continue;
+
+        memset(&ctx, 0, sizeof(ctx));
+        ctx.sock = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC);
+        if (ctx.sock < 0)
+            continue;
+        ctx.verbose = verbose;
+        ctx.device_id = device_id;
+        ctx.intx_fd = -1;
+
+        ctx.device_mem = calloc(1, VFU_DEVICE_MEM_SIZE);
+        if (!ctx.device_mem || pcie_sim_open(device_id, &ctx.device) != PCIE_SIM_SUCCESS) {
+            fprintf(stderr, "vfio-user: cannot open device %d\n", device_id);
+            free(ctx.device_mem);
+            close(ctx.sock);
+            continue;
+        }
+
+        vfu_config_reset(&ctx);
+        pcie_sim_bar0_init(&ctx.bar0);
+        if (verbose)
+            printf("vfio-user: client connected\n");
+
+        vfu_session(&ctx, running);
+
+        if (verbose)
+            printf("vfio-user: client disconnected\n");
+        while (ctx.num_maps > 0)
+            vfu_unmap(&ctx, ctx.num_maps - 1);
+        if (ctx.intx_fd >= 0)
+            close(ctx.intx_fd);
+        pcie_sim_close(ctx.device);
+        free(ctx.device_mem);
+        close(ctx.sock);
+    }
+
+    close(listen_fd);
+    unlink(socket_path);
+    return 0;
+}
@@ -0,0 +1,111 @@
+/*
+ * PCIe Simulator - vfio-user Protocol
+ *
+ * Copyright (c) 2025 Karan Mamaniya <kmamaniya@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Message layouts for the vfio-user server built into pcie_simd.
+ */
+
+#ifndef PCIE_SIMD_VFIO_USER_H
+#define PCIE_SIMD_VFIO_USER_H
+
+#include <stdint.h>
+#include <signal.h>
+
+/*
+ * vfio-user wire format (QEMU docs/devel/vfio-user.rst). Region and IRQ
+ * payloads reuse the VFIO structures from <linux/vfio.h>.
+ */
+#define VFIO_USER_MAJOR             0
+#define VFIO_USER_MINOR             1
+#define VFIO_USER_MAX_FDS           8
+#define VFIO_USER_MAX_DATA_XFER     (1024 * 1024)
+
+/* Commands */
+#define VFIO_USER_VERSION                   1
+#define VFIO_USER_DMA_MAP                   2
+#define VFIO_USER_DMA_UNMAP                 3
+#define VFIO_USER_DEVICE_GET_INFO           4
+#define VFIO_USER_DEVICE_GET_REGION_INFO    5
+#define VFIO_USER_DEVICE_GET_REGION_IO_FDS  6
+#define VFIO_USER_DEVICE_GET_IRQ_INFO       7
+#define VFIO_USER_DEVICE_SET_IRQS           8
+#define VFIO_USER_REGION_READ               9
+#define VFIO_USER_REGION_WRITE              10
+#define VFIO_USER_DMA_READ                  11
+#define VFIO_USER_DMA_WRITE                 12
+#define VFIO_USER_DEVICE_RESET              13
+
+/* Header flags */
+#define VFIO_USER_F_TYPE_MASK       0xf
+#define VFIO_USER_F_TYPE_COMMAND    0
+#define VFIO_USER_F_TYPE_REPLY      1
+#define VFIO_USER_F_NO_REPLY        (1U << 4)
+#define VFIO_USER_F_ERROR           (1U << 5)
+
+/* DMA_MAP flags */
+#define VFIO_USER_F_DMA_REGION_READ     (1U << 0)
+#define VFIO_USER_F_DMA_REGION_WRITE    (1U << 1)
+
+struct vfio_user_header {
+    uint16_t msg_id;
+    uint16_t command;
+    uint32_t msg_size;      /* Including this header */
+    uint32_t flags;
+    uint32_t error_no;      /* errno, valid with VFIO_USER_F_ERROR */
+};
+
+struct vfio_user_version {
+    uint16_t major;
+    uint16_t minor;
+    char capabilities[];    /* NUL-terminated JSON */
+};
+
+struct vfio_user_dma_map {
+    uint32_t argsz;
+    uint32_t flags;
+    uint64_t offset;        /* Into the passed file descriptor */
+    uint64_t address;       /* Guest I/O virtual address */
+    uint64_t size;
+};
+
+struct vfio_user_dma_unmap {
+    uint32_t argsz;
+    uint32_t flags;
+    uint64_t address;
+    uint64_t size;
+};
+
+struct vfio_user_region_access {
+    uint64_t offset;
+    uint32_t region;
+    uint32_t count;
+    uint8_t data[];
+};
+
+/*
+ * Serve one simulated device to vfio-user clients (one at a time) on a
+ * Unix socket until *running drops to zero. Returns 0 on clean shutdown.
+ */
+int vfio_user_serve(const char *socket_path, int device_id,
+                    volatile sig_atomic_t *running, int verbose);
+
+#endif /* PCIE_SIMD_VFIO_USER_H */
@@ -98,6 +98,38 @@ int main(int argc, char *argv[])
         printf("Read-back failed: %s\n", pcie_sim_error_string(ret));
     }
 
+    /* Where the time of one transfer goes */
+    printf("\nTransfer phases:\n");
+    {
+        static const char *const names[PCIE_SIM_PHASES] = {
+            "allocation", "copy in", "queue wait", "wire", "completion", "copy out"
+        };
+        uint64_t phase_ns[PCIE_SIM_PHASES];
+        int p;
+
+        ret = pcie_sim_transfer_ex(handle, buffer, sizeof(buffer), PCIE_SIM_TO_DEVICE,
+                                   &latency, phase_ns);
+        if (ret == PCIE_SIM_SUCCESS) {
+            for (p = 0; p < PCIE_SIM_PHASES; p++)
+                printf("  %-12s %" PRIu64 " ns\n", names[p], phase_ns[p]);
+        } else {
+            printf("Timed transfer failed: %s\n", pcie_sim_error_string(ret));
+        }
+    }
+
+    /* How closely the simulator kept to its modeled delays */
+    {
+        struct pcie_sim_delay_stats delay;
+
+        pcie_sim_delay_get_stats(&delay);
+        if (delay.count) {
+            printf("\nModeled delays: %" PRIu64 " (%" PRIu64 " slept), "
+                   "avg late %" PRIu64 " ns, max late %" PRIu64 " ns\n",
+                   delay.count, delay.slept, delay.late_ns / delay.count,
+                   delay.late_max_ns);
+        }
+    }
+
     /* Get statistics */
     printf("\nDevice statistics:\n");
     ret = pcie_sim_get_stats(handle, &stats);
@@ -112,6 +144,8 @@ int main(int argc, char *argv[])
                stats.min_latency_ns, stats.min_latency_ns / 1000.0);
         printf("  Max latency: %" PRIu64 " ns (%.2f μs)\n",
                stats.max_latency_ns, stats.max_latency_ns / 1000.0);
+        printf("  Latency std dev: %" PRIu64 " ns (%.2f μs)\n",
+               stats.stddev_latency_ns, stats.stddev_latency_ns / 1000.0);
 
         if (stats.total_transfers > 0) {
             double avg_throughput = (double)stats.total_bytes /
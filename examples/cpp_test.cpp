@@ -10,6 +10,7 @@
 
 #include "../lib/device.hpp"
 #include "../lib/monitor.hpp"
+#include "../lib/pool.hpp"
 #include "../utils/options.hpp"
 #include "../utils/csv_logger.hpp"
 #include <iostream>
@@ -138,7 +139,7 @@ void pattern_based_transfer_test(int device_id, const pcie_sim_transfer_config&
             bool inject_error = error_injector && error_injector->should_inject_error();
             std::string error_status = "SUCCESS";
 
-            auto start = std::chrono::high_resolution_clock::now();
+            uint64_t start = pcie_sim_clock_ticks();
             uint64_t latency_ns = 0;
 
             try {
@@ -151,8 +152,7 @@ void pattern_based_transfer_test(int device_id, const pcie_sim_transfer_config&
                 }
             } catch (const std::exception& e) {
                 error_status = "EXCEPTION";
-                latency_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
-                    std::chrono::high_resolution_clock::now() - start).count();
+                latency_ns = pcie_sim_clock_to_ns(pcie_sim_clock_ticks() - start);
             }
 
             double latency_us = latency_ns / 1000.0;
@@ -190,10 +190,14 @@ void pattern_based_transfer_test(int device_id, const pcie_sim_transfer_config&
     }
 }
 
-void stress_test_worker(int device_id, int thread_id, int duration_seconds,
+void stress_test_worker(DevicePool* pool, int device_id, int thread_id, int duration_seconds,
                        const pcie_sim_transfer_config& config, ErrorInjector* error_injector) {
     try {
-        auto device = DeviceManager::open_device(device_id);
+        Device* device = pool->local(device_id);
+        if (!device) {
+            std::cerr << "Stress test worker: device " << device_id << " not available" << std::endl;
+            return;
+        }
         auto end_time = std::chrono::steady_clock::now() + std::chrono::seconds(duration_seconds);
 
         std::random_device rd;
@@ -203,22 +207,27 @@ void stress_test_worker(int device_id, int thread_id, int duration_seconds,
         uint32_t transfer_count = 0;
         uint64_t total_latency = 0;
 
+        // One buffer sized for the largest transfer, reused every iteration
+        std::vector<uint8_t> data(config.max_size, thread_id);
+
         while (std::chrono::steady_clock::now() < end_time) {
             uint32_t transfer_size = size_dist(gen);
-            std::vector<uint8_t> data(transfer_size, thread_id);
 
             bool inject_error = error_injector && error_injector->should_inject_error();
             std::string error_status = "SUCCESS";
             uint64_t latency_ns = 0;
 
-            try {
-                if (inject_error) {
-                    error_injector->simulate_error_delay();
-                    error_status = error_injector->get_error_type();
-                }
-                latency_ns = device->write(data);
-            } catch (const std::exception&) {
-                error_status = "EXCEPTION";
+            if (inject_error) {
+                error_injector->simulate_error_delay();
+                error_status = error_injector->get_error_type();
+            }
+
+            // Failures are expected here; take the non-throwing path
+            auto result = device->try_transfer(data.data(), transfer_size, Direction::TO_DEVICE);
+            if (result) {
+                latency_ns = result.value();
+            } else {
+                error_status = pcie_sim_error_string(result.error());
             }
 
             total_latency += latency_ns;
@@ -281,6 +290,13 @@ void run_stress_tests() {
                                                                           g_config->error.probability));
     }
 
+    // Devices are opened once; each worker gets its own cached handle
+    DevicePool pool(g_config->num_devices);
+    if (pool.size() == 0) {
+        std::cerr << "❌ No devices available for stress testing" << std::endl;
+        return;
+    }
+
     std::vector<std::future<void>> futures;
 
     std::cout << "🔥 Starting " << g_config->stress.num_threads << " concurrent threads for "
@@ -289,10 +305,10 @@ void run_stress_tests() {
     auto start_time = std::chrono::steady_clock::now();
 
     for (uint32_t i = 0; i < g_config->stress.num_threads; ++i) {
-        int device_id = i % g_config->num_devices;  // Round-robin device assignment
+        int device_id = pool.device_ids()[i % pool.size()];  // Round-robin device assignment
 
         futures.push_back(std::async(std::launch::async, stress_test_worker,
-                                   device_id, i, g_config->stress.duration_seconds,
+                                   &pool, device_id, i, g_config->stress.duration_seconds,
                                    g_config->transfer, error_injector.get()));
     }
 
@@ -0,0 +1,355 @@
+/*
+ * PCIe Simulator - Ring Descriptor Layout Benchmark
+ *
+ * Copyright (c) 2025 Karan Mamaniya <kmamaniya@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Compares today's shared 32-byte ring descriptor, where the device writes
+ * completion status into the line the driver fills, with split submission
+ * and completion queues that are each written by one side only. A driver
+ * thread and a device thread run on separate CPUs; cost and L1D misses are
+ * reported per descriptor.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#define RING_SIZE           256
+#define DEFAULT_DESCRIPTORS 2000000UL
+#define CACHE_LINE          64
+
+/* Today's layout: one 32-byte descriptor written by both sides */
+struct legacy_desc {
+    uint64_t buffer_addr;
+    uint32_t length;
+    uint32_t flags;
+    uint64_t timestamp;
+    uint32_t status;        /* 0 = pending, written by the device */
+    uint32_t reserved;
+};
+
+/* Split layout: 16-byte submission entries, 8-byte completion entries */
+struct sq_desc {
+    uint64_t buffer_addr;
+    uint32_t length;
+    uint16_t flags;
+    uint16_t id;
+};
+
+struct cqe {
+    uint32_t status;
+    uint16_t id;
+    uint16_t info;          /* Bit 0: phase tag */
+};
+
+struct bench {
+    /* Legacy: shared occupancy count, as struct pcie_sim_ring uses */
+    struct legacy_desc legacy[RING_SIZE] __attribute__((aligned(CACHE_LINE)));
+    int count __attribute__((aligned(CACHE_LINE)));
+
+    /* Split: the doorbell is the only index both sides touch */
+    struct sq_desc sq[RING_SIZE] __attribute__((aligned(CACHE_LINE)));
+    struct cqe cq[RING_SIZE] __attribute__((aligned(CACHE_LINE)));
+    uint32_t sq_doorbell __attribute__((aligned(CACHE_LINE)));
+
+    unsigned long descriptors;
+    int yield;              /* One CPU: spinning would burn whole timeslices */
+    int driver_cpu;
+    int device_cpu;
+};
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/* Spin-wait hint to the CPU, where the architecture has one */
+static inline void cpu_relax(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield" ::: "memory");
+#else
+    __asm__ __volatile__("" ::: "memory");
+#endif
+}
+
+static inline void spin(const struct bench *b)
+{
+    if (b->yield)
+        sched_yield();
+    else
+        cpu_relax();
+}
+
+/*
+ * First two CPUs this process may run on, from its affinity mask. Returns
+ * the number found, so 1 means the threads have to time-share.
+ */
+static int pick_cpus(int *first, int *second)
+{
+    cpu_set_t set;
+    int cpu, found = 0;
+
+    if (sched_getaffinity(0, sizeof(set), &set) != 0)
+        return 1;
+
+    for (cpu = 0; cpu < CPU_SETSIZE && found < 2; cpu++) {
+        if (!CPU_ISSET(cpu, &set))
+            continue;
+        if (found++ == 0)
+            *first = cpu;
+        else
+            *second = cpu;
+    }
+    return found;
+}
+
+static void pin(int cpu)
+{
+    cpu_set_t set;
+
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+/* Device side, legacy: consume in order, write status into the descriptor */
+static void *legacy_device(void *arg)
+{
+    struct bench *b = arg;
+    uint32_t tail = 0;
+    unsigned long done;
+
+    if (!b->yield)
+        pin(b->device_cpu);
+
+    for (done = 0; done < b->descriptors; done++) {
+        struct legacy_desc *d = &b->legacy[tail];
+
+        while (__atomic_load_n(&b->count, __ATOMIC_ACQUIRE) == 0)
+            spin(b);
+
+        (void)d->length;
+        __atomic_store_n(&d->status, 1, __ATOMIC_RELEASE);
+        __atomic_sub_fetch(&b->count, 1, __ATOMIC_ACQ_REL);
+        tail = (tail + 1) % RING_SIZE;
+    }
+
+    return NULL;
+}
+
+/* Driver side, legacy: fill descriptors, reap by polling their status */
+static void legacy_driver(struct bench *b)
+{
+    uint32_t head = 0, reap = 0;
+    unsigned long submitted = 0, reaped = 0;
+
+    while (reaped < b->descriptors) {
+        while (submitted < b->descriptors &&
+               __atomic_load_n(&b->count, __ATOMIC_ACQUIRE) < RING_SIZE &&
+               submitted - reaped < RING_SIZE) {
+            struct legacy_desc *d = &b->legacy[head];
+
+            d->buffer_addr = submitted;
+            d->length = 4096;
+            d->flags = 0;
+            d->timestamp = submitted;
+            d->status = 0;
+            __atomic_add_fetch(&b->count, 1, __ATOMIC_ACQ_REL);
+            head = (head + 1) % RING_SIZE;
+            submitted++;
+        }
+
+        if (__atomic_load_n(&b->legacy[reap].status, __ATOMIC_ACQUIRE)) {
+            reap = (reap + 1) % RING_SIZE;
+            reaped++;
+        } else {
+            spin(b);
+        }
+    }
+}
+
+/* Device side, split: read the SQ, post phase-tagged CQEs */
+static void *split_device(void *arg)
+{
+    struct bench *b = arg;
+    uint32_t tail = 0;
+    uint16_t phase = 1;
+    unsigned long done;
+
+    if (!b->yield)
+        pin(b->device_cpu);
+
+    for (done = 0; done < b->descriptors; done++) {
+        struct cqe *c = &b->cq[tail];
+
+        while (__atomic_load_n(&b->sq_doorbell, __ATOMIC_ACQUIRE) == tail)
+            spin(b);
+
+        c->status = 0;
+        c->id = b->sq[tail].id;
+        __atomic_store_n(&c->info, phase, __ATOMIC_RELEASE);
+
+        if (++tail == RING_SIZE) {
+            tail = 0;
+            phase ^= 1;
+        }
+    }
+
+    return NULL;
+}
+
+/* Driver side, split: ring the doorbell, reap by the phase tag alone */
+static void split_driver(struct bench *b)
+{
+    uint32_t head = 0, cq_head = 0;
+    uint16_t phase = 1;
+    unsigned long submitted = 0, reaped = 0;
+
+    while (reaped < b->descriptors) {
+        unsigned long before = submitted;
+
+        while (submitted < b->descriptors && submitted - reaped < RING_SIZE - 1) {
+            struct sq_desc *d = &b->sq[head];
+
+            d->buffer_addr = submitted;
+            d->length = 4096;
+            d->flags = 0;
+            d->id = (uint16_t)head;
+            head = (head + 1) % RING_SIZE;
+            submitted++;
+        }
+        if (submitted != before)
+            __atomic_store_n(&b->sq_doorbell, head, __ATOMIC_RELEASE);
+
+        if (__atomic_load_n(&b->cq[cq_head].info, __ATOMIC_ACQUIRE) == phase) {
+            if (++cq_head == RING_SIZE) {
+                cq_head = 0;
+                phase ^= 1;
+            }
+            reaped++;
+        } else {
+            spin(b);
+        }
+    }
+}
+
+/* Count L1D read misses of this process and the threads it starts */
+static int open_miss_counter(void)
+{
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HW_CACHE;
+    attr.config = PERF_COUNT_HW_CACHE_L1D |
+                  (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                  (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    attr.disabled = 1;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static void run(const char *name, struct bench *b, void *(*device)(void *),
+                void (*driver)(struct bench *))
+{
+    pthread_t thread;
+    uint64_t start, elapsed, misses = 0;
+    int fd = open_miss_counter();
+
+    if (fd >= 0) {
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+
+    start = now_ns();
+    pthread_create(&thread, NULL, device, b);
+    driver(b);
+    pthread_join(thread, NULL);
+    elapsed = now_ns() - start;
+
+    if (fd >= 0) {
+        ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        if (read(fd, &misses, sizeof(misses)) != sizeof(misses))
+            misses = 0;
+        close(fd);
+    }
+
+    printf("  %-28s %8.1f ns/descriptor", name, (double)elapsed / b->descriptors);
+    if (fd >= 0)
+        printf("  %6.2f L1D misses/descriptor\n", (double)misses / b->descriptors);
+    else
+        printf("  L1D misses: n/a (perf events unavailable)\n");
+}
+
+int main(int argc, char *argv[])
+{
+    struct bench *b;
+    char placement[64];
+
+    b = aligned_alloc(CACHE_LINE, sizeof(*b));
+    if (!b) {
+        printf("Out of memory\n");
+        return 1;
+    }
+    memset(b, 0, sizeof(*b));
+
+    b->descriptors = argc > 1 ? strtoul(argv[1], NULL, 0) : 0;
+    if (b->descriptors == 0)
+        b->descriptors = DEFAULT_DESCRIPTORS;
+    b->yield = pick_cpus(&b->driver_cpu, &b->device_cpu) < 2;
+    if (b->yield) {
+        b->descriptors = b->descriptors / 100 ? b->descriptors / 100 : 1;
+        snprintf(placement, sizeof(placement), "one CPU: threads time-share");
+    } else {
+        pin(b->driver_cpu);
+        snprintf(placement, sizeof(placement), "driver CPU %d, device CPU %d",
+                 b->driver_cpu, b->device_cpu);
+    }
+
+    printf("Ring layout benchmark (%lu descriptors, %d-entry ring, %s)\n",
+           b->descriptors, RING_SIZE, placement);
+    printf("  legacy: %zu-byte shared descriptors + shared count\n", sizeof(struct legacy_desc));
+    printf("  split:  %zu-byte SQ entries + %zu-byte phase-tagged CQ entries\n\n",
+           sizeof(struct sq_desc), sizeof(struct cqe));
+
+    run("legacy (status in descriptor)", b, legacy_device, legacy_driver);
+    run("split SQ/CQ with phase bit", b, split_device, split_driver);
+
+    free(b);
+    return 0;
+}
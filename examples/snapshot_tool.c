@@ -0,0 +1,258 @@
+/*
+ * PCIe Simulator - Snapshot Tool
+ *
+ * Copyright (c) 2025 Karan Mamaniya <kmamaniya@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Saves, restores and inspects device snapshots, for the kernel module
+ * (ioctls on /dev/pcie_simN) or the simulation backend.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <inttypes.h>
+#include <sys/ioctl.h>
+#include "../lib/pcie_sim.h"
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s save|load|info FILE [-d DEVICE] [-k]\n"
+            "  save  Write the device state to FILE\n"
+            "  load  Restore the device state from FILE\n"
+            "  info  List the sections in FILE\n"
+            "  -d    Device number (default 0)\n"
+            "  -k    Use /dev/pcie_simN instead of the simulation backend\n",
+            prog);
+}
+
+static void *read_file(const char *path, size_t *size)
+{
+    FILE *f = fopen(path, "rb");
+    void *buf = NULL;
+    long len;
+
+    if (!f)
+        return NULL;
+
+    if (fseek(f, 0, SEEK_END) == 0 && (len = ftell(f)) > 0 &&
+        (unsigned long)len <= PCIE_SIM_SNAPSHOT_MAX_SIZE && fseek(f, 0, SEEK_SET) == 0) {
+        buf = malloc(len);
+        if (buf && fread(buf, 1, len, f) != (size_t)len) {
+            free(buf);
+            buf = NULL;
+        }
+        *size = len;
+    }
+
+    fclose(f);
+    return buf;
+}
+
+static int write_file(const char *path, const void *buf, size_t size)
+{
+    FILE *f = fopen(path, "wb");
+    int ret = 0;
+
+    if (!f)
+        return -1;
+    if (fwrite(buf, 1, size, f) != size)
+        ret = -1;
+    if (fclose(f) != 0)
+        ret = -1;
+    return ret;
+}
+
+/* Save or load through the kernel module's ioctls */
+static int kernel_snapshot(int device, int save, const char *path)
+{
+    struct pcie_sim_snapshot_buf req = { 0 };
+    char node[64];
+    void *buf = NULL;
+    size_t size = 0;
+    int fd, ret = -1;
+
+    snprintf(node, sizeof(node), "/dev/pcie_sim%d", device);
+    fd = open(node, O_RDWR);
+    if (fd < 0) {
+        fprintf(stderr, "%s: %s\n", node, strerror(errno));
+        return -1;
+    }
+
+    if (save) {
+        /* The first call only reports the size */
+        if (ioctl(fd, PCIE_SIM_IOC_SAVE_SNAPSHOT, &req) == 0 || errno != ENOSPC) {
+            fprintf(stderr, "snapshot: %s\n", strerror(errno));
+            goto out;
+        }
+        buf = malloc(req.used);
+        if (!buf)
+            goto out;
+        req.data = (uintptr_t)buf;
+        req.size = req.used;
+        if (ioctl(fd, PCIE_SIM_IOC_SAVE_SNAPSHOT, &req) != 0) {
+            fprintf(stderr, "snapshot: %s\n", strerror(errno));
+            goto out;
+        }
+        ret = write_file(path, buf, req.used);
+        size = req.used;
+    } else {
+        buf = read_file(path, &size);
+        if (!buf) {
+            fprintf(stderr, "%s: cannot read snapshot\n", path);
+            goto out;
+        }
+        req.data = (uintptr_t)buf;
+        req.size = size;
+        ret = ioctl(fd, PCIE_SIM_IOC_LOAD_SNAPSHOT, &req);
+        if (ret != 0)
+            fprintf(stderr, "restore: %s\n", strerror(errno));
+    }
+
+    if (ret == 0)
+        printf("%s %s: %zu bytes\n", save ? "Saved" : "Restored", node, size);
+
+out:
+    free(buf);
+    close(fd);
+    return ret;
+}
+
+/* Save or load through the library's simulation backend */
+static int sim_snapshot(int device, int save, const char *path)
+{
+    pcie_sim_handle_t handle;
+    pcie_sim_error_t ret;
+
+    ret = pcie_sim_open(device, &handle);
+    if (ret != PCIE_SIM_SUCCESS) {
+        fprintf(stderr, "open: %s\n", pcie_sim_error_string(ret));
+        return -1;
+    }
+
+    ret = save ? pcie_sim_snapshot_save(handle, path) : pcie_sim_snapshot_load(handle, path);
+    if (ret != PCIE_SIM_SUCCESS)
+        fprintf(stderr, "%s: %s\n", save ? "save" : "load", pcie_sim_error_string(ret));
+    else
+        printf("%s simulated device %d: %s\n", save ? "Saved" : "Restored", device, path);
+
+    pcie_sim_close(handle);
+    return ret == PCIE_SIM_SUCCESS ? 0 : -1;
+}
+
+static const char *section_name(uint32_t type)
+{
+    switch (type) {
+    case PCIE_SIM_SNAP_REGS:        return "registers";
+    case PCIE_SIM_SNAP_STATS:       return "statistics";
+    case PCIE_SIM_SNAP_ERROR:       return "error injection";
+    case PCIE_SIM_SNAP_RNG:         return "rng";
+    case PCIE_SIM_SNAP_MMIO:        return "mmio";
+    case PCIE_SIM_SNAP_RING_CONFIG: return "ring config";
+    case PCIE_SIM_SNAP_RING:        return "ring";
+    case PCIE_SIM_SNAP_TRANSFER_STATS: return "transfer stats";
+    case PCIE_SIM_SNAP_LATENCY_SQ:  return "latency squares";
+    default:                        return "unknown";
+    }
+}
+
+/* List the sections of a snapshot file */
+static int snapshot_info(const char *path)
+{
+    const struct pcie_sim_snapshot_section *s = NULL;
+    const struct pcie_sim_snapshot_header *h;
+    size_t size;
+    void *buf;
+
+    buf = read_file(path, &size);
+    if (!buf || pcie_sim_snapshot_check(buf, size) != 0) {
+        fprintf(stderr, "%s: not a valid snapshot\n", path);
+        free(buf);
+        return -1;
+    }
+
+    h = buf;
+    printf("%s: version %u, %u bytes, %u sections, checksum %08x\n",
+           path, h->version, h->size, h->sections, h->checksum);
+
+    while ((s = pcie_sim_snapshot_next(buf, s)) != NULL) {
+        printf("  %-16s %8u bytes", section_name(s->type), s->size);
+        if (s->type == PCIE_SIM_SNAP_STATS) {
+            const struct pcie_sim_snapshot_stats *st = (const void *)(s + 1);
+            printf("  %" PRIu64 " transfers, %" PRIu64 " bytes, %" PRIu64 " errors",
+                   st->total_transfers, st->total_bytes, st->total_errors);
+            if (s->size >= sizeof(*st))
+                printf(", stddev %" PRIu64 " ns", st->stddev_latency_ns);
+        } else if (s->type == PCIE_SIM_SNAP_RING_CONFIG) {
+            const struct pcie_sim_snapshot_ring_config *rc = (const void *)(s + 1);
+            printf("  %u x %u descriptors", rc->num_rings, rc->ring_size);
+        } else if (s->type == PCIE_SIM_SNAP_RING) {
+            const struct pcie_sim_snapshot_ring *r = (const void *)(s + 1);
+            printf("  %s%u head %u, %" PRIu64 " completions",
+                   r->direction ? "RX" : "TX", r->queue, r->head, r->completions);
+        }
+        printf("\n");
+    }
+
+    free(buf);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *cmd, *path;
+    int device = 0, use_kernel = 0;
+    int i;
+
+    if (argc < 3) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    cmd = argv[1];
+    path = argv[2];
+    for (i = 3; i < argc; i++) {
+        if (strcmp(argv[i], "-k") == 0)
+            use_kernel = 1;
+        else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc)
+            device = atoi(argv[++i]);
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (strcmp(cmd, "info") == 0)
+        return snapshot_info(path) ? 1 : 0;
+
+    if (strcmp(cmd, "save") != 0 && strcmp(cmd, "load") != 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (use_kernel)
+        return kernel_snapshot(device, strcmp(cmd, "save") == 0, path) ? 1 : 0;
+    return sim_snapshot(device, strcmp(cmd, "save") == 0, path) ? 1 : 0;
+}
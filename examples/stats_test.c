@@ -0,0 +1,154 @@
+/*
+ * PCIe Simulator - Statistics Arithmetic Check
+ *
+ * Copyright (c) 2025 Karan Mamaniya <kmamaniya@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Checks the integer latency statistics in stats.h against a double
+ * precision reference, from microsecond spreads to spreads of seconds,
+ * and that a snapshot carries the sums of squares through a restore.
+ * Exits non-zero on any mismatch.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <inttypes.h>
+#include "../lib/pcie_sim.h"
+
+#define SAMPLES 10000
+
+static uint64_t latencies[SAMPLES];
+
+/* Deterministic 64-bit generator, so a failure reproduces */
+static uint64_t next_random(uint64_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+/* Population standard deviation, two-pass */
+static double reference_stddev(const uint64_t *v, int n)
+{
+    double mean = 0.0, var = 0.0;
+    int i;
+
+    for (i = 0; i < n; i++)
+        mean += (double)v[i];
+    mean /= n;
+    for (i = 0; i < n; i++)
+        var += ((double)v[i] - mean) * ((double)v[i] - mean);
+    return sqrt(var / n);
+}
+
+/* Latencies base + [0, spread) through pcie_sim_stats_summary() */
+static int check_spread(uint64_t base, uint64_t spread)
+{
+    struct pcie_sim_transfer_stats xfer;
+    struct pcie_sim_latency_sq sq;
+    struct pcie_sim_stats stats;
+    uint64_t state = 0x9e3779b97f4a7c15ULL ^ spread;
+    double expected, slack;
+    int i;
+
+    memset(&xfer, 0, sizeof(xfer));
+    memset(&sq, 0, sizeof(sq));
+    for (i = 0; i < SAMPLES; i++) {
+        latencies[i] = base + next_random(&state) % spread;
+        pcie_sim_stats_account(&xfer, i & 1, 64, latencies[i]);
+        pcie_sim_stats_account_sq(&sq, i & 1, latencies[i]);
+    }
+    pcie_sim_stats_summary(&xfer, &sq, &stats);
+
+    /* Floor of the exact root, against the rounding of the reference */
+    expected = reference_stddev(latencies, SAMPLES);
+    slack = 1.0 + expected * 1e-9;
+    printf("  spread %20" PRIu64 " ns: stddev %14" PRIu64 " ns, reference %16.1f ns  %s\n",
+           spread, stats.stddev_latency_ns, expected,
+           fabs((double)stats.stddev_latency_ns - expected) <= slack ? "ok" : "MISMATCH");
+
+    return fabs((double)stats.stddev_latency_ns - expected) <= slack ? 0 : 1;
+}
+
+/* Snapshot, reset and restore a simulated device; the squares must survive */
+static int check_snapshot(void)
+{
+    struct pcie_sim_stats_ex before, after;
+    pcie_sim_handle_t handle;
+    uint8_t buffer[4096];
+    size_t used = 0;
+    void *snapshot;
+    int i, ret = 1;
+
+    if (pcie_sim_open(0, &handle) != PCIE_SIM_SUCCESS) {
+        printf("  snapshot: cannot open device 0, skipped\n");
+        return 0;
+    }
+
+    for (i = 0; i < 32; i++)
+        pcie_sim_transfer(handle, buffer, 64 + i * 64, i & 1, NULL);
+
+    memset(&before, 0, sizeof(before));
+    before.hdr.size = sizeof(before);
+    pcie_sim_get_stats_ex(handle, &before);
+
+    pcie_sim_snapshot(handle, NULL, 0, &used);
+    snapshot = malloc(used);
+    if (snapshot && pcie_sim_snapshot(handle, snapshot, used, &used) == PCIE_SIM_SUCCESS) {
+        pcie_sim_reset_stats(handle);
+        pcie_sim_restore(handle, snapshot, used);
+
+        memset(&after, 0, sizeof(after));
+        after.hdr.size = sizeof(after);
+        pcie_sim_get_stats_ex(handle, &after);
+        ret = memcmp(&before.latency_sq, &after.latency_sq, sizeof(before.latency_sq)) != 0;
+    }
+    printf("  snapshot: sums of squares %s\n", ret ? "MISMATCH" : "restored exactly");
+
+    free(snapshot);
+    pcie_sim_close(handle);
+    return ret;
+}
+
+int main(void)
+{
+    static const uint64_t spreads[] = {
+        1000ULL,                    /* 1 us */
+        1000000ULL,                 /* 1 ms */
+        4000000000ULL,              /* Just under 2^32 ns */
+        20000000000ULL,             /* 20 s: variance beyond 2^64 ns^2 */
+        1000000000000ULL,           /* 1000 s */
+    };
+    int failures = 0;
+    size_t i;
+
+    printf("Latency standard deviation against a double reference:\n");
+    for (i = 0; i < sizeof(spreads) / sizeof(spreads[0]); i++)
+        failures += check_spread(1000, spreads[i]);
+    failures += check_spread(4000000000000ULL, 1000000);
+
+    failures += check_snapshot();
+
+    printf("%s\n", failures ? "FAILED" : "All checks passed");
+    return failures ? 1 : 0;
+}
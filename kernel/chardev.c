@@ -33,6 +33,7 @@
 static int pcie_sim_open(struct inode *inode, struct file *filp)
 {
     struct pcie_sim_device *dev;
+    int ret;
 
     dev = container_of(inode->i_cdev, struct pcie_sim_device, cdev);
     filp->private_data = dev;
@@ -40,6 +41,11 @@ static int pcie_sim_open(struct inode *inode, struct file *filp)
     if (!dev->enabled)
         return -ENODEV;
 
+    /* The first open brings up BAR0 and the engines */
+    ret = pcie_sim_device_get(dev);
+    if (ret)
+        return ret;
+
     pr_debug("Device %d opened\n", dev->device_id);
     return 0;
 }
@@ -51,8 +57,10 @@ static int pcie_sim_release(struct inode *inode, struct file *filp)
 {
     struct pcie_sim_device *dev = filp->private_data;
 
-    if (dev)
+    if (dev) {
+        pcie_sim_device_put(dev);
         pr_debug("Device %d closed\n", dev->device_id);
+    }
 
     return 0;
 }
@@ -74,36 +82,107 @@ long pcie_sim_char_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
         return -EINVAL;
     }
 
-    /* Serialize IOCTL operations */
+    /*
+     * Transfers go through the calling CPU's queue pair and do not take
+     * the device mutex, so submitters on different CPUs never contend.
+     * The extended request is the plain one followed by the phase times.
+     */
+    if (cmd == PCIE_SIM_IOC_TRANSFER || cmd == PCIE_SIM_IOC_TRANSFER_EX) {
+        struct pcie_sim_transfer_req_ex req;
+        size_t len = cmd == PCIE_SIM_IOC_TRANSFER_EX ? sizeof(req) : sizeof(req.req);
+
+        if (copy_from_user(&req, (void __user *)arg, len))
+            return -EFAULT;
+
+        percpu_down_read(&dev->ring_sem);
+        ret = pcie_sim_dma_transfer(dev, &req.req, req.phase_ns);
+        percpu_up_read(&dev->ring_sem);
+        if (ret == 0 && copy_to_user((void __user *)arg, &req, len))
+            ret = -EFAULT;
+        return ret;
+    }
+
+    /* Serialize the remaining IOCTL operations */
     if (mutex_lock_interruptible(&dev->mutex))
         return -ERESTARTSYS;
 
     switch (cmd) {
-    case PCIE_SIM_IOC_TRANSFER:
+
+    case PCIE_SIM_IOC_GET_STATS:
+    case PCIE_SIM_IOC_GET_STATS_V1:
+    {
+        struct pcie_sim_stats stats;
+
+        pcie_sim_stats_read(dev, &stats);
+        if (copy_to_user((void __user *)arg, &stats, _IOC_SIZE(cmd)))
+            ret = -EFAULT;
+        break;
+    }
+
+    case PCIE_SIM_IOC_GET_STATS_EX:
+        ret = pcie_sim_stats_get_ex(dev, (struct pcie_sim_stats_header __user *)arg);
+        break;
+
+    case PCIE_SIM_IOC_RESET_STATS:
+        pcie_sim_stats_reset(dev);
+        pr_debug("Device %d statistics reset\n", dev->device_id);
+        break;
+
+    case PCIE_SIM_IOC_RESET_STATS_EPOCH:
+    {
+        u64 epoch = pcie_sim_stats_reset(dev);
+
+        if (put_user(epoch, (__u64 __user *)arg))
+            ret = -EFAULT;
+        break;
+    }
+
+    case PCIE_SIM_IOC_SET_RING_CONFIG:
     {
-        struct pcie_sim_transfer_req req;
+        struct pcie_sim_ring_config config;
 
-        if (copy_from_user(&req, (void __user *)arg, sizeof(req))) {
+        if (copy_from_user(&config, (void __user *)arg, sizeof(config))) {
             ret = -EFAULT;
             break;
         }
 
-        ret = pcie_sim_dma_transfer(dev, &req);
-        if (ret == 0) {
-            if (copy_to_user((void __user *)arg, &req, sizeof(req)))
-                ret = -EFAULT;
-        }
+        /* No transfer is in flight under the write lock; park the engines too */
+        percpu_down_write(&dev->ring_sem);
+        pcie_sim_engine_park(dev);
+        ret = pcie_sim_ring_configure(dev, config.ring_size, config.num_rings);
+        pcie_sim_engine_unpark(dev);
+        percpu_up_write(&dev->ring_sem);
         break;
     }
 
-    case PCIE_SIM_IOC_GET_STATS:
-        if (copy_to_user((void __user *)arg, &dev->stats, sizeof(dev->stats)))
+    case PCIE_SIM_IOC_GET_RING_CONFIG:
+    {
+        struct pcie_sim_ring_config config = {
+            .ring_size = dev->ring_size,
+            .num_rings = dev->num_rings,
+        };
+
+        if (copy_to_user((void __user *)arg, &config, sizeof(config)))
             ret = -EFAULT;
         break;
+    }
 
-    case PCIE_SIM_IOC_RESET_STATS:
-        memset(&dev->stats, 0, sizeof(dev->stats));
-        pr_debug("Device %d statistics reset\n", dev->device_id);
+    case PCIE_SIM_IOC_GET_MEMORY_STATS:
+    {
+        struct pcie_sim_memory_stats mem;
+
+        pcie_sim_memory_usage(dev, &mem);
+        if (copy_to_user((void __user *)arg, &mem, sizeof(mem)))
+            ret = -EFAULT;
+        break;
+    }
+
+    case PCIE_SIM_IOC_SAVE_SNAPSHOT:
+        ret = pcie_sim_snapshot_save(dev, (struct pcie_sim_snapshot_buf __user *)arg);
+        break;
+
+    case PCIE_SIM_IOC_LOAD_SNAPSHOT:
+        ret = pcie_sim_snapshot_load(dev, (struct pcie_sim_snapshot_buf __user *)arg);
         break;
 
     default:
@@ -116,6 +195,16 @@ long pcie_sim_char_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
     return ret;
 }
 
+/*
+ * Character device mmap operation: the read-only counter page
+ */
+static int pcie_sim_mmap(struct file *filp, struct vm_area_struct *vma)
+{
+    struct pcie_sim_device *dev = filp->private_data;
+
+    return pcie_sim_stats_mmap(dev, vma);
+}
+
 /* File operations structure */
 static const struct file_operations pcie_sim_fops = {
     .owner = THIS_MODULE,
@@ -123,6 +212,7 @@ static const struct file_operations pcie_sim_fops = {
     .release = pcie_sim_release,
     .unlocked_ioctl = pcie_sim_char_ioctl,
     .compat_ioctl = pcie_sim_char_ioctl,
+    .mmap = pcie_sim_mmap,
 };
 
 /*
@@ -159,7 +249,7 @@ int pcie_sim_char_init(struct pcie_sim_device *dev)
         return ret;
     }
 
-    pr_info("Character device /dev/%s created\n", dev_name);
+    pr_debug("Character device /dev/%s created\n", dev_name);
     return 0;
 }
 
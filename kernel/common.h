@@ -40,17 +40,42 @@
 #include <linux/delay.h>
 #include <linux/ktime.h>
 #include <linux/random.h>
+#include <linux/percpu-rwsem.h>
+#include <linux/completion.h>
+#include <linux/kthread.h>
+#include <linux/wait.h>
+#include <linux/prandom.h>
+#include <linux/workqueue.h>
+
+#include "../lib/regs.h"
+#include "../lib/snapshot.h"
+#include "../lib/stats.h"
 
 #define DRIVER_NAME "pcie_sim"
 #define DRIVER_VERSION "1.0"
-#define DEVICE_COUNT 1
+#define MAX_DEVICES 64
 
 /* IOCTL commands */
 #define PCIE_SIM_IOC_MAGIC 'P'
 #define PCIE_SIM_IOC_TRANSFER    _IOWR(PCIE_SIM_IOC_MAGIC, 1, struct pcie_sim_transfer_req)
 #define PCIE_SIM_IOC_GET_STATS   _IOR(PCIE_SIM_IOC_MAGIC, 2, struct pcie_sim_stats)
+/* GET_STATS as built against struct pcie_sim_stats before stddev_latency_ns */
+#define PCIE_SIM_IOC_GET_STATS_V1 _IOC(_IOC_READ, PCIE_SIM_IOC_MAGIC, 2, \
+                                       offsetof(struct pcie_sim_stats, stddev_latency_ns))
 #define PCIE_SIM_IOC_RESET_STATS _IO(PCIE_SIM_IOC_MAGIC, 3)
 #define PCIE_SIM_IOC_SET_ERROR   _IOW(PCIE_SIM_IOC_MAGIC, 4, struct pcie_sim_error_config)
+#define PCIE_SIM_IOC_SET_RING_CONFIG _IOW(PCIE_SIM_IOC_MAGIC, 5, struct pcie_sim_ring_config)
+#define PCIE_SIM_IOC_GET_RING_CONFIG _IOR(PCIE_SIM_IOC_MAGIC, 6, struct pcie_sim_ring_config)
+#define PCIE_SIM_IOC_SAVE_SNAPSHOT _IOWR(PCIE_SIM_IOC_MAGIC, 7, struct pcie_sim_snapshot_buf)
+#define PCIE_SIM_IOC_LOAD_SNAPSHOT _IOW(PCIE_SIM_IOC_MAGIC, 8, struct pcie_sim_snapshot_buf)
+#define PCIE_SIM_IOC_GET_MEMORY_STATS _IOR(PCIE_SIM_IOC_MAGIC, 9, struct pcie_sim_memory_stats)
+#define PCIE_SIM_IOC_GET_STATS_EX _IOWR(PCIE_SIM_IOC_MAGIC, 10, struct pcie_sim_stats_header)
+#define PCIE_SIM_IOC_RESET_STATS_EPOCH _IOR(PCIE_SIM_IOC_MAGIC, 11, __u64)
+#define PCIE_SIM_IOC_TRANSFER_EX _IOWR(PCIE_SIM_IOC_MAGIC, 12, struct pcie_sim_transfer_req_ex)
+
+/* Ring geometry limits; ring sizes are powers of two */
+#define PCIE_SIM_RING_MIN_SIZE 8
+#define PCIE_SIM_RING_MAX_SIZE 65536
 
 /* Error scenario constants */
 #define PCIE_SIM_ERROR_SCENARIO_NONE        0
@@ -58,16 +83,6 @@
 #define PCIE_SIM_ERROR_SCENARIO_CORRUPTION  2
 #define PCIE_SIM_ERROR_SCENARIO_OVERRUN     3
 
-/* Device statistics structure */
-struct pcie_sim_stats {
-    atomic64_t total_transfers;
-    atomic64_t total_bytes;
-    atomic64_t total_errors;
-    u64 avg_latency_ns;
-    u64 min_latency_ns;
-    u64 max_latency_ns;
-};
-
 /* Transfer request structure */
 struct pcie_sim_transfer_req {
     void __user *buffer;
@@ -76,6 +91,12 @@ struct pcie_sim_transfer_req {
     u64 latency_ns; /* Returned latency */
 };
 
+/* Transfer that also returns the time spent in each PCIE_SIM_PHASE_* */
+struct pcie_sim_transfer_req_ex {
+    struct pcie_sim_transfer_req req;
+    u64 phase_ns[PCIE_SIM_PHASES];
+};
+
 /* Error configuration structure */
 struct pcie_sim_error_config {
     u32 scenario;           /* Error scenario (0-3) */
@@ -84,30 +105,163 @@ struct pcie_sim_error_config {
     u32 flags;              /* Configuration flags */
 };
 
-/* Ring buffer descriptor */
-struct pcie_sim_ring_desc {
+/* Ring geometry configuration */
+struct pcie_sim_ring_config {
+    u32 ring_size;          /* Descriptors per ring */
+    u32 num_rings;          /* Rings per direction (1-PCIE_SIM_MAX_QUEUES) */
+};
+
+/*
+ * Memory held by a device, by subsystem. Each field counts memory the
+ * others do not, so total_bytes is their sum (bounce_peak_bytes excluded).
+ */
+struct pcie_sim_memory_stats {
+    u64 total_bytes;
+    u64 device_bytes;       /* Device structure, less the counters below */
+    u64 bar_bytes;          /* BAR0 backing memory */
+    u64 ring_bytes;         /* Descriptor queues and slot arrays */
+    u64 bounce_bytes;       /* Transfer bounce buffers in use */
+    u64 bounce_peak_bytes;  /* Most bounce_bytes seen */
+    u64 stats_bytes;        /* Statistics, MMIO and per-CPU counters */
+    u64 engine_bytes;       /* Engine thread stacks */
+};
+
+/*
+ * Submission queue entry: written by the driver, read by the device.
+ * Four per cache line; the device never writes to this array.
+ */
+struct pcie_sim_sq_desc {
     u64 buffer_addr;    /* Physical address of buffer */
     u32 length;         /* Transfer length */
-    u32 flags;          /* Control flags */
-    u64 timestamp;      /* Submission timestamp */
+    u16 flags;          /* Control flags */
+    u16 id;             /* Submission slot, echoed in the completion */
+};
+
+/*
+ * Completion queue entry: written by the device, read by the driver.
+ * The phase tag flips on every pass over the queue, so the driver can
+ * tell a new entry from a stale one without reading a device index.
+ */
+struct pcie_sim_cqe {
     u32 status;         /* Completion status */
+    u16 id;             /* Submission slot completed */
+    u16 info;           /* PCIE_SIM_CQE_PHASE */
+};
+
+#define PCIE_SIM_CQE_PHASE (1U << 0)
+
+/* Driver-private per-slot state, outside device-visible memory */
+struct pcie_sim_slot {
+    u64 submit_ns;      /* Submission time */
+    u64 start_ns;       /* Device started executing the descriptor */
+    u64 done_ns;        /* Device completed it */
+    int cpu;            /* Submitting CPU */
     u32 reserved;
+    void *ctx;          /* Submitter's request, handed back on completion */
+};
+
+/* A reaped completion */
+struct pcie_sim_completion {
+    u64 latency_ns;     /* Submission to reap */
+    u64 start_ns;       /* Device timestamps, as in struct pcie_sim_slot */
+    u64 done_ns;
+    u32 status;
+    u16 id;             /* Submission slot */
+    int cpu;            /* Submitting CPU */
+    void *ctx;
+};
+
+/* A transfer waiting for its descriptor to complete */
+struct pcie_sim_request {
+    struct completion done;
+    u32 status;         /* Completion status, valid once done */
+    u64 start_ns;       /* Device timestamps, valid once done */
+    u64 done_ns;
 };
 
-/* Ring buffer structure */
+/* Per-CPU queue statistics */
+struct pcie_sim_cpu_stats {
+    u64 submissions;
+    u64 completions;
+    u64 remote_completions;     /* Reaped on a CPU other than the submitter's */
+};
+
+/* Most completions the device holds before writing them back */
+#define PCIE_SIM_RING_MAX_WRITEBACK 64
+
+/* poll_state bit: one poller at a time consumes a ring's descriptors */
+#define PCIE_SIM_RING_POLLING 0
+
+/*
+ * Device engine thread. Engine i services queue pairs q with
+ * q % num_engines == i, polling each ring up to engine_budget
+ * descriptors per pass and sleeping until a doorbell when all are idle.
+ */
+struct pcie_sim_engine {
+    struct task_struct *task;
+    struct pcie_sim_device *dev;
+    wait_queue_head_t wait;
+    atomic_t kicked;            /* Doorbell since the last pass */
+    int cpu;                    /* Pinned CPU, -1 when unbound */
+    u32 index;
+
+    /* Statistics */
+    atomic64_t passes;          /* Polling passes over the engine's rings */
+    atomic64_t descriptors;     /* Descriptors executed */
+    atomic64_t budget_exhausted;    /* Passes that left work for the next one */
+    atomic64_t sleeps;          /* Times the engine went idle */
+};
+
+/*
+ * Ring buffer structure. Each index has a single writer: the driver owns
+ * head, sq_reaped and the CQ consumer state, the device owns tail and the
+ * CQ producer state. Nothing is shared read-modify-write; the driver sees
+ * progress only through phase-tagged completion entries.
+ */
 struct pcie_sim_ring {
-    struct pcie_sim_ring_desc *descriptors;
-    dma_addr_t desc_dma_addr;
-    u32 size;           /* Number of descriptors */
-    u32 head;           /* Producer index */
-    u32 tail;           /* Consumer index */
-    atomic_t count;     /* Current entries */
-    spinlock_t lock;    /* Ring protection */
+    struct pcie_sim_sq_desc *sq;    /* Allocated on first post */
+    struct pcie_sim_cqe *cq;        /* Follows sq in the same allocation */
+    struct pcie_sim_slot *slots;    /* Driver-private, one per SQ entry */
+    dma_addr_t sq_dma_addr;
+    dma_addr_t cq_dma_addr;
+    struct mutex alloc_lock;
+    u32 size;           /* Number of descriptors; one slot is kept free */
+    u32 doorbell_reg;   /* BAR0 offset of the tail doorbell */
+
+    /* Driver side: submission */
+    spinlock_t sq_lock ____cacheline_aligned_in_smp;
+    u32 head;           /* Next SQ slot to fill */
+    u32 unposted;       /* Submitted since the last doorbell */
+
+    /* Driver side: completion reaping */
+    spinlock_t cq_lock ____cacheline_aligned_in_smp;
+    u32 cq_head;        /* Next CQ entry to reap */
+    u16 cq_expected;    /* Phase tag of a new entry at cq_head */
+    u32 sq_reaped;      /* SQ slots before this index are free */
+    u64 reaped;         /* Completions reaped, under cq_lock */
+
+    /* Device side: descriptor engine */
+    spinlock_t lock ____cacheline_aligned_in_smp;
+    u32 tail;           /* Next SQ slot to consume */
+    u32 doorbell_tail;  /* Last tail written to the doorbell */
+    u32 fetched;        /* Descriptors fetched and not yet consumed */
+    u32 wb_head;        /* First consumed descriptor awaiting writeback */
+    u32 wb_pending;     /* Consumed descriptors awaiting writeback */
+    u32 wb_status[PCIE_SIM_RING_MAX_WRITEBACK];
+    u32 cq_tail;        /* Next completion entry the device writes */
+    u16 cq_phase;       /* Phase tag the device writes this pass */
+    unsigned long poll_state;   /* PCIE_SIM_RING_POLLING: a poller owns the device side */
 
     /* Statistics */
-    atomic64_t submissions;
+    atomic64_t submissions ____cacheline_aligned_in_smp;
     atomic64_t completions;
     atomic64_t overruns;
+    atomic64_t doorbells;
+    atomic64_t fetches;         /* Descriptor read bursts */
+    atomic64_t fetch_stalls;    /* Completions that waited on a fetch */
+    atomic64_t writebacks;      /* Completion write bursts */
+    atomic64_t fetch_cost_ns;
+    atomic64_t writeback_cost_ns;
 };
 
 /* Main device structure */
@@ -118,8 +272,13 @@ struct pcie_sim_device {
     dev_t devt;
     struct mutex mutex;
 
-    /* Statistics */
-    struct pcie_sim_stats stats;
+    /* Transfer statistics, under stats_lock. The current epoch lives in the
+     * page userspace maps; stats_prev holds the previous epoch's. */
+    struct pcie_sim_stats_page *stats_page;
+    struct pcie_sim_transfer_stats stats_prev;
+    struct pcie_sim_latency_sq stats_prev_sq;
+    struct pcie_sim_phase_stats stats_phases[PCIE_SIM_PHASES];  /* Current epoch */
+    spinlock_t stats_lock;
 
     /* Proc entries */
     struct proc_dir_entry *proc_dir;
@@ -129,9 +288,27 @@ struct pcie_sim_device {
     void *bar0_virt;
     size_t bar0_size;
 
-    /* Ring buffers for DMA */
-    struct pcie_sim_ring tx_ring;
-    struct pcie_sim_ring rx_ring;
+    /* MMIO access accounting (per 32-bit register, offsets 0x000-0x07C) */
+    atomic64_t mmio_reads[PCIE_SIM_MMIO_TRACKED_REGS];
+    atomic64_t mmio_writes[PCIE_SIM_MMIO_TRACKED_REGS];
+    atomic64_t mmio_read_cost_ns;
+    atomic64_t mmio_write_cost_ns;
+
+    /* Ring buffers for DMA, num_rings per direction; CPUs map to queue
+     * pairs by cpu % num_rings */
+    struct pcie_sim_ring tx_rings[PCIE_SIM_MAX_QUEUES];
+    struct pcie_sim_ring rx_rings[PCIE_SIM_MAX_QUEUES];
+    u32 num_rings;
+    u32 ring_size;
+    atomic64_t ring_memory;     /* Bytes of allocated descriptor memory */
+    atomic64_t bounce_memory;   /* Bytes of transfer bounce buffers in use */
+    atomic64_t bounce_peak;
+    struct pcie_sim_cpu_stats __percpu *cpu_stats;
+    struct percpu_rw_semaphore ring_sem;    /* Read: transfers; write: reconfigure */
+
+    /* Device engine; with no engines the submitter runs the device inline */
+    struct pcie_sim_engine engines[PCIE_SIM_MAX_QUEUES];
+    u32 num_engines;
 
     /* Interrupt simulation */
     atomic_t pending_interrupts;
@@ -144,6 +321,19 @@ struct pcie_sim_device {
     u32 error_probability;      /* Error probability in 0.01% units */
     u32 error_recovery_time_ms; /* Recovery time after error */
 
+    /* Transfer jitter; seeded at probe, saved in snapshots */
+    struct rnd_state rng;
+    spinlock_t rng_lock;
+
+    /*
+     * BAR0, descriptor memory and engine threads exist only while the
+     * device is open, or until idle_work runs after the last close
+     */
+    struct mutex power_lock;
+    unsigned int open_count;
+    bool active;
+    struct delayed_work idle_work;
+
     bool enabled;
     int device_id;
 };
@@ -153,10 +343,14 @@ extern struct {
     struct class *class;
     dev_t devt_base;
     int major;
-    struct pcie_sim_device *devices[DEVICE_COUNT];
+    struct pcie_sim_device *devices[MAX_DEVICES];
 } driver_state;
 
 /* Function prototypes */
+int pcie_sim_device_get(struct pcie_sim_device *dev);
+void pcie_sim_device_put(struct pcie_sim_device *dev);
+void pcie_sim_memory_usage(struct pcie_sim_device *dev, struct pcie_sim_memory_stats *mem);
+
 int pcie_sim_char_init(struct pcie_sim_device *dev);
 void pcie_sim_char_cleanup(struct pcie_sim_device *dev);
 long pcie_sim_char_ioctl(struct file *filp, unsigned int cmd, unsigned long arg);
@@ -164,7 +358,36 @@ long pcie_sim_char_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 int pcie_sim_proc_init(struct pcie_sim_device *dev);
 void pcie_sim_proc_cleanup(struct pcie_sim_device *dev);
 
-int pcie_sim_dma_transfer(struct pcie_sim_device *dev, struct pcie_sim_transfer_req *req);
+int pcie_sim_stats_init(struct pcie_sim_device *dev);
+void pcie_sim_stats_cleanup(struct pcie_sim_device *dev);
+void pcie_sim_stats_transfer(struct pcie_sim_device *dev, u32 direction, u64 bytes,
+                             u64 latency_ns, const u64 *phase_ns);
+void pcie_sim_stats_fail(struct pcie_sim_device *dev, u32 direction, unsigned int type);
+void pcie_sim_stats_read(struct pcie_sim_device *dev, struct pcie_sim_stats *out);
+void pcie_sim_stats_read_phases(struct pcie_sim_device *dev, struct pcie_sim_phase_stats *out);
+void pcie_sim_stats_save(struct pcie_sim_device *dev, struct pcie_sim_transfer_stats *out,
+                         struct pcie_sim_latency_sq *sq);
+void pcie_sim_stats_restore(struct pcie_sim_device *dev, const struct pcie_sim_transfer_stats *in,
+                            const struct pcie_sim_latency_sq *sq);
+u64 pcie_sim_stats_reset(struct pcie_sim_device *dev);
+int pcie_sim_stats_get_ex(struct pcie_sim_device *dev, struct pcie_sim_stats_header __user *arg);
+int pcie_sim_stats_mmap(struct pcie_sim_device *dev, struct vm_area_struct *vma);
+
+int pcie_sim_dma_transfer(struct pcie_sim_device *dev, struct pcie_sim_transfer_req *req,
+                          u64 *phase_ns);
+u32 pcie_sim_dma_execute(struct pcie_sim_device *dev, const struct pcie_sim_sq_desc *desc);
+
+int pcie_sim_snapshot_save(struct pcie_sim_device *dev, struct pcie_sim_snapshot_buf __user *arg);
+int pcie_sim_snapshot_load(struct pcie_sim_device *dev, struct pcie_sim_snapshot_buf __user *arg);
+
+int pcie_sim_engine_init(struct pcie_sim_device *dev);
+void pcie_sim_engine_cleanup(struct pcie_sim_device *dev);
+void pcie_sim_engine_kick(struct pcie_sim_device *dev, u32 queue);
+void pcie_sim_engine_park(struct pcie_sim_device *dev);
+void pcie_sim_engine_unpark(struct pcie_sim_device *dev);
+u32 pcie_sim_engine_poll(struct pcie_sim_device *dev, struct pcie_sim_ring *ring, u32 budget);
+void pcie_sim_engine_wait(struct pcie_sim_device *dev, struct pcie_sim_ring *ring,
+                          struct pcie_sim_request *request);
 
 int pcie_sim_mmio_init(struct pcie_sim_device *dev);
 void pcie_sim_mmio_cleanup(struct pcie_sim_device *dev);
@@ -172,9 +395,32 @@ u32 pcie_sim_mmio_read32(struct pcie_sim_device *dev, u32 offset);
 void pcie_sim_mmio_write32(struct pcie_sim_device *dev, u32 offset, u32 value);
 void pcie_sim_mmio_update_dma(struct pcie_sim_device *dev,
                              struct pcie_sim_transfer_req *req, bool success);
+void pcie_sim_mmio_save(struct pcie_sim_device *dev, struct pcie_sim_snapshot_writer *w);
+void pcie_sim_mmio_load(struct pcie_sim_device *dev, const void *snapshot);
 
 int pcie_sim_ring_init(struct pcie_sim_device *dev);
 void pcie_sim_ring_cleanup(struct pcie_sim_device *dev);
+void pcie_sim_ring_release(struct pcie_sim_device *dev);
+int pcie_sim_ring_configure(struct pcie_sim_device *dev, u32 ring_size, u32 num_rings);
+bool pcie_sim_ring_idle(struct pcie_sim_device *dev);
+void pcie_sim_ring_save(struct pcie_sim_device *dev, struct pcie_sim_snapshot_writer *w);
+int pcie_sim_ring_check(struct pcie_sim_device *dev, const void *snapshot);
+int pcie_sim_ring_load(struct pcie_sim_device *dev, const void *snapshot);
+u32 pcie_sim_ring_count(struct pcie_sim_ring *ring);
+u32 pcie_sim_ring_space(struct pcie_sim_ring *ring);
+int pcie_sim_ring_submit(struct pcie_sim_ring *ring, u64 buffer_addr,
+                        u32 length, u32 flags, void *ctx);
+int pcie_sim_ring_post(struct pcie_sim_device *dev, struct pcie_sim_ring *ring,
+                      u64 buffer_addr, u32 length, u32 flags, void *ctx);
+void pcie_sim_ring_kick(struct pcie_sim_device *dev, struct pcie_sim_ring *ring);
+void pcie_sim_ring_doorbell(struct pcie_sim_ring *ring, u32 tail);
+int pcie_sim_ring_complete(struct pcie_sim_ring *ring, u32 *length,
+                          u64 *latency_ns, u32 status);
+int pcie_sim_ring_peek(struct pcie_sim_ring *ring, struct pcie_sim_sq_desc *desc);
+int pcie_sim_ring_reap(struct pcie_sim_ring *ring, struct pcie_sim_completion *c);
+struct pcie_sim_ring *pcie_sim_ring_for_cpu(struct pcie_sim_device *dev, u32 direction);
+u32 pcie_sim_ring_interrupt(struct pcie_sim_device *dev, struct pcie_sim_ring *ring);
+void pcie_sim_ring_writeback(struct pcie_sim_ring *ring);
 
 int pcie_sim_interrupt_init(struct pcie_sim_device *dev);
 void pcie_sim_interrupt_cleanup(struct pcie_sim_device *dev);
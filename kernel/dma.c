@@ -59,30 +59,41 @@ static int validate_transfer_request(struct pcie_sim_transfer_req *req)
 }
 
 /*
- * Update device statistics after a transfer
+ * Classify a failed transfer for the error statistics
  */
-static void update_transfer_stats(struct pcie_sim_device *dev,
-                                struct pcie_sim_transfer_req *req,
-                                u64 latency_ns, bool success)
+static unsigned int transfer_error_type(int err)
 {
-    if (success) {
-        /* Update counters */
-        atomic64_inc(&dev->stats.total_transfers);
-        atomic64_add(req->size, &dev->stats.total_bytes);
-
-        /* Update latency statistics */
-        if (dev->stats.min_latency_ns == 0 || latency_ns < dev->stats.min_latency_ns)
-            dev->stats.min_latency_ns = latency_ns;
+    switch (err) {
+    case -EINVAL:
+        return PCIE_SIM_STATS_ERR_INVALID;
+    case -ENOMEM:
+        return PCIE_SIM_STATS_ERR_NOMEM;
+    case -EFAULT:
+        return PCIE_SIM_STATS_ERR_FAULT;
+    case -EBUSY:
+        return PCIE_SIM_STATS_ERR_BUSY;
+    case -ETIMEDOUT:
+        return PCIE_SIM_STATS_ERR_TIMEOUT;
+    default:
+        return PCIE_SIM_STATS_ERR_DEVICE;
+    }
+}
 
-        if (latency_ns > dev->stats.max_latency_ns)
-            dev->stats.max_latency_ns = latency_ns;
+/*
+ * Charge a bounce buffer allocation (or, negative, its release) to the
+ * device and track the peak
+ */
+static void account_bounce(struct pcie_sim_device *dev, s64 bytes)
+{
+    s64 now = atomic64_add_return(bytes, &dev->bounce_memory);
+    s64 peak = atomic64_read(&dev->bounce_peak);
 
-        /* Calculate running average latency */
-        dev->stats.avg_latency_ns = (dev->stats.avg_latency_ns + latency_ns) / 2;
+    while (now > peak) {
+        s64 old = atomic64_cmpxchg(&dev->bounce_peak, peak, now);
 
-    } else {
-        /* Update error counter */
-        atomic64_inc(&dev->stats.total_errors);
+        if (old == peak)
+            break;
+        peak = old;
     }
 }
 
@@ -90,13 +101,17 @@ static void update_transfer_stats(struct pcie_sim_device *dev,
  * Simulate realistic PCIe transfer latency
  * Real PCIe transfers have base latency + size-dependent component
  */
-static void simulate_transfer_delay(size_t size)
+static void simulate_transfer_delay(struct pcie_sim_device *dev, size_t size)
 {
     unsigned int base_delay_us = 10;  /* Base latency: 10µs */
     unsigned int size_delay_us = size / 1024;  /* ~1µs per KB */
+    unsigned int jitter_us;
 
-    /* Add some randomness to simulate real-world variation */
-    unsigned int jitter_us = get_random_u32_below(20);
+    /* Add some randomness to simulate real-world variation; the device's
+     * own generator makes runs reproducible from a snapshot */
+    spin_lock(&dev->rng_lock);
+    jitter_us = prandom_u32_state(&dev->rng) % 20;
+    spin_unlock(&dev->rng_lock);
 
     unsigned int total_delay = base_delay_us + size_delay_us + jitter_us;
 
@@ -108,12 +123,35 @@ static void simulate_transfer_delay(size_t size)
 }
 
 /*
- * Perform DMA transfer simulation
+ * Device side of a transfer: move the data behind a descriptor and hold it
+ * for the modeled wire time. Runs on the engine, or inline in the
+ * submitter when there is none. Returns the completion status.
+ */
+u32 pcie_sim_dma_execute(struct pcie_sim_device *dev, const struct pcie_sim_sq_desc *desc)
+{
+    void *buf = (void *)(uintptr_t)desc->buffer_addr;
+
+    if (desc->flags) {
+        /* FROM_DEVICE: hardware fills the buffer with a data pattern */
+        memset(buf, 0xAA, desc->length);
+    }
+
+    simulate_transfer_delay(dev, desc->length);
+    return 0;
+}
+
+/*
+ * Perform DMA transfer simulation. The time spent in each
+ * PCIE_SIM_PHASE_* is returned in phase_ns when it is not NULL.
  */
 int pcie_sim_dma_transfer(struct pcie_sim_device *dev,
-                         struct pcie_sim_transfer_req *req)
+                         struct pcie_sim_transfer_req *req, u64 *phase_ns)
 {
+    struct pcie_sim_request request;
+    struct pcie_sim_ring *ring;
     ktime_t start_time, end_time;
+    u64 phases[PCIE_SIM_PHASES];
+    u64 alloc_ns, posted_ns, woken_ns;
     u64 latency_ns;
     void *kernel_buf = NULL;
     int ret;
@@ -123,18 +161,20 @@ int pcie_sim_dma_transfer(struct pcie_sim_device *dev,
     if (ret)
         goto error_exit;
 
-    /* Allocate temporary kernel buffer */
+    /* Allocate temporary kernel buffer; the device transfers to and from it */
+    alloc_ns = ktime_get_ns();
     kernel_buf = kzalloc(req->size, GFP_KERNEL);
     if (!kernel_buf) {
         pr_err("Failed to allocate kernel buffer of size %zu\n", req->size);
         ret = -ENOMEM;
         goto error_exit;
     }
+    account_bounce(dev, req->size);
 
     /* Start timing the transfer */
     start_time = ktime_get();
+    phases[PCIE_SIM_PHASE_ALLOC] = pcie_sim_phase_ns(alloc_ns, ktime_to_ns(start_time));
 
-    /* Simulate the actual DMA operation */
     if (req->direction == 0) {
         /* TO_DEVICE: Copy data from userspace to kernel buffer */
         pr_debug("DMA TO_DEVICE: %zu bytes\n", req->size);
@@ -144,45 +184,70 @@ int pcie_sim_dma_transfer(struct pcie_sim_device *dev,
             ret = -EFAULT;
             goto error_cleanup;
         }
-
-        /* Simulate hardware processing the data */
-        simulate_transfer_delay(req->size);
-
     } else {
-        /* FROM_DEVICE: Fill kernel buffer and copy to userspace */
         pr_debug("DMA FROM_DEVICE: %zu bytes\n", req->size);
+    }
 
-        /* Simulate hardware filling buffer with data pattern */
-        memset(kernel_buf, 0xAA, req->size);
-        simulate_transfer_delay(req->size);
+    /*
+     * Queue the request on this CPU's ring and ring the doorbell now; a
+     * blocking transfer cannot wait for the rest of a doorbell batch
+     */
+    posted_ns = ktime_get_ns();
+    phases[PCIE_SIM_PHASE_COPY_IN] = pcie_sim_phase_ns(ktime_to_ns(start_time), posted_ns);
+
+    init_completion(&request.done);
+    ring = pcie_sim_ring_for_cpu(dev, req->direction);
+    ret = pcie_sim_ring_post(dev, ring, (u64)(uintptr_t)kernel_buf,
+                             req->size, req->direction, &request);
+    if (ret) {
+        ret = ret == -ENOSPC ? -EBUSY : ret;
+        goto error_cleanup;
+    }
+    pcie_sim_ring_kick(dev, ring);
+
+    /* Sleep until the completion interrupt, or run the device inline */
+    pcie_sim_engine_wait(dev, ring, &request);
+    woken_ns = ktime_get_ns();
+    if (request.status) {
+        ret = -(int)request.status;
+        goto error_cleanup;
+    }
 
-        if (copy_to_user(req->buffer, kernel_buf, req->size)) {
-            pr_err("Failed to copy data to userspace\n");
-            ret = -EFAULT;
-            goto error_cleanup;
-        }
+    if (req->direction == 1 && copy_to_user(req->buffer, kernel_buf, req->size)) {
+        pr_err("Failed to copy data to userspace\n");
+        ret = -EFAULT;
+        goto error_cleanup;
     }
 
     /* End timing and calculate latency */
     end_time = ktime_get();
     latency_ns = ktime_to_ns(ktime_sub(end_time, start_time));
 
+    phases[PCIE_SIM_PHASE_QUEUE] = pcie_sim_phase_ns(posted_ns, request.start_ns);
+    phases[PCIE_SIM_PHASE_WIRE] = pcie_sim_phase_ns(request.start_ns, request.done_ns);
+    phases[PCIE_SIM_PHASE_COMPLETION] = pcie_sim_phase_ns(request.done_ns, woken_ns);
+    phases[PCIE_SIM_PHASE_COPY_OUT] = pcie_sim_phase_ns(woken_ns, ktime_to_ns(end_time));
+    if (phase_ns)
+        memcpy(phase_ns, phases, sizeof(phases));
+
     /* Update statistics */
-    update_transfer_stats(dev, req, latency_ns, true);
+    pcie_sim_stats_transfer(dev, req->direction, req->size, latency_ns, phases);
 
     /* Return latency to userspace */
     req->latency_ns = latency_ns;
 
-    pr_debug("Transfer completed: %zu bytes in %llu ns (%.2f µs)\n",
-            req->size, latency_ns, latency_ns / 1000.0);
+    pr_debug("Transfer completed: %zu bytes in %llu ns\n",
+            req->size, latency_ns);
 
     kfree(kernel_buf);
+    account_bounce(dev, -(s64)req->size);
     return 0;
 
 error_cleanup:
     kfree(kernel_buf);
+    account_bounce(dev, -(s64)req->size);
 error_exit:
     /* Update error statistics */
-    update_transfer_stats(dev, req, 0, false);
+    pcie_sim_stats_fail(dev, req->direction, transfer_error_type(ret));
     return ret;
-}
\ No newline at end of file
+}
@@ -31,11 +31,140 @@ struct {
     struct class *class;
     dev_t devt_base;
     int major;
-    struct pcie_sim_device *devices[DEVICE_COUNT];
+    struct pcie_sim_device *devices[MAX_DEVICES];
 } driver_state;
 
 /* Platform devices array */
-static struct platform_device *pcie_sim_devices[DEVICE_COUNT];
+static struct platform_device *pcie_sim_devices[MAX_DEVICES];
+
+static unsigned int num_devices = 1;
+module_param(num_devices, uint, 0444);
+MODULE_PARM_DESC(num_devices, "Simulated devices to create, 1-64 (default 1)");
+
+/*
+ * Probe only registers a device. BAR0, descriptor memory and engine
+ * threads are allocated on first open and released after the last close,
+ * so loading many devices is fast and idle devices cost little memory.
+ */
+static int idle_timeout_ms;
+module_param(idle_timeout_ms, int, 0644);
+MODULE_PARM_DESC(idle_timeout_ms, "Keep a closed device's resources this long in ms; 0 = release on last close, -1 = never (default 0)");
+
+/*
+ * Allocate BAR0 and start the engine threads
+ */
+static int pcie_sim_power_up(struct pcie_sim_device *dev)
+{
+    int ret;
+
+    ret = pcie_sim_mmio_init(dev);
+    if (ret) {
+        pr_err("Failed to initialize MMIO: %d\n", ret);
+        return ret;
+    }
+
+    ret = pcie_sim_engine_init(dev);
+    if (ret) {
+        pr_err("Failed to start device engine: %d\n", ret);
+        pcie_sim_mmio_cleanup(dev);
+        return ret;
+    }
+
+    dev->active = true;
+    pr_debug("Device %d resources allocated\n", dev->device_id);
+    return 0;
+}
+
+/*
+ * Stop the engines and free BAR0 and the descriptor memory. Nothing can be
+ * in flight: transfers only run inside an ioctl on an open file.
+ */
+static void pcie_sim_power_down(struct pcie_sim_device *dev)
+{
+    pcie_sim_engine_cleanup(dev);
+    pcie_sim_ring_release(dev);
+    pcie_sim_mmio_cleanup(dev);
+    dev->active = false;
+    pr_debug("Device %d resources released\n", dev->device_id);
+}
+
+/*
+ * Release a closed device's resources once idle_timeout_ms has passed
+ */
+static void pcie_sim_idle_work(struct work_struct *work)
+{
+    struct pcie_sim_device *dev = container_of(to_delayed_work(work),
+                                               struct pcie_sim_device, idle_work);
+
+    mutex_lock(&dev->power_lock);
+    if (!dev->open_count && dev->active)
+        pcie_sim_power_down(dev);
+    mutex_unlock(&dev->power_lock);
+}
+
+/*
+ * Take an open reference, allocating the device's resources on first use
+ */
+int pcie_sim_device_get(struct pcie_sim_device *dev)
+{
+    int ret = 0;
+
+    mutex_lock(&dev->power_lock);
+
+    /* A pending release rechecks open_count, so it need not be waited for */
+    cancel_delayed_work(&dev->idle_work);
+
+    if (!dev->active)
+        ret = pcie_sim_power_up(dev);
+    if (!ret)
+        dev->open_count++;
+
+    mutex_unlock(&dev->power_lock);
+    return ret;
+}
+
+/*
+ * Drop an open reference; the last one releases the resources now or
+ * after idle_timeout_ms
+ */
+void pcie_sim_device_put(struct pcie_sim_device *dev)
+{
+    int timeout_ms = READ_ONCE(idle_timeout_ms);
+
+    mutex_lock(&dev->power_lock);
+
+    if (!--dev->open_count) {
+        if (timeout_ms == 0)
+            pcie_sim_power_down(dev);
+        else if (timeout_ms > 0)
+            schedule_delayed_work(&dev->idle_work, msecs_to_jiffies(timeout_ms));
+    }
+
+    mutex_unlock(&dev->power_lock);
+}
+
+/*
+ * Sum the memory a device holds in each subsystem. Engine threads are
+ * charged their kernel stack; the percpu rwsem its per-CPU read count.
+ */
+void pcie_sim_memory_usage(struct pcie_sim_device *dev, struct pcie_sim_memory_stats *mem)
+{
+    size_t counters = sizeof(dev->stats_prev) + sizeof(dev->stats_prev_sq) +
+                      sizeof(dev->stats_phases) +
+                      sizeof(dev->mmio_reads) + sizeof(dev->mmio_writes);
+
+    memset(mem, 0, sizeof(*mem));
+    mem->device_bytes = sizeof(*dev) - counters;
+    mem->bar_bytes = READ_ONCE(dev->bar0_size);
+    mem->ring_bytes = atomic64_read(&dev->ring_memory);
+    mem->bounce_bytes = atomic64_read(&dev->bounce_memory);
+    mem->bounce_peak_bytes = atomic64_read(&dev->bounce_peak);
+    mem->stats_bytes = counters + PAGE_SIZE + num_possible_cpus() *
+                       (sizeof(struct pcie_sim_cpu_stats) + sizeof(unsigned int));
+    mem->engine_bytes = (u64)READ_ONCE(dev->num_engines) * THREAD_SIZE;
+    mem->total_bytes = mem->device_bytes + mem->bar_bytes + mem->ring_bytes +
+                       mem->bounce_bytes + mem->stats_bytes + mem->engine_bytes;
+}
 
 /*
  * Platform device probe - called when device is found
@@ -46,10 +175,10 @@ static int pcie_sim_probe(struct platform_device *pdev)
     int device_id = pdev->id;
     int ret;
 
-    if (device_id >= DEVICE_COUNT)
+    if (device_id >= MAX_DEVICES)
         return -EINVAL;
 
-    pr_info("Probing device %d\n", device_id);
+    pr_debug("Probing device %d\n", device_id);
 
     /* Allocate device structure */
     dev = kzalloc(sizeof(*dev), GFP_KERNEL);
@@ -61,11 +190,37 @@ static int pcie_sim_probe(struct platform_device *pdev)
     dev->device_id = device_id;
     dev->enabled = true;
     mutex_init(&dev->mutex);
-    memset(&dev->stats, 0, sizeof(dev->stats));
+    mutex_init(&dev->power_lock);
+    INIT_DELAYED_WORK(&dev->idle_work, pcie_sim_idle_work);
+    spin_lock_init(&dev->rng_lock);
+    prandom_seed_state(&dev->rng, get_random_u64());
+
+    ret = pcie_sim_stats_init(dev);
+    if (ret) {
+        kfree(dev);
+        return ret;
+    }
 
     platform_set_drvdata(pdev, dev);
     driver_state.devices[device_id] = dev;
 
+    dev->cpu_stats = alloc_percpu(struct pcie_sim_cpu_stats);
+    if (!dev->cpu_stats) {
+        ret = -ENOMEM;
+        goto err_percpu;
+    }
+
+    ret = percpu_init_rwsem(&dev->ring_sem);
+    if (ret)
+        goto err_rwsem;
+
+    /* Ring geometry only; descriptor memory is allocated on first post */
+    ret = pcie_sim_ring_init(dev);
+    if (ret) {
+        pr_err("Failed to initialize rings: %d\n", ret);
+        goto err_ring;
+    }
+
     /* Initialize character device interface */
     ret = pcie_sim_char_init(dev);
     if (ret) {
@@ -80,13 +235,20 @@ static int pcie_sim_probe(struct platform_device *pdev)
         goto err_proc;
     }
 
-    pr_info("Device %d initialized successfully\n", device_id);
+    pr_debug("Device %d initialized successfully\n", device_id);
     return 0;
 
 err_proc:
     pcie_sim_char_cleanup(dev);
 err_char:
+    pcie_sim_ring_cleanup(dev);
+err_ring:
+    percpu_free_rwsem(&dev->ring_sem);
+err_rwsem:
+    free_percpu(dev->cpu_stats);
+err_percpu:
     driver_state.devices[device_id] = NULL;
+    pcie_sim_stats_cleanup(dev);
     kfree(dev);
     return ret;
 }
@@ -99,12 +261,19 @@ static int pcie_sim_remove(struct platform_device *pdev)
     struct pcie_sim_device *dev = platform_get_drvdata(pdev);
     int device_id = pdev->id;
 
-    pr_info("Removing device %d\n", device_id);
+    pr_debug("Removing device %d\n", device_id);
 
     if (dev) {
         pcie_sim_proc_cleanup(dev);
         pcie_sim_char_cleanup(dev);
+        cancel_delayed_work_sync(&dev->idle_work);
+        if (dev->active)
+            pcie_sim_power_down(dev);
+        pcie_sim_ring_cleanup(dev);
+        percpu_free_rwsem(&dev->ring_sem);
+        free_percpu(dev->cpu_stats);
         driver_state.devices[device_id] = NULL;
+        pcie_sim_stats_cleanup(dev);
         kfree(dev);
     }
 
@@ -127,7 +296,7 @@ static int create_platform_devices(void)
 {
     int i, ret;
 
-    for (i = 0; i < DEVICE_COUNT; i++) {
+    for (i = 0; i < (int)num_devices; i++) {
         pcie_sim_devices[i] = platform_device_alloc(DRIVER_NAME, i);
         if (!pcie_sim_devices[i]) {
             ret = -ENOMEM;
@@ -161,7 +330,7 @@ static void destroy_platform_devices(void)
 {
     int i;
 
-    for (i = 0; i < DEVICE_COUNT; i++) {
+    for (i = 0; i < MAX_DEVICES; i++) {
         if (pcie_sim_devices[i]) {
             platform_device_unregister(pcie_sim_devices[i]);
             pcie_sim_devices[i] = NULL;
@@ -178,8 +347,13 @@ static int __init pcie_sim_init(void)
 
     pr_info("PCIe Simulator Driver v%s loading\n", DRIVER_VERSION);
 
+    if (num_devices < 1 || num_devices > MAX_DEVICES) {
+        pr_err("num_devices must be 1-%d\n", MAX_DEVICES);
+        return -EINVAL;
+    }
+
     /* Allocate character device numbers */
-    ret = alloc_chrdev_region(&driver_state.devt_base, 0, DEVICE_COUNT, DRIVER_NAME);
+    ret = alloc_chrdev_region(&driver_state.devt_base, 0, MAX_DEVICES, DRIVER_NAME);
     if (ret) {
         pr_err("Failed to allocate character device region: %d\n", ret);
         return ret;
@@ -208,7 +382,7 @@ static int __init pcie_sim_init(void)
         goto err_devices;
     }
 
-    pr_info("PCIe Simulator Driver loaded successfully\n");
+    pr_info("PCIe Simulator Driver loaded: %u device(s)\n", num_devices);
     return 0;
 
 err_devices:
@@ -216,7 +390,7 @@ err_devices:
 err_driver:
     class_destroy(driver_state.class);
 err_class:
-    unregister_chrdev_region(driver_state.devt_base, DEVICE_COUNT);
+    unregister_chrdev_region(driver_state.devt_base, MAX_DEVICES);
     return ret;
 }
 
@@ -230,7 +404,7 @@ static void __exit pcie_sim_exit(void)
     destroy_platform_devices();
     platform_driver_unregister(&pcie_sim_platform_driver);
     class_destroy(driver_state.class);
-    unregister_chrdev_region(driver_state.devt_base, DEVICE_COUNT);
+    unregister_chrdev_region(driver_state.devt_base, MAX_DEVICES);
 
     pr_info("PCIe Simulator Driver unloaded\n");
 }
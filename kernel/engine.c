@@ -0,0 +1,282 @@
+/*
+ * PCIe Simulator - Device Engine Threads
+ *
+ * Copyright (c) 2025 Karan Mamaniya <kmamaniya@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * This module runs the device side of the simulator on its own kernel
+ * threads, polling the submission rings like a DMA engine.
+ */
+
+#include "common.h"
+#include <linux/cpumask.h>
+#include <linux/sched.h>
+
+/*
+ * Engine threads give the simulated device its own execution context, the
+ * way real hardware offloads DMA from the host CPU: the submitter rings a
+ * doorbell and sleeps until the completion interrupt instead of running
+ * the device model itself.
+ */
+static unsigned int engine_threads = 1;
+module_param(engine_threads, uint, 0444);
+MODULE_PARM_DESC(engine_threads, "Device engine threads per device, 0-16; 0 = run the device inline in the submitter (default 1)");
+
+static char *engine_cpus;
+module_param(engine_cpus, charp, 0444);
+MODULE_PARM_DESC(engine_cpus, "CPU list to pin engine threads to, one CPU per thread in order (default: unpinned)");
+
+static unsigned int engine_budget = 64;
+module_param(engine_budget, uint, 0644);
+MODULE_PARM_DESC(engine_budget, "Descriptors executed per ring per polling pass (default 64)");
+
+/*
+ * Execute up to budget published descriptors from a ring, raising the
+ * completion interrupt after each. Returns the number executed, 0 if
+ * another poller owns the ring.
+ */
+u32 pcie_sim_engine_poll(struct pcie_sim_device *dev, struct pcie_sim_ring *ring, u32 budget)
+{
+    struct pcie_sim_sq_desc desc;
+    u32 done = 0;
+
+    if (test_and_set_bit_lock(PCIE_SIM_RING_POLLING, &ring->poll_state))
+        return 0;
+
+    while (done < budget && pcie_sim_ring_peek(ring, &desc) == 0) {
+        pcie_sim_ring_complete(ring, NULL, NULL, pcie_sim_dma_execute(dev, &desc));
+        pcie_sim_ring_interrupt(dev, ring);
+        done++;
+    }
+
+    clear_bit_unlock(PCIE_SIM_RING_POLLING, &ring->poll_state);
+    return done;
+}
+
+/*
+ * One polling pass over the engine's queue pairs. Returns true if any
+ * ring used its whole budget and may have more work.
+ */
+static bool engine_pass(struct pcie_sim_engine *eng)
+{
+    struct pcie_sim_device *dev = eng->dev;
+    u32 budget = max(engine_budget, 1U);
+    bool more = false;
+    u32 q;
+
+    for (q = eng->index; q < dev->num_rings; q += dev->num_engines) {
+        u32 tx = pcie_sim_engine_poll(dev, &dev->tx_rings[q], budget);
+        u32 rx = pcie_sim_engine_poll(dev, &dev->rx_rings[q], budget);
+
+        atomic64_add(tx + rx, &eng->descriptors);
+        if (tx >= budget || rx >= budget)
+            more = true;
+    }
+
+    atomic64_inc(&eng->passes);
+    return more;
+}
+
+/*
+ * Engine thread main loop
+ */
+static int engine_thread(void *data)
+{
+    struct pcie_sim_engine *eng = data;
+
+    while (!kthread_should_stop()) {
+        if (kthread_should_park()) {
+            kthread_parkme();
+            continue;
+        }
+
+        /* A doorbell after this point is seen by the pass or wakes the next */
+        atomic_set(&eng->kicked, 0);
+        smp_mb__after_atomic();
+
+        if (engine_pass(eng)) {
+            /* Budget spent: give up the CPU, then poll again without sleeping */
+            atomic64_inc(&eng->budget_exhausted);
+            cond_resched();
+            continue;
+        }
+
+        if (!atomic_read(&eng->kicked))
+            atomic64_inc(&eng->sleeps);
+        wait_event_interruptible(eng->wait, atomic_read(&eng->kicked) ||
+                                 kthread_should_stop() || kthread_should_park());
+    }
+
+    return 0;
+}
+
+/*
+ * Wake the engine serving a queue after its doorbell was written
+ */
+void pcie_sim_engine_kick(struct pcie_sim_device *dev, u32 queue)
+{
+    struct pcie_sim_engine *eng;
+
+    if (!dev->num_engines)
+        return;
+
+    eng = &dev->engines[queue % dev->num_engines];
+    atomic_set(&eng->kicked, 1);
+    wake_up(&eng->wait);
+}
+
+/*
+ * Wait for a posted request to complete. With engine threads the caller
+ * sleeps until the completion interrupt; without, it polls its ring
+ * itself until another poller or its own pass completes the request.
+ */
+void pcie_sim_engine_wait(struct pcie_sim_device *dev, struct pcie_sim_ring *ring,
+                          struct pcie_sim_request *request)
+{
+    if (!dev->num_engines) {
+        while (!completion_done(&request->done)) {
+            if (!pcie_sim_engine_poll(dev, ring, max(engine_budget, 1U)))
+                cond_resched();
+        }
+    }
+
+    wait_for_completion(&request->done);
+}
+
+/*
+ * Stop the engines from touching the rings, e.g. while they are rebuilt
+ */
+void pcie_sim_engine_park(struct pcie_sim_device *dev)
+{
+    u32 i;
+
+    for (i = 0; i < dev->num_engines; i++)
+        kthread_park(dev->engines[i].task);
+}
+
+/*
+ * Resume parked engines
+ */
+void pcie_sim_engine_unpark(struct pcie_sim_device *dev)
+{
+    u32 i;
+
+    for (i = 0; i < dev->num_engines; i++)
+        kthread_unpark(dev->engines[i].task);
+}
+
+/*
+ * Start the engine threads for a device, pinned round-robin to engine_cpus
+ */
+int pcie_sim_engine_init(struct pcie_sim_device *dev)
+{
+    u32 i, count = min_t(u32, engine_threads, PCIE_SIM_MAX_QUEUES);
+    cpumask_var_t cpus;
+    int cpu = -1;
+    int ret = 0;
+
+    dev->num_engines = 0;
+
+    if (!count) {
+        pr_debug("Device %d: no engine threads, transfers run the device inline\n",
+               dev->device_id);
+        return 0;
+    }
+
+    if (!zalloc_cpumask_var(&cpus, GFP_KERNEL))
+        return -ENOMEM;
+
+    if (engine_cpus && *engine_cpus) {
+        if (cpulist_parse(engine_cpus, cpus)) {
+            pr_warn("Invalid engine_cpus '%s', engines unpinned\n", engine_cpus);
+            cpumask_clear(cpus);
+        }
+        cpumask_and(cpus, cpus, cpu_online_mask);
+        if (cpumask_empty(cpus))
+            pr_warn("engine_cpus '%s' has no online CPU, engines unpinned\n", engine_cpus);
+    }
+
+    for (i = 0; i < count; i++) {
+        struct pcie_sim_engine *eng = &dev->engines[i];
+
+        eng->dev = dev;
+        eng->index = i;
+        eng->cpu = -1;
+        init_waitqueue_head(&eng->wait);
+        atomic_set(&eng->kicked, 0);
+        atomic64_set(&eng->passes, 0);
+        atomic64_set(&eng->descriptors, 0);
+        atomic64_set(&eng->budget_exhausted, 0);
+        atomic64_set(&eng->sleeps, 0);
+
+        if (!cpumask_empty(cpus)) {
+            cpu = cpumask_next(cpu, cpus);
+            if (cpu >= nr_cpu_ids)
+                cpu = cpumask_first(cpus);
+            eng->cpu = cpu;
+        }
+
+        eng->task = kthread_create(engine_thread, eng, "pcie_sim%d/e%u",
+                                   dev->device_id, i);
+        if (IS_ERR(eng->task)) {
+            ret = PTR_ERR(eng->task);
+            eng->task = NULL;
+            goto err_threads;
+        }
+
+        if (eng->cpu >= 0)
+            set_cpus_allowed_ptr(eng->task, cpumask_of(eng->cpu));
+    }
+
+    /* Every engine needs the final count to find its queues */
+    dev->num_engines = count;
+    for (i = 0; i < count; i++)
+        wake_up_process(dev->engines[i].task);
+
+    free_cpumask_var(cpus);
+    pr_debug("Device %d: %u engine thread(s), budget %u\n",
+           dev->device_id, count, engine_budget);
+    return 0;
+
+err_threads:
+    while (i--) {
+        kthread_stop(dev->engines[i].task);
+        dev->engines[i].task = NULL;
+    }
+    free_cpumask_var(cpus);
+    return ret;
+}
+
+/*
+ * Stop the engine threads for a device
+ */
+void pcie_sim_engine_cleanup(struct pcie_sim_device *dev)
+{
+    u32 i;
+
+    if (!dev)
+        return;
+
+    for (i = 0; i < dev->num_engines; i++) {
+        kthread_stop(dev->engines[i].task);
+        dev->engines[i].task = NULL;
+    }
+    dev->num_engines = 0;
+}
@@ -29,71 +29,66 @@
 #include "common.h"
 #include <linux/io.h>
 
-/* BAR0 - Control registers (4KB) */
-#define BAR0_SIZE 0x1000
-
-/* Control register offsets */
-#define REG_DEVICE_ID      0x000  /* Device identification */
-#define REG_STATUS         0x004  /* Device status */
-#define REG_CONTROL        0x008  /* Device control */
-#define REG_DMA_ADDR_LO    0x010  /* DMA address low 32 bits */
-#define REG_DMA_ADDR_HI    0x014  /* DMA address high 32 bits */
-#define REG_DMA_SIZE       0x018  /* DMA transfer size */
-#define REG_DMA_CONTROL    0x01C  /* DMA control */
-#define REG_INTERRUPT_STATUS 0x020 /* Interrupt status */
-#define REG_INTERRUPT_ENABLE 0x024 /* Interrupt enable */
-#define REG_PERF_LATENCY   0x030  /* Last transfer latency */
-#define REG_PERF_COUNT     0x034  /* Transfer counter */
-#define REG_ERROR_STATUS   0x040  /* Error status */
-#define REG_ERROR_INJECT   0x044  /* Error injection control */
-
-/* Status register bits */
-#define STATUS_DEVICE_READY   BIT(0)
-#define STATUS_DMA_BUSY       BIT(1)
-#define STATUS_ERROR          BIT(2)
-#define STATUS_INTERRUPT_PENDING BIT(3)
-
-/* Control register bits */
-#define CONTROL_DEVICE_ENABLE BIT(0)
-#define CONTROL_DMA_START     BIT(1)
-#define CONTROL_DMA_RESET     BIT(2)
-#define CONTROL_IRQ_ENABLE    BIT(3)
-
-/* DMA control register bits */
-#define DMA_CONTROL_DIRECTION BIT(0)  /* 0=TO_DEVICE, 1=FROM_DEVICE */
-#define DMA_CONTROL_ENABLE    BIT(1)
-#define DMA_CONTROL_INTERRUPT BIT(2)
-
-/* Interrupt status/enable bits */
-#define IRQ_DMA_COMPLETE      BIT(0)
-#define IRQ_DMA_ERROR         BIT(1)
-#define IRQ_BUFFER_OVERRUN    BIT(2)
-#define IRQ_DEVICE_ERROR      BIT(3)
+/*
+ * MMIO cost model: a register read is a non-posted round trip to the
+ * device, a write is posted. Costs are always accounted; with mmio_stall
+ * the CPU is also held for that long, as it would be on real hardware.
+ */
+static unsigned int mmio_read_ns = 1000;
+module_param(mmio_read_ns, uint, 0644);
+MODULE_PARM_DESC(mmio_read_ns, "Modeled MMIO read round-trip cost in ns (default 1000)");
+
+static unsigned int mmio_write_ns = 50;
+module_param(mmio_write_ns, uint, 0644);
+MODULE_PARM_DESC(mmio_write_ns, "Modeled posted MMIO write cost in ns (default 50)");
+
+static bool mmio_stall;
+module_param(mmio_stall, bool, 0644);
+MODULE_PARM_DESC(mmio_stall, "Busy-wait for the modeled MMIO cost (default off)");
 
 /*
- * Initialize BAR memory-mapped I/O simulation
+ * Count a register access and charge its modeled cost
+ */
+static void pcie_sim_mmio_account(struct pcie_sim_device *dev, u32 offset, bool is_write)
+{
+    unsigned int cost_ns = is_write ? mmio_write_ns : mmio_read_ns;
+    u32 reg = offset / 4;
+
+    if (reg < PCIE_SIM_MMIO_TRACKED_REGS)
+        atomic64_inc(is_write ? &dev->mmio_writes[reg] : &dev->mmio_reads[reg]);
+
+    atomic64_add(cost_ns, is_write ? &dev->mmio_write_cost_ns : &dev->mmio_read_cost_ns);
+
+    if (mmio_stall && cost_ns)
+        ndelay(cost_ns);
+}
+
+/*
+ * Initialize BAR memory-mapped I/O simulation. The access counters live in
+ * the device structure and keep counting across BAR0 reallocations.
  */
 int pcie_sim_mmio_init(struct pcie_sim_device *dev)
 {
     pr_debug("Initializing MMIO simulation for device %d\n", dev->device_id);
 
     /* Allocate BAR0 memory region */
-    dev->bar0_virt = kzalloc(BAR0_SIZE, GFP_KERNEL);
+    dev->bar0_virt = kzalloc(PCIE_SIM_BAR0_SIZE, GFP_KERNEL);
     if (!dev->bar0_virt) {
         pr_err("Failed to allocate BAR0 memory\n");
         return -ENOMEM;
     }
 
-    dev->bar0_size = BAR0_SIZE;
+    dev->bar0_size = PCIE_SIM_BAR0_SIZE;
 
     /* Initialize control registers with default values */
-    writel(0x1234ABCD, dev->bar0_virt + REG_DEVICE_ID);  /* Fake device ID */
-    writel(STATUS_DEVICE_READY, dev->bar0_virt + REG_STATUS);
-    writel(CONTROL_DEVICE_ENABLE, dev->bar0_virt + REG_CONTROL);
-    writel(0, dev->bar0_virt + REG_DMA_CONTROL);
-    writel(IRQ_DMA_COMPLETE | IRQ_DMA_ERROR, dev->bar0_virt + REG_INTERRUPT_ENABLE);
-
-    pr_info("MMIO simulation initialized: BAR0=%p size=%zu\n",
+    writel(PCIE_SIM_DEVICE_ID_VALUE, dev->bar0_virt + PCIE_SIM_REG_DEVICE_ID);
+    writel(PCIE_SIM_STATUS_DEVICE_READY, dev->bar0_virt + PCIE_SIM_REG_STATUS);
+    writel(PCIE_SIM_CONTROL_DEVICE_ENABLE, dev->bar0_virt + PCIE_SIM_REG_CONTROL);
+    writel(0, dev->bar0_virt + PCIE_SIM_REG_DMA_CONTROL);
+    writel(PCIE_SIM_IRQ_DMA_COMPLETE | PCIE_SIM_IRQ_DMA_ERROR,
+           dev->bar0_virt + PCIE_SIM_REG_INTERRUPT_ENABLE);
+
+    pr_debug("MMIO simulation initialized: BAR0=%p size=%zu\n",
            dev->bar0_virt, dev->bar0_size);
 
     return 0;
@@ -124,34 +119,39 @@ u32 pcie_sim_mmio_read32(struct pcie_sim_device *dev, u32 offset)
 {
     u32 value;
 
-    if (!dev->bar0_virt || offset >= dev->bar0_size) {
+    if (!dev->bar0_virt || offset >= dev->bar0_size || (offset & 3)) {
         pr_warn("Invalid MMIO read: offset=0x%x\n", offset);
         return 0xFFFFFFFF;
     }
 
+    pcie_sim_mmio_account(dev, offset, false);
     value = readl(dev->bar0_virt + offset);
 
     /* Handle special register reads */
     switch (offset) {
-    case REG_STATUS:
+    case PCIE_SIM_REG_STATUS:
         /* Update dynamic status bits */
-        value &= ~(STATUS_DMA_BUSY | STATUS_INTERRUPT_PENDING);
+        value &= ~(PCIE_SIM_STATUS_DMA_BUSY | PCIE_SIM_STATUS_INTERRUPT_PENDING);
         if (atomic_read(&dev->dma_active))
-            value |= STATUS_DMA_BUSY;
+            value |= PCIE_SIM_STATUS_DMA_BUSY;
         if (atomic_read(&dev->pending_interrupts))
-            value |= STATUS_INTERRUPT_PENDING;
+            value |= PCIE_SIM_STATUS_INTERRUPT_PENDING;
         break;
 
-    case REG_PERF_LATENCY:
-        /* Return last measured latency */
-        value = (u32)(dev->stats.avg_latency_ns / 1000);  /* Convert to μs */
-        break;
-
-    case REG_PERF_COUNT:
-        /* Return transfer count */
-        value = (u32)atomic64_read(&dev->stats.total_transfers);
+    case PCIE_SIM_REG_PERF_LATENCY:
+    case PCIE_SIM_REG_PERF_COUNT:
+    {
+        struct pcie_sim_stats stats;
+
+        /* Average latency in us, or the transfer count */
+        pcie_sim_stats_read(dev, &stats);
+        if (offset == PCIE_SIM_REG_PERF_LATENCY)
+            value = (u32)div_u64(stats.avg_latency_ns, 1000);
+        else
+            value = (u32)stats.total_transfers;
         break;
     }
+    }
 
     pr_debug("MMIO read: offset=0x%03x value=0x%08x\n", offset, value);
     return value;
@@ -162,29 +162,41 @@ u32 pcie_sim_mmio_read32(struct pcie_sim_device *dev, u32 offset)
  */
 void pcie_sim_mmio_write32(struct pcie_sim_device *dev, u32 offset, u32 value)
 {
-    if (!dev->bar0_virt || offset >= dev->bar0_size) {
+    if (!dev->bar0_virt || offset >= dev->bar0_size || (offset & 3)) {
         pr_warn("Invalid MMIO write: offset=0x%x value=0x%x\n", offset, value);
         return;
     }
 
+    pcie_sim_mmio_account(dev, offset, true);
     pr_debug("MMIO write: offset=0x%03x value=0x%08x\n", offset, value);
 
+    /* Tail doorbells: TX at +0, RX at +4 for each queue */
+    if (PCIE_SIM_REG_IS_DOORBELL(offset)) {
+        u32 q = (offset - PCIE_SIM_REG_DOORBELL_BASE) / 8;
+
+        if (q < dev->num_rings) {
+            pcie_sim_ring_doorbell((offset & 4) ? &dev->rx_rings[q] : &dev->tx_rings[q],
+                                   value);
+            pcie_sim_engine_kick(dev, q);
+        }
+    }
+
     /* Handle special register writes */
     switch (offset) {
-    case REG_CONTROL:
+    case PCIE_SIM_REG_CONTROL:
         /* Handle control register changes */
-        if (value & CONTROL_DMA_START) {
+        if (value & PCIE_SIM_CONTROL_DMA_START) {
+            /* No user address space to run it in; see sim/mmio_sim.h */
             pr_debug("DMA start triggered via MMIO\n");
-            /* Trigger DMA operation */
         }
-        if (value & CONTROL_DMA_RESET) {
+        if (value & PCIE_SIM_CONTROL_DMA_RESET) {
             pr_debug("DMA reset triggered via MMIO\n");
             atomic_set(&dev->dma_active, 0);
-            value &= ~CONTROL_DMA_RESET;  /* Self-clearing bit */
+            value &= ~PCIE_SIM_CONTROL_DMA_RESET;  /* Self-clearing bit */
         }
         break;
 
-    case REG_INTERRUPT_STATUS:
+    case PCIE_SIM_REG_INTERRUPT_STATUS:
         /* Writing to interrupt status clears the bits */
         {
             u32 current = readl(dev->bar0_virt + offset);
@@ -197,10 +209,10 @@ void pcie_sim_mmio_write32(struct pcie_sim_device *dev, u32 offset, u32 value)
             return;  /* Don't write the original value */
         }
 
-    case REG_ERROR_INJECT:
+    case PCIE_SIM_REG_ERROR_INJECT:
         /* Handle error injection */
-        if (value & 0xFF) {
-            dev->fault_injection_rate = value & 0xFF;
+        if (value & PCIE_SIM_ERROR_INJECT_RATE_MASK) {
+            dev->fault_injection_rate = value & PCIE_SIM_ERROR_INJECT_RATE_MASK;
             dev->simulate_errors = true;
             pr_debug("Error injection enabled: rate=1/%u\n", dev->fault_injection_rate);
         } else {
@@ -226,35 +238,116 @@ void pcie_sim_mmio_update_dma(struct pcie_sim_device *dev,
         return;
 
     /* Update status register */
-    status = readl(dev->bar0_virt + REG_STATUS);
-    status &= ~STATUS_DMA_BUSY;
+    status = readl(dev->bar0_virt + PCIE_SIM_REG_STATUS);
+    status &= ~PCIE_SIM_STATUS_DMA_BUSY;
 
     if (!success) {
-        status |= STATUS_ERROR;
+        status |= PCIE_SIM_STATUS_ERROR;
     }
 
-    writel(status, dev->bar0_virt + REG_STATUS);
+    writel(status, dev->bar0_virt + PCIE_SIM_REG_STATUS);
 
     /* Update interrupt status */
-    irq_status = readl(dev->bar0_virt + REG_INTERRUPT_STATUS);
+    irq_status = readl(dev->bar0_virt + PCIE_SIM_REG_INTERRUPT_STATUS);
 
     if (success) {
-        irq_status |= IRQ_DMA_COMPLETE;
+        irq_status |= PCIE_SIM_IRQ_DMA_COMPLETE;
     } else {
-        irq_status |= IRQ_DMA_ERROR;
+        irq_status |= PCIE_SIM_IRQ_DMA_ERROR;
     }
 
-    writel(irq_status, dev->bar0_virt + REG_INTERRUPT_STATUS);
+    writel(irq_status, dev->bar0_virt + PCIE_SIM_REG_INTERRUPT_STATUS);
 
     /* Update performance registers */
     if (success && req) {
-        writel((u32)(req->latency_ns / 1000), dev->bar0_virt + REG_PERF_LATENCY);
-        writel((u32)atomic64_read(&dev->stats.total_transfers),
-               dev->bar0_virt + REG_PERF_COUNT);
+        struct pcie_sim_stats stats;
+
+        pcie_sim_stats_read(dev, &stats);
+        writel((u32)(req->latency_ns / 1000), dev->bar0_virt + PCIE_SIM_REG_PERF_LATENCY);
+        writel((u32)stats.total_transfers, dev->bar0_virt + PCIE_SIM_REG_PERF_COUNT);
     }
 
     /* Set interrupt pending flag */
     atomic_set(&dev->pending_interrupts, 1);
 
     pr_debug("MMIO DMA update: success=%d, irq_status=0x%x\n", success, irq_status);
-}
\ No newline at end of file
+}
+
+/*
+ * Append the register file and MMIO counters to a snapshot
+ */
+void pcie_sim_mmio_save(struct pcie_sim_device *dev, struct pcie_sim_snapshot_writer *w)
+{
+    struct pcie_sim_snapshot_mmio *mmio;
+    u32 words = dev->bar0_size / 4;
+    u32 *regs;
+    u32 i;
+
+    /* Most of BAR0 is unused; only store up to the last nonzero register */
+    while (words && !readl(dev->bar0_virt + (words - 1) * 4))
+        words--;
+
+    regs = pcie_sim_snapshot_add(w, PCIE_SIM_SNAP_REGS, words * 4);
+    if (regs) {
+        for (i = 0; i < words; i++)
+            regs[i] = readl(dev->bar0_virt + i * 4);
+    }
+
+    mmio = pcie_sim_snapshot_add(w, PCIE_SIM_SNAP_MMIO, sizeof(*mmio));
+    if (!mmio)
+        return;
+
+    mmio->read_ns = mmio_read_ns;
+    mmio->write_ns = mmio_write_ns;
+    mmio->flags = mmio_stall ? PCIE_SIM_MMIO_STALL : 0;
+    mmio->read_cost_ns = atomic64_read(&dev->mmio_read_cost_ns);
+    mmio->write_cost_ns = atomic64_read(&dev->mmio_write_cost_ns);
+
+    for (i = 0; i < PCIE_SIM_MMIO_TRACKED_REGS; i++) {
+        mmio->reg_reads[i] = atomic64_read(&dev->mmio_reads[i]);
+        mmio->reg_writes[i] = atomic64_read(&dev->mmio_writes[i]);
+        mmio->reads += mmio->reg_reads[i];
+        mmio->writes += mmio->reg_writes[i];
+    }
+
+    for (i = 0; i < dev->num_rings; i++) {
+        mmio->doorbells += atomic64_read(&dev->tx_rings[i].doorbells);
+        mmio->doorbells += atomic64_read(&dev->rx_rings[i].doorbells);
+    }
+}
+
+/*
+ * Apply the register file and MMIO counters of a checked snapshot. The
+ * cost model comes from module parameters shared by every device, so the
+ * snapshot's costs are not applied.
+ */
+void pcie_sim_mmio_load(struct pcie_sim_device *dev, const void *snapshot)
+{
+    const struct pcie_sim_snapshot_section *s = NULL;
+    struct pcie_sim_snapshot_mmio mmio;
+    const u32 *regs;
+    u32 i, words;
+
+    while ((s = pcie_sim_snapshot_next(snapshot, s)) != NULL) {
+        switch (s->type) {
+        case PCIE_SIM_SNAP_REGS:
+            regs = (const u32 *)(s + 1);
+            words = min_t(u32, s->size / 4, dev->bar0_size / 4);
+            for (i = 0; i < dev->bar0_size / 4; i++)
+                writel(i < words ? regs[i] : 0, dev->bar0_virt + i * 4);
+            break;
+
+        case PCIE_SIM_SNAP_MMIO:
+            pcie_sim_snapshot_copy(&mmio, sizeof(mmio), s);
+            for (i = 0; i < PCIE_SIM_MMIO_TRACKED_REGS; i++) {
+                atomic64_set(&dev->mmio_reads[i], mmio.reg_reads[i]);
+                atomic64_set(&dev->mmio_writes[i], mmio.reg_writes[i]);
+            }
+            atomic64_set(&dev->mmio_read_cost_ns, mmio.read_cost_ns);
+            atomic64_set(&dev->mmio_write_cost_ns, mmio.write_cost_ns);
+            break;
+        }
+    }
+
+    atomic_set(&dev->dma_active, 0);
+}
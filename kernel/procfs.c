@@ -27,6 +27,18 @@
 
 #include "common.h"
 
+/*
+ * Print a labelled nanosecond figure with its microsecond equivalent to
+ * two places, in integer arithmetic
+ */
+static void proc_show_ns(struct seq_file *m, const char *label, u64 ns)
+{
+    u32 rem;
+    u64 us = div_u64_rem(ns, 1000, &rem);
+
+    seq_printf(m, "  %-21s%llu ns (%llu.%02u µs)\n", label, ns, us, rem / 10);
+}
+
 /*
  * Show device statistics in /proc/pcie_simX/stats
  */
@@ -34,29 +46,32 @@ static int proc_stats_show(struct seq_file *m, void *v)
 {
     struct pcie_sim_device *dev = m->private;
     u64 total_transfers, total_bytes, total_errors;
-    double avg_throughput_mbps = 0.0;
+    u64 mbps_x100 = 0;      /* Hundredths of a Mbps */
+    struct pcie_sim_stats st;
 
     if (!dev) {
         seq_puts(m, "Error: No device context\n");
         return 0;
     }
 
-    /* Read statistics atomically */
-    total_transfers = atomic64_read(&dev->stats.total_transfers);
-    total_bytes = atomic64_read(&dev->stats.total_bytes);
-    total_errors = atomic64_read(&dev->stats.total_errors);
+    /* Read a consistent summary */
+    pcie_sim_stats_read(dev, &st);
+    total_transfers = st.total_transfers;
+    total_bytes = st.total_bytes;
+    total_errors = st.total_errors;
 
-    /* Calculate average throughput if we have latency data */
-    if (dev->stats.avg_latency_ns > 0 && total_bytes > 0) {
-        /* Convert to Mbps: (bytes * 8 bits/byte) / (latency_ns / 1e9 s/ns) / 1e6 */
-        avg_throughput_mbps = (double)(total_bytes * 8) /
-                             ((dev->stats.avg_latency_ns / 1000000000.0) * total_transfers) / 1000000.0;
-    }
+    /* Bits per microsecond of transfer time; 128-bit so bytes * 8 cannot overflow */
+    if (st.avg_latency_ns > 0 && total_bytes > 0)
+        mbps_x100 = pcie_sim_u128_div(pcie_sim_u128_mul(total_bytes, 800000),
+                                      st.avg_latency_ns * total_transfers);
 
     /* Display statistics in human-readable format */
     seq_printf(m, "PCIe Simulator Device %d Statistics\n", dev->device_id);
     seq_puts(m, "===================================\n\n");
 
+    seq_printf(m, "Statistics Epoch:     %llu (since the last reset)\n\n",
+              READ_ONCE(dev->stats_page->epoch));
+
     seq_puts(m, "Transfer Summary:\n");
     seq_printf(m, "  Total Transfers:     %llu\n", total_transfers);
     seq_printf(m, "  Total Bytes:         %llu (%llu KB, %llu MB)\n",
@@ -64,43 +79,222 @@ static int proc_stats_show(struct seq_file *m, void *v)
     seq_printf(m, "  Total Errors:        %llu\n", total_errors);
 
     if (total_transfers > 0) {
+        u64 rate_x100 = div64_u64(total_errors * 10000, total_transfers + total_errors);
+        u32 rem;
+
         seq_printf(m, "  Average Transfer Size: %llu bytes\n",
-                  total_bytes / total_transfers);
-        seq_printf(m, "  Error Rate:          %.2f%%\n",
-                  (double)total_errors * 100.0 / (total_transfers + total_errors));
+                  div64_u64(total_bytes, total_transfers));
+        rate_x100 = div_u64_rem(rate_x100, 100, &rem);
+        seq_printf(m, "  Error Rate:          %llu.%02u%%\n", rate_x100, rem);
     }
 
     seq_puts(m, "\nLatency Statistics:\n");
-    seq_printf(m, "  Average Latency:     %llu ns (%.2f µs)\n",
-              dev->stats.avg_latency_ns, dev->stats.avg_latency_ns / 1000.0);
+    proc_show_ns(m, "Average Latency:", st.avg_latency_ns);
+    proc_show_ns(m, "Std Deviation:", st.stddev_latency_ns);
 
-    if (dev->stats.min_latency_ns > 0) {
-        seq_printf(m, "  Minimum Latency:     %llu ns (%.2f µs)\n",
-                  dev->stats.min_latency_ns, dev->stats.min_latency_ns / 1000.0);
-    } else {
+    if (total_transfers > 0)
+        proc_show_ns(m, "Minimum Latency:", st.min_latency_ns);
+    else
         seq_puts(m, "  Minimum Latency:     Not measured\n");
-    }
 
-    seq_printf(m, "  Maximum Latency:     %llu ns (%.2f µs)\n",
-              dev->stats.max_latency_ns, dev->stats.max_latency_ns / 1000.0);
+    proc_show_ns(m, "Maximum Latency:", st.max_latency_ns);
 
-    if (dev->stats.max_latency_ns > dev->stats.min_latency_ns && dev->stats.min_latency_ns > 0) {
-        u64 jitter_ns = dev->stats.max_latency_ns - dev->stats.min_latency_ns;
-        seq_printf(m, "  Jitter (max-min):    %llu ns (%.2f µs)\n",
-                  jitter_ns, jitter_ns / 1000.0);
-    }
+    if (total_transfers > 0 && st.max_latency_ns > st.min_latency_ns)
+        proc_show_ns(m, "Jitter (max-min):", st.max_latency_ns - st.min_latency_ns);
 
     seq_puts(m, "\nPerformance Metrics:\n");
-    if (avg_throughput_mbps > 0) {
-        seq_printf(m, "  Average Throughput:  %.2f Mbps (%.2f MB/s)\n",
-                  avg_throughput_mbps, avg_throughput_mbps / 8.0);
+    if (mbps_x100 > 0) {
+        u32 rem, mb_rem;
+        u64 mbps = div_u64_rem(mbps_x100, 100, &rem);
+        u64 mbs = div_u64_rem(div_u64(mbps_x100, 8), 100, &mb_rem);
+
+        seq_printf(m, "  Average Throughput:  %llu.%02u Mbps (%llu.%02u MB/s)\n",
+                  mbps, rem, mbs, mb_rem);
     } else {
         seq_puts(m, "  Average Throughput:  Not calculated\n");
     }
 
+    {
+        static const char * const err_names[] = {
+            "invalid", "nomem", "fault", "busy", "device", "timeout"
+        };
+        struct pcie_sim_transfer_stats xfer;
+        int i;
+
+        pcie_sim_stats_save(dev, &xfer);
+
+        seq_puts(m, "\nBy Direction:\n");
+        for (i = 0; i < 2; i++) {
+            const struct pcie_sim_dir_stats *d = &xfer.dir[i];
+
+            seq_printf(m, "  %s: %llu transfers, %llu bytes, %llu errors",
+                      i ? "Device->Host" : "Host->Device", d->transfers, d->bytes, d->errors);
+            if (d->transfers)
+                seq_printf(m, ", %llu/%llu/%llu ns min/avg/max",
+                          d->latency_min_ns, div64_u64(d->latency_sum_ns, d->transfers),
+                          d->latency_max_ns);
+            seq_puts(m, "\n");
+        }
+
+        if (total_errors > 0) {
+            seq_puts(m, "\nErrors by Type:\n");
+            for (i = 0; i < ARRAY_SIZE(err_names); i++)
+                if (xfer.errors[i])
+                    seq_printf(m, "  %-20s %llu\n", err_names[i], xfer.errors[i]);
+        }
+
+        if (total_transfers > 0) {
+            static const char * const phase_names[PCIE_SIM_PHASES] = {
+                "Allocation", "Copy In", "Queue Wait", "Wire", "Completion", "Copy Out"
+            };
+            struct pcie_sim_phase_stats *phases;
+
+            phases = kmalloc_array(PCIE_SIM_PHASES, sizeof(*phases), GFP_KERNEL);
+            if (phases) {
+                pcie_sim_stats_read_phases(dev, phases);
+                seq_puts(m, "\nTransfer Phases (avg/max ns):\n");
+                for (i = 0; i < PCIE_SIM_PHASES; i++)
+                    if (phases[i].count)
+                        seq_printf(m, "  %-20s %llu/%llu\n", phase_names[i],
+                                  div64_u64(phases[i].sum_ns, phases[i].count),
+                                  phases[i].max_ns);
+                kfree(phases);
+            }
+
+            seq_puts(m, "\nLatency Histogram (ns):\n");
+            for (i = 0; i < PCIE_SIM_STATS_LAT_BUCKETS; i++)
+                if (xfer.latency_hist[i])
+                    seq_printf(m, "  < 2^%-2d %llu\n", i + 1, xfer.latency_hist[i]);
+        }
+    }
+
+    {
+        u64 reads = 0, writes = 0;
+        int i;
+
+        for (i = 0; i < PCIE_SIM_MMIO_TRACKED_REGS; i++) {
+            reads += atomic64_read(&dev->mmio_reads[i]);
+            writes += atomic64_read(&dev->mmio_writes[i]);
+        }
+
+        seq_puts(m, "\nMMIO Accesses:\n");
+        seq_printf(m, "  Register Reads:      %llu\n", reads);
+        seq_printf(m, "  Register Writes:     %llu\n", writes);
+        seq_printf(m, "  Modeled Cost:        %llu ns\n",
+                  (u64)atomic64_read(&dev->mmio_read_cost_ns) +
+                  (u64)atomic64_read(&dev->mmio_write_cost_ns));
+        if (total_transfers > 0)
+            seq_printf(m, "  Reads per Transfer:  %llu\n", reads / total_transfers);
+
+        for (i = 0; i < PCIE_SIM_MMIO_TRACKED_REGS; i++) {
+            u64 r = atomic64_read(&dev->mmio_reads[i]);
+            u64 w = atomic64_read(&dev->mmio_writes[i]);
+
+            if (r || w)
+                seq_printf(m, "  0x%03x: %llu reads, %llu writes\n", i * 4, r, w);
+        }
+    }
+
+    if (dev->num_rings) {
+        u64 doorbells = 0, submissions = 0;
+        u32 q;
+        int dir, cpu;
+
+        seq_puts(m, "\nRings:\n");
+        seq_printf(m, "  Geometry:            %u x %u descriptors per direction\n",
+                  dev->num_rings, dev->ring_size);
+        seq_printf(m, "  Descriptor Memory:   %llu bytes\n",
+                  (u64)atomic64_read(&dev->ring_memory));
+
+        seq_puts(m, "\nDescriptor Engine:\n");
+        for (q = 0; q < dev->num_rings; q++) {
+            for (dir = 0; dir < 2; dir++) {
+                struct pcie_sim_ring *ring = dir ? &dev->rx_rings[q] : &dev->tx_rings[q];
+                u64 completions = atomic64_read(&ring->completions);
+                u64 fetches = atomic64_read(&ring->fetches);
+                u64 writebacks = atomic64_read(&ring->writebacks);
+
+                doorbells += atomic64_read(&ring->doorbells);
+                submissions += atomic64_read(&ring->submissions);
+
+                if (!ring->sq)
+                    continue;
+
+                seq_printf(m, "  %s%u: %u in flight, %llu reaped, %llu fetches (%llu stalled), %llu writebacks",
+                          dir ? "RX" : "TX", q, pcie_sim_ring_count(ring),
+                          READ_ONCE(ring->reaped), fetches,
+                          (u64)atomic64_read(&ring->fetch_stalls), writebacks);
+                if (fetches > 0 && writebacks > 0)
+                    seq_printf(m, ", %llu/%llu descriptors per fetch/writeback",
+                              completions / fetches, completions / writebacks);
+                seq_printf(m, ", modeled %llu ns fetch, %llu ns writeback\n",
+                          (u64)atomic64_read(&ring->fetch_cost_ns),
+                          (u64)atomic64_read(&ring->writeback_cost_ns));
+            }
+        }
+
+        seq_puts(m, "\nPer-CPU Queues:\n");
+        for_each_online_cpu(cpu) {
+            struct pcie_sim_cpu_stats *cs = per_cpu_ptr(dev->cpu_stats, cpu);
+
+            if (!cs->submissions && !cs->completions)
+                continue;
+            seq_printf(m, "  CPU%-3d -> queue %-2u %llu submitted, %llu completed (%llu remote)\n",
+                      cpu, cpu % dev->num_rings, cs->submissions, cs->completions,
+                      cs->remote_completions);
+        }
+
+        seq_puts(m, "\nDevice Engine Threads:\n");
+        if (!READ_ONCE(dev->active))
+            seq_puts(m, "  Stopped (device closed)\n");
+        else if (!dev->num_engines)
+            seq_puts(m, "  None (device runs inline in the submitter)\n");
+        for (q = 0; q < dev->num_engines; q++) {
+            struct pcie_sim_engine *eng = &dev->engines[q];
+
+            if (eng->cpu >= 0)
+                seq_printf(m, "  Engine %-2u CPU%-3d", q, eng->cpu);
+            else
+                seq_printf(m, "  Engine %-2u unpinned", q);
+            seq_printf(m, " %llu descriptors, %llu passes (%llu over budget), %llu sleeps\n",
+                      (u64)atomic64_read(&eng->descriptors),
+                      (u64)atomic64_read(&eng->passes),
+                      (u64)atomic64_read(&eng->budget_exhausted),
+                      (u64)atomic64_read(&eng->sleeps));
+        }
+
+        seq_puts(m, "\nDoorbells:\n");
+        seq_printf(m, "  Doorbell Writes:     %llu\n", doorbells);
+        if (doorbells > 0)
+            seq_printf(m, "  Descriptors/Doorbell: %llu\n", submissions / doorbells);
+        if (submissions > 0)
+            seq_printf(m, "  Doorbells/Transfer:  %llu.%02llu\n",
+                      doorbells / submissions, doorbells * 100 / submissions % 100);
+    }
+
+    {
+        struct pcie_sim_memory_stats mem;
+
+        pcie_sim_memory_usage(dev, &mem);
+        seq_puts(m, "\nMemory Footprint:\n");
+        seq_printf(m, "  Device State:        %llu bytes\n", mem.device_bytes);
+        seq_printf(m, "  BAR0:                %llu bytes\n", mem.bar_bytes);
+        seq_printf(m, "  Descriptor Rings:    %llu bytes\n", mem.ring_bytes);
+        seq_printf(m, "  Bounce Buffers:      %llu bytes (peak %llu)\n",
+                  mem.bounce_bytes, mem.bounce_peak_bytes);
+        seq_printf(m, "  Statistics:          %llu bytes\n", mem.stats_bytes);
+        seq_printf(m, "  Engine Stacks:       %llu bytes\n", mem.engine_bytes);
+        seq_printf(m, "  Total:               %llu bytes (%llu KB)\n",
+                  mem.total_bytes, mem.total_bytes / 1024);
+    }
+
     seq_puts(m, "\nDevice Status:\n");
     seq_printf(m, "  Device Enabled:      %s\n", dev->enabled ? "Yes" : "No");
     seq_printf(m, "  Device File:         /dev/pcie_sim%d\n", dev->device_id);
+    if (READ_ONCE(dev->active))
+        seq_printf(m, "  Resources:           Allocated, %u open\n", READ_ONCE(dev->open_count));
+    else
+        seq_puts(m, "  Resources:           Released\n");
 
     return 0;
 }
@@ -151,7 +345,7 @@ int pcie_sim_proc_init(struct pcie_sim_device *dev)
         return -ENOMEM;
     }
 
-    pr_info("Proc interface created: /proc/%s/stats\n", dir_name);
+    pr_debug("Proc interface created: /proc/%s/stats\n", dir_name);
     return 0;
 }
 
@@ -27,46 +27,165 @@
 
 #include "common.h"
 #include <linux/dma-mapping.h>
+#include <linux/log2.h>
+#include <linux/mm.h>
 
-#define RING_SIZE 256  /* Number of descriptors per ring */
+/*
+ * Default ring geometry for new devices; PCIE_SIM_IOC_SET_RING_CONFIG
+ * changes it per device while the rings are idle
+ */
+static unsigned int ring_size = 256;
+module_param(ring_size, uint, 0444);
+MODULE_PARM_DESC(ring_size, "Descriptors per ring, power of two 8-65536 (default 256)");
+
+static unsigned int num_rings;
+module_param(num_rings, uint, 0444);
+MODULE_PARM_DESC(num_rings, "Rings per direction, 1-16; 0 = one per online CPU (default 0)");
 
 /*
- * Initialize a single ring buffer
+ * Descriptors submitted per tail doorbell write. 1 rings the doorbell for
+ * every descriptor; larger values amortize the MMIO write over a batch.
  */
-static int init_ring(struct pcie_sim_device *dev, struct pcie_sim_ring *ring, const char *name)
-{
-    size_t desc_size;
+static unsigned int doorbell_batch = 1;
+module_param(doorbell_batch, uint, 0644);
+MODULE_PARM_DESC(doorbell_batch, "Descriptors per TX/RX doorbell write (default 1)");
 
-    pr_debug("Initializing %s ring buffer\n", name);
+/*
+ * Descriptor engine model. The device reads descriptors from host memory in
+ * bursts, each a non-posted PCIe read, and prefetches the next burst once
+ * its cache drops to the threshold. Completions are written back in
+ * batches; a slot is free for the host only once its completion entry
+ * has been written back and reaped.
+ */
+static unsigned int desc_fetch_burst = 8;
+module_param(desc_fetch_burst, uint, 0644);
+MODULE_PARM_DESC(desc_fetch_burst, "Descriptors read per fetch (default 8)");
 
-    /* Initialize ring structure */
-    ring->size = RING_SIZE;
+static unsigned int desc_prefetch_threshold = 2;
+module_param(desc_prefetch_threshold, uint, 0644);
+MODULE_PARM_DESC(desc_prefetch_threshold, "Prefetch when this many fetched descriptors remain (default 2)");
+
+static unsigned int desc_fetch_ns = 1000;
+module_param(desc_fetch_ns, uint, 0644);
+MODULE_PARM_DESC(desc_fetch_ns, "Modeled PCIe read round trip per fetch in ns (default 1000)");
+
+static unsigned int desc_writeback_batch = 1;
+module_param(desc_writeback_batch, uint, 0644);
+MODULE_PARM_DESC(desc_writeback_batch, "Completions per writeback, max 64 (default 1)");
+
+static unsigned int desc_writeback_ns = 100;
+module_param(desc_writeback_ns, uint, 0644);
+MODULE_PARM_DESC(desc_writeback_ns, "Modeled cost per writeback in ns (default 100)");
+
+/*
+ * Return a ring's indices to their reset state, matching a zeroed CQ
+ */
+static void reset_ring(struct pcie_sim_ring *ring)
+{
+    /* Driver side */
     ring->head = 0;
+    ring->unposted = 0;
+    ring->cq_head = 0;
+    ring->cq_expected = PCIE_SIM_CQE_PHASE;
+    ring->sq_reaped = 0;
+
+    /* Device side */
     ring->tail = 0;
-    atomic_set(&ring->count, 0);
+    ring->doorbell_tail = 0;
+    ring->fetched = 0;
+    ring->wb_head = 0;
+    ring->wb_pending = 0;
+    ring->cq_tail = 0;
+    ring->cq_phase = PCIE_SIM_CQE_PHASE;
+    ring->poll_state = 0;
+}
+
+/*
+ * Initialize a single ring buffer; descriptor memory is allocated on first use
+ */
+static void init_ring(struct pcie_sim_ring *ring, u32 size, u32 doorbell_reg)
+{
+    /* Initialize ring structure */
+    ring->sq = NULL;
+    ring->cq = NULL;
+    ring->slots = NULL;
+    ring->sq_dma_addr = 0;
+    ring->cq_dma_addr = 0;
+    ring->size = size;
+    ring->doorbell_reg = doorbell_reg;
+    mutex_init(&ring->alloc_lock);
+    spin_lock_init(&ring->sq_lock);
+    spin_lock_init(&ring->cq_lock);
     spin_lock_init(&ring->lock);
+    reset_ring(ring);
 
     /* Reset statistics */
+    ring->reaped = 0;
     atomic64_set(&ring->submissions, 0);
     atomic64_set(&ring->completions, 0);
     atomic64_set(&ring->overruns, 0);
+    atomic64_set(&ring->doorbells, 0);
+    atomic64_set(&ring->fetches, 0);
+    atomic64_set(&ring->fetch_stalls, 0);
+    atomic64_set(&ring->writebacks, 0);
+    atomic64_set(&ring->fetch_cost_ns, 0);
+    atomic64_set(&ring->writeback_cost_ns, 0);
+}
 
-    /* Allocate DMA-coherent memory for descriptors */
-    desc_size = ring->size * sizeof(struct pcie_sim_ring_desc);
-    ring->descriptors = dma_alloc_coherent(&dev->pdev->dev, desc_size,
-                                         &ring->desc_dma_addr, GFP_KERNEL);
-    if (!ring->descriptors) {
-        pr_err("Failed to allocate %s ring descriptors\n", name);
-        return -ENOMEM;
-    }
-
-    /* Initialize all descriptors */
-    memset(ring->descriptors, 0, desc_size);
+/*
+ * Bytes of DMA-coherent memory behind a ring: the submission queue, then
+ * the completion queue. Both are at least 64 bytes, so the CQ starts on
+ * its own cache line.
+ */
+static size_t ring_dma_size(struct pcie_sim_ring *ring)
+{
+    return ring->size * (sizeof(struct pcie_sim_sq_desc) + sizeof(struct pcie_sim_cqe));
+}
 
-    pr_info("%s ring initialized: %u descriptors at %p (DMA: %pad)\n",
-           name, ring->size, ring->descriptors, &ring->desc_dma_addr);
+/*
+ * Allocate a ring's descriptor memory if it has none yet
+ */
+static int alloc_ring(struct pcie_sim_device *dev, struct pcie_sim_ring *ring)
+{
+    size_t dma_size = ring_dma_size(ring);
+    int ret = 0;
+
+    BUILD_BUG_ON(sizeof(struct pcie_sim_sq_desc) != 16);
+    BUILD_BUG_ON(sizeof(struct pcie_sim_cqe) != 8);
+
+    mutex_lock(&ring->alloc_lock);
+
+    if (!ring->sq) {
+        ring->slots = kvcalloc(ring->size, sizeof(*ring->slots), GFP_KERNEL);
+        if (!ring->slots) {
+            ret = -ENOMEM;
+            goto out;
+        }
+
+        /* Allocate DMA-coherent memory for both queues */
+        ring->sq = dma_alloc_coherent(&dev->pdev->dev, dma_size,
+                                      &ring->sq_dma_addr, GFP_KERNEL);
+        if (!ring->sq) {
+            pr_err("Failed to allocate %u ring descriptors\n", ring->size);
+            kvfree(ring->slots);
+            ring->slots = NULL;
+            ret = -ENOMEM;
+            goto out;
+        }
+
+        /* A zeroed CQ holds no entry with the initial phase tag */
+        memset(ring->sq, 0, dma_size);
+        ring->cq = (struct pcie_sim_cqe *)(ring->sq + ring->size);
+        ring->cq_dma_addr = ring->sq_dma_addr + ring->size * sizeof(struct pcie_sim_sq_desc);
+        atomic64_add(dma_size + ring->size * sizeof(*ring->slots), &dev->ring_memory);
+
+        pr_debug("Ring allocated: %u descriptors, SQ at %pad, CQ at %pad\n",
+                ring->size, &ring->sq_dma_addr, &ring->cq_dma_addr);
+    }
 
-    return 0;
+out:
+    mutex_unlock(&ring->alloc_lock);
+    return ret;
 }
 
 /*
@@ -74,24 +193,53 @@ static int init_ring(struct pcie_sim_device *dev, struct pcie_sim_ring *ring, co
  */
 static void cleanup_ring(struct pcie_sim_device *dev, struct pcie_sim_ring *ring)
 {
-    size_t desc_size;
+    size_t dma_size = ring_dma_size(ring);
 
-    if (!ring->descriptors)
+    if (!ring->sq)
         return;
 
-    desc_size = ring->size * sizeof(struct pcie_sim_ring_desc);
-    dma_free_coherent(&dev->pdev->dev, desc_size, ring->descriptors, ring->desc_dma_addr);
+    dma_free_coherent(&dev->pdev->dev, dma_size, ring->sq, ring->sq_dma_addr);
+    kvfree(ring->slots);
+    atomic64_sub(dma_size + ring->size * sizeof(*ring->slots), &dev->ring_memory);
+
+    ring->sq = NULL;
+    ring->cq = NULL;
+    ring->slots = NULL;
+    ring->sq_dma_addr = 0;
+    ring->cq_dma_addr = 0;
+}
+
+/*
+ * Check a ring geometry against the limits
+ */
+static bool ring_config_valid(u32 size, u32 count)
+{
+    return is_power_of_2(size) && size >= PCIE_SIM_RING_MIN_SIZE &&
+           size <= PCIE_SIM_RING_MAX_SIZE && count >= 1 && count <= PCIE_SIM_MAX_QUEUES;
+}
+
+/*
+ * (Re)create the device's rings with the given geometry
+ */
+static void setup_rings(struct pcie_sim_device *dev, u32 size, u32 count)
+{
+    u32 i;
+
+    dev->ring_size = size;
+    dev->num_rings = count;
 
-    ring->descriptors = NULL;
-    ring->desc_dma_addr = 0;
+    for (i = 0; i < count; i++) {
+        init_ring(&dev->tx_rings[i], size, PCIE_SIM_REG_TX_DOORBELL_Q(i));
+        init_ring(&dev->rx_rings[i], size, PCIE_SIM_REG_RX_DOORBELL_Q(i));
+    }
 }
 
 /*
- * Get number of used entries in ring
+ * Get number of used entries in ring: submitted and not yet reaped
  */
 u32 pcie_sim_ring_count(struct pcie_sim_ring *ring)
 {
-    return atomic_read(&ring->count);
+    return (READ_ONCE(ring->head) + ring->size - READ_ONCE(ring->sq_reaped)) % ring->size;
 }
 
 /*
@@ -99,49 +247,219 @@ u32 pcie_sim_ring_count(struct pcie_sim_ring *ring)
  */
 u32 pcie_sim_ring_space(struct pcie_sim_ring *ring)
 {
-    return ring->size - atomic_read(&ring->count);
+    return ring->size - 1 - pcie_sim_ring_count(ring);
+}
+
+/*
+ * Submit a descriptor to the ring. Caller holds ring->sq_lock.
+ */
+static int ring_submit(struct pcie_sim_ring *ring, u64 buffer_addr,
+                       u32 length, u32 flags, void *ctx)
+{
+    u32 head = ring->head;
+
+    /* Full when advancing head would reach the oldest unreaped slot */
+    if ((head + 1) % ring->size == READ_ONCE(ring->sq_reaped)) {
+        atomic64_inc(&ring->overruns);
+        pr_warn("Ring buffer overrun\n");
+        return -ENOSPC;
+    }
+
+    /* Fill descriptor; the timestamp stays out of device-visible memory */
+    ring->sq[head].buffer_addr = buffer_addr;
+    ring->sq[head].length = length;
+    ring->sq[head].flags = (u16)flags;
+    ring->sq[head].id = (u16)head;
+    ring->slots[head].submit_ns = ktime_get_ns();
+    ring->slots[head].cpu = raw_smp_processor_id();
+    ring->slots[head].ctx = ctx;
+
+    /* Advance head pointer; the device sees it after the next doorbell */
+    WRITE_ONCE(ring->head, (head + 1) % ring->size);
+    atomic64_inc(&ring->submissions);
+    ring->unposted++;
+
+    pr_debug("Ring submit: addr=%llx len=%u flags=%x slot=%u\n",
+            buffer_addr, length, flags, head);
+
+    return 0;
+}
+
+/*
+ * Write the ring's head to its tail doorbell. Caller holds ring->sq_lock.
+ */
+static void ring_kick(struct pcie_sim_device *dev, struct pcie_sim_ring *ring)
+{
+    if (!ring->unposted)
+        return;
+
+    /* Descriptors must be visible before the device can fetch them */
+    dma_wmb();
+    pcie_sim_mmio_write32(dev, ring->doorbell_reg, ring->head);
+    ring->unposted = 0;
 }
 
 /*
- * Submit a descriptor to the ring
+ * Submit a descriptor to the ring without ringing the doorbell
  */
 int pcie_sim_ring_submit(struct pcie_sim_ring *ring, u64 buffer_addr,
-                        u32 length, u32 flags)
+                        u32 length, u32 flags, void *ctx)
+{
+    unsigned long irq_flags;
+    int ret;
+
+    if (!ring->sq)
+        return -ENOMEM;
+
+    spin_lock_irqsave(&ring->sq_lock, irq_flags);
+    ret = ring_submit(ring, buffer_addr, length, flags, ctx);
+    spin_unlock_irqrestore(&ring->sq_lock, irq_flags);
+
+    return ret;
+}
+
+/*
+ * Device side of the tail doorbell: publish descriptors up to tail
+ */
+void pcie_sim_ring_doorbell(struct pcie_sim_ring *ring, u32 tail)
 {
     unsigned long irq_flags;
-    u32 next_head;
 
     spin_lock_irqsave(&ring->lock, irq_flags);
+    ring->doorbell_tail = tail % ring->size;
+    atomic64_inc(&ring->doorbells);
+    spin_unlock_irqrestore(&ring->lock, irq_flags);
+}
 
-    /* Check for space */
-    if (atomic_read(&ring->count) >= ring->size) {
-        atomic64_inc(&ring->overruns);
-        spin_unlock_irqrestore(&ring->lock, irq_flags);
-        pr_warn("Ring buffer overrun\n");
-        return -ENOSPC;
+/*
+ * Write the ring's head to its tail doorbell if anything is unposted
+ */
+void pcie_sim_ring_kick(struct pcie_sim_device *dev, struct pcie_sim_ring *ring)
+{
+    unsigned long irq_flags;
+
+    spin_lock_irqsave(&ring->sq_lock, irq_flags);
+    ring_kick(dev, ring);
+    spin_unlock_irqrestore(&ring->sq_lock, irq_flags);
+}
+
+/*
+ * Submit a descriptor and ring the doorbell once doorbell_batch are pending
+ */
+int pcie_sim_ring_post(struct pcie_sim_device *dev, struct pcie_sim_ring *ring,
+                      u64 buffer_addr, u32 length, u32 flags, void *ctx)
+{
+    unsigned long irq_flags;
+    int ret;
+
+    ret = alloc_ring(dev, ring);
+    if (ret)
+        return ret;
+
+    spin_lock_irqsave(&ring->sq_lock, irq_flags);
+    ret = ring_submit(ring, buffer_addr, length, flags, ctx);
+    if (!ret && (ring->unposted >= max(doorbell_batch, 1U) || !pcie_sim_ring_space(ring)))
+        ring_kick(dev, ring);
+    spin_unlock_irqrestore(&ring->sq_lock, irq_flags);
+
+    if (!ret)
+        this_cpu_inc(dev->cpu_stats->submissions);
+
+    return ret;
+}
+
+/*
+ * Published descriptors the device has not consumed yet. Caller holds
+ * ring->lock; only device-owned indices are read.
+ */
+static u32 ring_outstanding(struct pcie_sim_ring *ring)
+{
+    return (ring->doorbell_tail + ring->size - ring->tail) % ring->size;
+}
+
+/*
+ * Read the next burst of published descriptors into the device.
+ * Caller holds ring->lock. Returns the modeled cost of the read.
+ */
+static u64 ring_fetch(struct pcie_sim_ring *ring)
+{
+    u32 n = min(max(desc_fetch_burst, 1U), ring_outstanding(ring) - ring->fetched);
+
+    if (!n)
+        return 0;
+
+    ring->fetched += n;
+    atomic64_inc(&ring->fetches);
+    atomic64_add(desc_fetch_ns, &ring->fetch_cost_ns);
+
+    return desc_fetch_ns;
+}
+
+/*
+ * Post held completions to the completion queue; the driver frees the
+ * slots when it reaps them. Caller holds ring->lock.
+ */
+static void ring_writeback(struct pcie_sim_ring *ring)
+{
+    u32 i;
+
+    if (!ring->wb_pending)
+        return;
+
+    for (i = 0; i < ring->wb_pending; i++) {
+        struct pcie_sim_cqe *cqe = &ring->cq[ring->cq_tail];
+
+        cqe->status = ring->wb_status[i];
+        cqe->id = (u16)((ring->wb_head + i) % ring->size);
+        /* The phase tag publishes the entry, so it is written last */
+        dma_wmb();
+        WRITE_ONCE(cqe->info, ring->cq_phase);
+
+        if (++ring->cq_tail == ring->size) {
+            ring->cq_tail = 0;
+            ring->cq_phase ^= PCIE_SIM_CQE_PHASE;
+        }
     }
 
-    /* Fill descriptor */
-    ring->descriptors[ring->head].buffer_addr = buffer_addr;
-    ring->descriptors[ring->head].length = length;
-    ring->descriptors[ring->head].flags = flags;
-    ring->descriptors[ring->head].timestamp = ktime_get_ns();
-    ring->descriptors[ring->head].status = 0;  /* Pending */
+    ring->wb_head = (ring->wb_head + ring->wb_pending) % ring->size;
+    ring->wb_pending = 0;
 
-    /* Advance head pointer */
-    next_head = (ring->head + 1) % ring->size;
-    ring->head = next_head;
+    atomic64_inc(&ring->writebacks);
+    atomic64_add(desc_writeback_ns, &ring->writeback_cost_ns);
+}
 
-    /* Update count */
-    atomic_inc(&ring->count);
-    atomic64_inc(&ring->submissions);
+/*
+ * Flush a partial writeback batch, as a device's writeback timer would
+ */
+void pcie_sim_ring_writeback(struct pcie_sim_ring *ring)
+{
+    unsigned long irq_flags;
 
+    spin_lock_irqsave(&ring->lock, irq_flags);
+    ring_writeback(ring);
     spin_unlock_irqrestore(&ring->lock, irq_flags);
+}
 
-    pr_debug("Ring submit: addr=%llx len=%u flags=%x count=%u\n",
-            buffer_addr, length, flags, atomic_read(&ring->count));
+/*
+ * Copy out the next published descriptor the device has not consumed.
+ * Only the ring's poller consumes descriptors, so it stays next until
+ * the poller completes it.
+ */
+int pcie_sim_ring_peek(struct pcie_sim_ring *ring, struct pcie_sim_sq_desc *desc)
+{
+    unsigned long irq_flags;
+    int ret = -ENODATA;
 
-    return 0;
+    spin_lock_irqsave(&ring->lock, irq_flags);
+    if (ring_outstanding(ring)) {
+        *desc = ring->sq[ring->tail];
+        /* The device starts on the descriptor once it has read it */
+        ring->slots[ring->tail].start_ns = ktime_get_ns();
+        ret = 0;
+    }
+    spin_unlock_irqrestore(&ring->lock, irq_flags);
+
+    return ret;
 }
 
 /*
@@ -151,71 +469,365 @@ int pcie_sim_ring_complete(struct pcie_sim_ring *ring, u32 *length,
                           u64 *latency_ns, u32 status)
 {
     unsigned long irq_flags;
-    struct pcie_sim_ring_desc *desc;
-    u64 completion_time;
+    struct pcie_sim_sq_desc *desc;
+    u64 completion_time, submit_time, stall_ns = 0;
+    u32 wb_batch, desc_len;
 
     spin_lock_irqsave(&ring->lock, irq_flags);
 
-    /* Check if ring has entries */
-    if (atomic_read(&ring->count) == 0) {
+    /* Only descriptors published by a doorbell can be consumed */
+    if (ring_outstanding(ring) == 0) {
         spin_unlock_irqrestore(&ring->lock, irq_flags);
         return -ENODATA;
     }
 
+    /* Nothing cached: the completion waits for a demand fetch */
+    if (!ring->fetched) {
+        stall_ns = ring_fetch(ring);
+        atomic64_inc(&ring->fetch_stalls);
+    }
+
     /* Get descriptor to complete */
-    desc = &ring->descriptors[ring->tail];
-    completion_time = ktime_get_ns();
+    desc = &ring->sq[ring->tail];
+    submit_time = ring->slots[ring->tail].submit_ns;
+    completion_time = ktime_get_ns() + stall_ns;
+    ring->slots[ring->tail].done_ns = completion_time;
+
+    /* The slot may be reused once the lock drops; keep what is logged */
+    desc_len = desc->length;
 
     /* Fill return values */
     if (length)
-        *length = desc->length;
+        *length = desc_len;
     if (latency_ns)
-        *latency_ns = completion_time - desc->timestamp;
+        *latency_ns = completion_time - submit_time;
 
-    /* Mark as completed */
-    desc->status = status;
-
-    /* Advance tail pointer */
+    /* Advance tail pointer; the slot stays in use until it is reaped */
     ring->tail = (ring->tail + 1) % ring->size;
-
-    /* Update count */
-    atomic_dec(&ring->count);
+    ring->fetched--;
     atomic64_inc(&ring->completions);
 
+    /* Prefetch the next burst off the critical path */
+    if (ring->fetched <= desc_prefetch_threshold)
+        ring_fetch(ring);
+
+    wb_batch = clamp(desc_writeback_batch, 1U, (u32)PCIE_SIM_RING_MAX_WRITEBACK);
+    ring->wb_status[ring->wb_pending++] = status;
+    if (ring->wb_pending >= wb_batch || ring_outstanding(ring) == 0)
+        ring_writeback(ring);
+
     spin_unlock_irqrestore(&ring->lock, irq_flags);
 
-    pr_debug("Ring complete: len=%u status=%u latency=%llu ns count=%u\n",
-            desc->length, status, completion_time - desc->timestamp,
-            atomic_read(&ring->count));
+    pr_debug("Ring complete: len=%u status=%u latency=%llu ns\n",
+            desc_len, status, completion_time - submit_time);
 
     return 0;
 }
 
+/*
+ * Reap the next completion. Only the phase tag of the entry at cq_head is
+ * polled; no device index or shared counter is read.
+ */
+int pcie_sim_ring_reap(struct pcie_sim_ring *ring, struct pcie_sim_completion *c)
+{
+    unsigned long irq_flags;
+    struct pcie_sim_cqe *cqe;
+    u16 slot;
+
+    if (!ring->cq)
+        return -ENODATA;
+
+    spin_lock_irqsave(&ring->cq_lock, irq_flags);
+
+    cqe = &ring->cq[ring->cq_head];
+    if ((READ_ONCE(cqe->info) & PCIE_SIM_CQE_PHASE) != ring->cq_expected) {
+        spin_unlock_irqrestore(&ring->cq_lock, irq_flags);
+        return -EAGAIN;
+    }
+
+    /* Read the entry only after its phase tag */
+    dma_rmb();
+    slot = cqe->id;
+    c->id = slot;
+    c->status = cqe->status;
+    c->latency_ns = ktime_get_ns() - ring->slots[slot].submit_ns;
+    c->start_ns = ring->slots[slot].start_ns;
+    c->done_ns = ring->slots[slot].done_ns;
+    c->cpu = ring->slots[slot].cpu;
+    c->ctx = ring->slots[slot].ctx;
+
+    if (++ring->cq_head == ring->size) {
+        ring->cq_head = 0;
+        ring->cq_expected ^= PCIE_SIM_CQE_PHASE;
+    }
+
+    /* Completions are in order, so everything up to this slot is free */
+    WRITE_ONCE(ring->sq_reaped, (slot + 1) % ring->size);
+    ring->reaped++;
+
+    spin_unlock_irqrestore(&ring->cq_lock, irq_flags);
+    return 0;
+}
+
+/*
+ * Pick the calling CPU's queue pair for a transfer direction
+ */
+struct pcie_sim_ring *pcie_sim_ring_for_cpu(struct pcie_sim_device *dev, u32 direction)
+{
+    u32 q = get_cpu() % dev->num_rings;
+
+    put_cpu();
+    return direction ? &dev->rx_rings[q] : &dev->tx_rings[q];
+}
+
+/*
+ * Completion interrupt: reap what the device has written back, wake the
+ * request behind each entry and account completions to the reaping CPU.
+ * Returns the number of completions reaped.
+ */
+u32 pcie_sim_ring_interrupt(struct pcie_sim_device *dev, struct pcie_sim_ring *ring)
+{
+    struct pcie_sim_completion c;
+    struct pcie_sim_request *request;
+    u32 reaped = 0;
+    int cpu;
+
+    while (pcie_sim_ring_reap(ring, &c) == 0) {
+        cpu = get_cpu();
+        this_cpu_inc(dev->cpu_stats->completions);
+        if (c.cpu != cpu)
+            this_cpu_inc(dev->cpu_stats->remote_completions);
+        put_cpu();
+
+        request = c.ctx;
+        if (request) {
+            request->status = c.status;
+            request->start_ns = c.start_ns;
+            request->done_ns = c.done_ns;
+            complete(&request->done);
+        }
+        reaped++;
+    }
+
+    return reaped;
+}
+
 /*
  * Initialize ring buffers for a device
  */
 int pcie_sim_ring_init(struct pcie_sim_device *dev)
 {
-    int ret;
+    u32 size = ring_size, count = num_rings;
 
     pr_debug("Initializing ring buffers for device %d\n", dev->device_id);
 
-    /* Initialize TX ring */
-    ret = init_ring(dev, &dev->tx_ring, "TX");
-    if (ret) {
-        pr_err("Failed to initialize TX ring: %d\n", ret);
-        return ret;
+    if (!count)
+        count = min_t(u32, num_online_cpus(), PCIE_SIM_MAX_QUEUES);
+
+    if (!ring_config_valid(size, count)) {
+        pr_warn("Invalid ring geometry %u x %u, using 256 x 1\n", size, count);
+        size = 256;
+        count = 1;
     }
 
-    /* Initialize RX ring */
-    ret = init_ring(dev, &dev->rx_ring, "RX");
-    if (ret) {
-        pr_err("Failed to initialize RX ring: %d\n", ret);
-        cleanup_ring(dev, &dev->tx_ring);
-        return ret;
+    atomic64_set(&dev->ring_memory, 0);
+    setup_rings(dev, size, count);
+
+    pr_debug("Ring buffers initialized for device %d: %u x %u descriptors per direction\n",
+           dev->device_id, count, size);
+    return 0;
+}
+
+/*
+ * True when no ring holds a descriptor that has not been reaped
+ */
+bool pcie_sim_ring_idle(struct pcie_sim_device *dev)
+{
+    u32 i;
+
+    for (i = 0; i < dev->num_rings; i++) {
+        if (pcie_sim_ring_count(&dev->tx_rings[i]) || pcie_sim_ring_count(&dev->rx_rings[i]))
+            return false;
+    }
+
+    return true;
+}
+
+/*
+ * Append the ring geometry and every allocated ring to a snapshot. The
+ * rings must be idle, so each one is fully described by one SQ index,
+ * one CQ index and its phase.
+ */
+void pcie_sim_ring_save(struct pcie_sim_device *dev, struct pcie_sim_snapshot_writer *w)
+{
+    struct pcie_sim_snapshot_ring_config *config;
+    struct pcie_sim_snapshot_ring *snap;
+    struct pcie_sim_ring *ring;
+    u32 q;
+    int dir;
+
+    config = pcie_sim_snapshot_add(w, PCIE_SIM_SNAP_RING_CONFIG, sizeof(*config));
+    if (config) {
+        config->ring_size = dev->ring_size;
+        config->num_rings = dev->num_rings;
+    }
+
+    for (q = 0; q < dev->num_rings; q++) {
+        for (dir = 0; dir < 2; dir++) {
+            ring = dir ? &dev->rx_rings[q] : &dev->tx_rings[q];
+            if (!ring->sq)
+                continue;
+
+            snap = pcie_sim_snapshot_add(w, PCIE_SIM_SNAP_RING,
+                                         sizeof(*snap) + ring_dma_size(ring));
+            if (!snap)
+                continue;
+
+            snap->queue = q;
+            snap->direction = dir;
+            snap->head = ring->head;
+            snap->cq_tail = ring->cq_tail;
+            snap->cq_phase = ring->cq_phase;
+            snap->submissions = atomic64_read(&ring->submissions);
+            snap->completions = atomic64_read(&ring->completions);
+            snap->overruns = atomic64_read(&ring->overruns);
+            snap->doorbells = atomic64_read(&ring->doorbells);
+            snap->fetches = atomic64_read(&ring->fetches);
+            snap->fetch_stalls = atomic64_read(&ring->fetch_stalls);
+            snap->writebacks = atomic64_read(&ring->writebacks);
+            snap->fetch_cost_ns = atomic64_read(&ring->fetch_cost_ns);
+            snap->writeback_cost_ns = atomic64_read(&ring->writeback_cost_ns);
+            snap->reaped = ring->reaped;
+
+            /* SQ and CQ are one allocation */
+            memcpy(snap + 1, ring->sq, ring_dma_size(ring));
+        }
+    }
+}
+
+/*
+ * Check a snapshot's ring sections against the geometry it sets up
+ */
+int pcie_sim_ring_check(struct pcie_sim_device *dev, const void *snapshot)
+{
+    const struct pcie_sim_snapshot_section *s = NULL;
+    struct pcie_sim_snapshot_ring_config config = {
+        .ring_size = dev->ring_size,
+        .num_rings = dev->num_rings,
+    };
+    const struct pcie_sim_snapshot_ring *snap;
+    size_t ring_bytes;
+
+    while ((s = pcie_sim_snapshot_next(snapshot, s)) != NULL) {
+        if (s->type == PCIE_SIM_SNAP_RING_CONFIG)
+            pcie_sim_snapshot_copy(&config, sizeof(config), s);
+    }
+
+    if (!ring_config_valid(config.ring_size, config.num_rings))
+        return -EINVAL;
+
+    ring_bytes = sizeof(*snap) + config.ring_size *
+                 (sizeof(struct pcie_sim_sq_desc) + sizeof(struct pcie_sim_cqe));
+
+    while ((s = pcie_sim_snapshot_next(snapshot, s)) != NULL) {
+        if (s->type != PCIE_SIM_SNAP_RING)
+            continue;
+
+        snap = (const struct pcie_sim_snapshot_ring *)(s + 1);
+        if (s->size != ring_bytes || snap->queue >= config.num_rings ||
+            snap->direction > 1 || snap->head >= config.ring_size ||
+            snap->cq_tail >= config.ring_size || snap->cq_phase > PCIE_SIM_CQE_PHASE)
+            return -EINVAL;
+    }
+
+    return 0;
+}
+
+/*
+ * Rebuild the rings from a snapshot passed by pcie_sim_ring_check().
+ * Without a geometry section the rings are left alone. Caller keeps
+ * transfers and engines out.
+ */
+int pcie_sim_ring_load(struct pcie_sim_device *dev, const void *snapshot)
+{
+    const struct pcie_sim_snapshot_section *s = NULL;
+    struct pcie_sim_snapshot_ring_config config;
+    const struct pcie_sim_snapshot_ring *snap;
+    struct pcie_sim_ring *ring;
+    bool found = false;
+    int ret;
+
+    while ((s = pcie_sim_snapshot_next(snapshot, s)) != NULL) {
+        if (s->type == PCIE_SIM_SNAP_RING_CONFIG) {
+            pcie_sim_snapshot_copy(&config, sizeof(config), s);
+            found = true;
+        }
     }
 
-    pr_info("Ring buffers initialized for device %d\n", dev->device_id);
+    if (!found)
+        return 0;
+
+    pcie_sim_ring_cleanup(dev);
+    setup_rings(dev, config.ring_size, config.num_rings);
+
+    while ((s = pcie_sim_snapshot_next(snapshot, s)) != NULL) {
+        if (s->type != PCIE_SIM_SNAP_RING)
+            continue;
+
+        snap = (const struct pcie_sim_snapshot_ring *)(s + 1);
+        ring = snap->direction ? &dev->rx_rings[snap->queue] : &dev->tx_rings[snap->queue];
+
+        ret = alloc_ring(dev, ring);
+        if (ret)
+            return ret;
+
+        memcpy(ring->sq, snap + 1, ring_dma_size(ring));
+
+        /* Idle: every producer index equals its consumer index */
+        ring->head = snap->head;
+        ring->sq_reaped = snap->head;
+        ring->tail = snap->head;
+        ring->doorbell_tail = snap->head;
+        ring->wb_head = snap->head;
+        ring->cq_head = snap->cq_tail;
+        ring->cq_tail = snap->cq_tail;
+        ring->cq_expected = snap->cq_phase;
+        ring->cq_phase = snap->cq_phase;
+        ring->reaped = snap->reaped;
+
+        atomic64_set(&ring->submissions, snap->submissions);
+        atomic64_set(&ring->completions, snap->completions);
+        atomic64_set(&ring->overruns, snap->overruns);
+        atomic64_set(&ring->doorbells, snap->doorbells);
+        atomic64_set(&ring->fetches, snap->fetches);
+        atomic64_set(&ring->fetch_stalls, snap->fetch_stalls);
+        atomic64_set(&ring->writebacks, snap->writebacks);
+        atomic64_set(&ring->fetch_cost_ns, snap->fetch_cost_ns);
+        atomic64_set(&ring->writeback_cost_ns, snap->writeback_cost_ns);
+    }
+
+    return 0;
+}
+
+/*
+ * Change ring size and count; only allowed while every ring is empty
+ */
+int pcie_sim_ring_configure(struct pcie_sim_device *dev, u32 size, u32 count)
+{
+    if (!count)
+        count = min_t(u32, num_online_cpus(), PCIE_SIM_MAX_QUEUES);
+
+    if (!ring_config_valid(size, count))
+        return -EINVAL;
+
+    if (!pcie_sim_ring_idle(dev))
+        return -EBUSY;
+
+    pcie_sim_ring_cleanup(dev);
+    setup_rings(dev, size, count);
+
+    pr_info("Device %d rings reconfigured: %u x %u descriptors per direction\n",
+           dev->device_id, count, size);
     return 0;
 }
 
@@ -224,13 +836,34 @@ int pcie_sim_ring_init(struct pcie_sim_device *dev)
  */
 void pcie_sim_ring_cleanup(struct pcie_sim_device *dev)
 {
+    u32 i;
+
     if (!dev)
         return;
 
     pr_debug("Cleaning up ring buffers for device %d\n", dev->device_id);
 
-    cleanup_ring(dev, &dev->rx_ring);
-    cleanup_ring(dev, &dev->tx_ring);
+    for (i = 0; i < dev->num_rings; i++) {
+        cleanup_ring(dev, &dev->rx_rings[i]);
+        cleanup_ring(dev, &dev->tx_rings[i]);
+    }
 
     pr_debug("Ring buffer cleanup complete for device %d\n", dev->device_id);
-}
\ No newline at end of file
+}
+
+/*
+ * Free every ring's descriptor memory and reset its indices, keeping the
+ * geometry and statistics. The rings must be idle; they are allocated
+ * again on the next post.
+ */
+void pcie_sim_ring_release(struct pcie_sim_device *dev)
+{
+    u32 i;
+
+    for (i = 0; i < dev->num_rings; i++) {
+        cleanup_ring(dev, &dev->rx_rings[i]);
+        reset_ring(&dev->rx_rings[i]);
+        cleanup_ring(dev, &dev->tx_rings[i]);
+        reset_ring(&dev->tx_rings[i]);
+    }
+}
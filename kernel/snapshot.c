@@ -0,0 +1,265 @@
+/*
+ * PCIe Simulator - Device Snapshots
+ *
+ * Copyright (c) 2025 Karan Mamaniya <kmamaniya@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * This module saves and restores the simulated device state in the
+ * format of lib/snapshot.h, so long experiments can resume from a
+ * warmed-up device.
+ */
+
+#include "common.h"
+#include <linux/mm.h>
+
+/*
+ * Stop transfers and engines so the device holds still. Transfers drain
+ * before the write lock is granted, so the rings are idle unless a
+ * descriptor was posted outside a transfer.
+ */
+static void snapshot_quiesce(struct pcie_sim_device *dev)
+{
+    percpu_down_write(&dev->ring_sem);
+    pcie_sim_engine_park(dev);
+}
+
+static void snapshot_resume(struct pcie_sim_device *dev)
+{
+    pcie_sim_engine_unpark(dev);
+    percpu_up_write(&dev->ring_sem);
+}
+
+/*
+ * Serialize the device. Sizes only when the writer has no buffer.
+ */
+static void snapshot_write(struct pcie_sim_device *dev, struct pcie_sim_snapshot_writer *w)
+{
+    struct pcie_sim_transfer_stats *xfer;
+    struct pcie_sim_latency_sq *sq;
+    struct pcie_sim_snapshot_error *err;
+    struct pcie_sim_snapshot_rng *rng;
+    struct pcie_sim_stats *stats;
+
+    /* The summary for older readers, then the full counters */
+    stats = pcie_sim_snapshot_add(w, PCIE_SIM_SNAP_STATS, sizeof(*stats));
+    if (stats)
+        pcie_sim_stats_read(dev, stats);
+    xfer = pcie_sim_snapshot_add(w, PCIE_SIM_SNAP_TRANSFER_STATS, sizeof(*xfer));
+    sq = pcie_sim_snapshot_add(w, PCIE_SIM_SNAP_LATENCY_SQ, sizeof(*sq));
+    if (xfer || sq)
+        pcie_sim_stats_save(dev, xfer, sq);
+
+    err = pcie_sim_snapshot_add(w, PCIE_SIM_SNAP_ERROR, sizeof(*err));
+    if (err) {
+        err->scenario = dev->error_scenario;
+        err->probability = dev->error_probability;
+        err->recovery_time_ms = dev->error_recovery_time_ms;
+        err->simulate_errors = dev->simulate_errors;
+        err->fault_injection_rate = dev->fault_injection_rate;
+    }
+
+    rng = pcie_sim_snapshot_add(w, PCIE_SIM_SNAP_RNG, sizeof(*rng));
+    if (rng) {
+        spin_lock(&dev->rng_lock);
+        rng->state[0] = dev->rng.s1;
+        rng->state[1] = dev->rng.s2;
+        rng->state[2] = dev->rng.s3;
+        rng->state[3] = dev->rng.s4;
+        spin_unlock(&dev->rng_lock);
+    }
+
+    pcie_sim_mmio_save(dev, w);
+    pcie_sim_ring_save(dev, w);
+}
+
+/*
+ * Apply the statistics, error injection and RNG sections of a snapshot
+ */
+static void snapshot_apply(struct pcie_sim_device *dev, const void *snapshot)
+{
+    const struct pcie_sim_snapshot_section *s = NULL;
+    struct pcie_sim_transfer_stats xfer;
+    struct pcie_sim_latency_sq sq;
+    struct pcie_sim_snapshot_error err;
+    struct pcie_sim_stats stats;
+    struct pcie_sim_snapshot_rng rng;
+
+    while ((s = pcie_sim_snapshot_next(snapshot, s)) != NULL) {
+        switch (s->type) {
+        case PCIE_SIM_SNAP_STATS:
+            pcie_sim_snapshot_copy(&stats, sizeof(stats), s);
+            pcie_sim_stats_from_summary(&xfer, &sq, &stats);
+            pcie_sim_stats_restore(dev, &xfer, &sq);
+            break;
+
+        /* Follows the summary and replaces it */
+        case PCIE_SIM_SNAP_TRANSFER_STATS:
+            pcie_sim_snapshot_copy(&xfer, sizeof(xfer), s);
+            pcie_sim_stats_restore(dev, &xfer, NULL);
+            break;
+
+        /* Follows the full counters and replaces the rebuilt squares */
+        case PCIE_SIM_SNAP_LATENCY_SQ:
+            pcie_sim_snapshot_copy(&sq, sizeof(sq), s);
+            pcie_sim_stats_restore(dev, NULL, &sq);
+            break;
+
+        case PCIE_SIM_SNAP_ERROR:
+            pcie_sim_snapshot_copy(&err, sizeof(err), s);
+            dev->error_scenario = err.scenario;
+            dev->error_probability = err.probability;
+            dev->error_recovery_time_ms = err.recovery_time_ms;
+            dev->simulate_errors = err.simulate_errors && err.fault_injection_rate;
+            dev->fault_injection_rate = err.fault_injection_rate;
+            break;
+
+        case PCIE_SIM_SNAP_RNG:
+            pcie_sim_snapshot_copy(&rng, sizeof(rng), s);
+            spin_lock(&dev->rng_lock);
+            /* The generator needs minimum seeds; derive valid ones from bad state */
+            if (rng.state[0] < 2 || rng.state[1] < 8 || rng.state[2] < 16 ||
+                rng.state[3] < 128) {
+                prandom_seed_state(&dev->rng, ((u64)rng.state[0] << 32) | rng.state[1]);
+            } else {
+                dev->rng.s1 = rng.state[0];
+                dev->rng.s2 = rng.state[1];
+                dev->rng.s3 = rng.state[2];
+                dev->rng.s4 = rng.state[3];
+            }
+            spin_unlock(&dev->rng_lock);
+            break;
+        }
+    }
+}
+
+/*
+ * PCIE_SIM_IOC_SAVE_SNAPSHOT: copy a snapshot to the user buffer. If it
+ * is too small, the size needed is returned in used with -ENOSPC.
+ */
+int pcie_sim_snapshot_save(struct pcie_sim_device *dev, struct pcie_sim_snapshot_buf __user *arg)
+{
+    struct pcie_sim_snapshot_writer w;
+    struct pcie_sim_snapshot_buf req;
+    void *buf = NULL;
+    size_t size;
+    int ret = 0;
+
+    if (copy_from_user(&req, arg, sizeof(req)))
+        return -EFAULT;
+
+    snapshot_quiesce(dev);
+
+    if (!pcie_sim_ring_idle(dev)) {
+        ret = -EBUSY;
+        goto out;
+    }
+
+    /* Size first, then fill */
+    pcie_sim_snapshot_begin(&w, NULL, 0);
+    snapshot_write(dev, &w);
+    size = pcie_sim_snapshot_end(&w);
+
+    req.used = size;
+    if (req.size < size) {
+        ret = -ENOSPC;
+        goto out;
+    }
+
+    buf = kvmalloc(size, GFP_KERNEL);
+    if (!buf) {
+        ret = -ENOMEM;
+        goto out;
+    }
+
+    pcie_sim_snapshot_begin(&w, buf, size);
+    snapshot_write(dev, &w);
+    pcie_sim_snapshot_end(&w);
+
+out:
+    snapshot_resume(dev);
+
+    if (!ret && copy_to_user(u64_to_user_ptr(req.data), buf, size))
+        ret = -EFAULT;
+    kvfree(buf);
+
+    if ((!ret || ret == -ENOSPC) && copy_to_user(arg, &req, sizeof(req)))
+        ret = -EFAULT;
+
+    pr_debug("Device %d snapshot saved: %u bytes (%d)\n", dev->device_id, req.used, ret);
+    return ret;
+}
+
+/*
+ * PCIE_SIM_IOC_LOAD_SNAPSHOT: restore the device from a user buffer.
+ * The snapshot is validated in full before any state changes.
+ */
+int pcie_sim_snapshot_load(struct pcie_sim_device *dev, struct pcie_sim_snapshot_buf __user *arg)
+{
+    struct pcie_sim_snapshot_buf req;
+    void *buf;
+    int ret;
+
+    if (copy_from_user(&req, arg, sizeof(req)))
+        return -EFAULT;
+
+    if (req.size < sizeof(struct pcie_sim_snapshot_header) ||
+        req.size > PCIE_SIM_SNAPSHOT_MAX_SIZE)
+        return -EINVAL;
+
+    buf = kvmalloc(req.size, GFP_KERNEL);
+    if (!buf)
+        return -ENOMEM;
+
+    if (copy_from_user(buf, u64_to_user_ptr(req.data), req.size)) {
+        ret = -EFAULT;
+        goto out_free;
+    }
+
+    if (pcie_sim_snapshot_check(buf, req.size)) {
+        ret = -EINVAL;
+        goto out_free;
+    }
+
+    snapshot_quiesce(dev);
+
+    if (!pcie_sim_ring_idle(dev)) {
+        ret = -EBUSY;
+        goto out;
+    }
+
+    ret = pcie_sim_ring_check(dev, buf);
+    if (ret)
+        goto out;
+
+    ret = pcie_sim_ring_load(dev, buf);
+    if (ret)
+        goto out;
+
+    pcie_sim_mmio_load(dev, buf);
+    snapshot_apply(dev, buf);
+
+    pr_info("Device %d restored from a %u byte snapshot\n", dev->device_id, req.size);
+
+out:
+    snapshot_resume(dev);
+out_free:
+    kvfree(buf);
+    return ret;
+}
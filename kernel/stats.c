@@ -0,0 +1,261 @@
+/*
+ * PCIe Simulator - Transfer Statistics
+ *
+ * Copyright (c) 2025 Karan Mamaniya <kmamaniya@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Transfer counters behind PCIE_SIM_IOC_GET_STATS, PCIE_SIM_IOC_GET_STATS_EX,
+ * the mmap()able counter page and /proc, in the layout of lib/stats.h.
+ */
+
+#include <linux/mm.h>
+#include "common.h"
+
+/*
+ * Transfers on every CPU update one set of counters, so a reader always
+ * sees a consistent set: the latency sum matches the transfer count and
+ * the histograms add up to it. The current epoch's counters live in the
+ * page that userspace maps; stats_lock serializes writers and the page's
+ * sequence count lets mapped readers skip the lock.
+ */
+int pcie_sim_stats_init(struct pcie_sim_device *dev)
+{
+    BUILD_BUG_ON(sizeof(struct pcie_sim_stats_page) > PCIE_SIM_STATS_PAGE_SIZE);
+
+    dev->stats_page = (struct pcie_sim_stats_page *)get_zeroed_page(GFP_KERNEL);
+    if (!dev->stats_page)
+        return -ENOMEM;
+
+    spin_lock_init(&dev->stats_lock);
+    pcie_sim_stats_page_init(dev->stats_page);
+    memset(&dev->stats_prev, 0, sizeof(dev->stats_prev));
+    memset(&dev->stats_prev_sq, 0, sizeof(dev->stats_prev_sq));
+    memset(dev->stats_phases, 0, sizeof(dev->stats_phases));
+    return 0;
+}
+
+void pcie_sim_stats_cleanup(struct pcie_sim_device *dev)
+{
+    free_page((unsigned long)dev->stats_page);
+    dev->stats_page = NULL;
+}
+
+/*
+ * Count a completed transfer
+ */
+void pcie_sim_stats_transfer(struct pcie_sim_device *dev, u32 direction, u64 bytes,
+                             u64 latency_ns, const u64 *phase_ns)
+{
+    struct pcie_sim_stats_page *page = dev->stats_page;
+
+    spin_lock(&dev->stats_lock);
+    pcie_sim_stats_page_begin(page);
+    pcie_sim_stats_page_account(page, direction, bytes, latency_ns);
+    pcie_sim_stats_page_end(page);
+    pcie_sim_stats_phases(dev->stats_phases, phase_ns);
+    spin_unlock(&dev->stats_lock);
+}
+
+/*
+ * Count a failed transfer of a PCIE_SIM_STATS_ERR_* type
+ */
+void pcie_sim_stats_fail(struct pcie_sim_device *dev, u32 direction, unsigned int type)
+{
+    struct pcie_sim_stats_page *page = dev->stats_page;
+
+    spin_lock(&dev->stats_lock);
+    pcie_sim_stats_page_begin(page);
+    pcie_sim_stats_error(&page->xfer, direction, type);
+    pcie_sim_stats_page_end(page);
+    spin_unlock(&dev->stats_lock);
+}
+
+/*
+ * Summary statistics, as returned by PCIE_SIM_IOC_GET_STATS
+ */
+void pcie_sim_stats_read(struct pcie_sim_device *dev, struct pcie_sim_stats *out)
+{
+    spin_lock(&dev->stats_lock);
+    pcie_sim_stats_summary(&dev->stats_page->xfer, &dev->stats_page->latency_sq, out);
+    spin_unlock(&dev->stats_lock);
+}
+
+/*
+ * Phase times of the current epoch
+ */
+void pcie_sim_stats_read_phases(struct pcie_sim_device *dev, struct pcie_sim_phase_stats *out)
+{
+    spin_lock(&dev->stats_lock);
+    memcpy(out, dev->stats_phases, sizeof(dev->stats_phases));
+    spin_unlock(&dev->stats_lock);
+}
+
+/*
+ * Copy out or replace the transfer counters, for snapshots. A NULL sq
+ * keeps the squared latencies.
+ */
+void pcie_sim_stats_save(struct pcie_sim_device *dev, struct pcie_sim_transfer_stats *out,
+                         struct pcie_sim_latency_sq *sq)
+{
+    spin_lock(&dev->stats_lock);
+    if (out)
+        *out = dev->stats_page->xfer;
+    if (sq)
+        *sq = dev->stats_page->latency_sq;
+    spin_unlock(&dev->stats_lock);
+}
+
+void pcie_sim_stats_restore(struct pcie_sim_device *dev, const struct pcie_sim_transfer_stats *in,
+                            const struct pcie_sim_latency_sq *sq)
+{
+    struct pcie_sim_stats_page *page = dev->stats_page;
+
+    spin_lock(&dev->stats_lock);
+    pcie_sim_stats_page_begin(page);
+    if (in)
+        page->xfer = *in;
+    if (sq)
+        page->latency_sq = *sq;
+    pcie_sim_stats_page_end(page);
+    spin_unlock(&dev->stats_lock);
+}
+
+/*
+ * Start a new epoch. Transfers completing on other CPUs land either in
+ * the retired counters or in the new ones, never in both or neither.
+ * Returns the new epoch.
+ */
+u64 pcie_sim_stats_reset(struct pcie_sim_device *dev)
+{
+    struct pcie_sim_stats_page *page = dev->stats_page;
+    u64 epoch;
+
+    spin_lock(&dev->stats_lock);
+    pcie_sim_stats_page_begin(page);
+    pcie_sim_stats_new_epoch(page, &dev->stats_prev, &dev->stats_prev_sq);
+    pcie_sim_stats_page_end(page);
+    memset(dev->stats_phases, 0, sizeof(dev->stats_phases));
+    epoch = page->epoch;
+    spin_unlock(&dev->stats_lock);
+
+    return epoch;
+}
+
+/*
+ * Fill the complete extended statistics, with xfer covering the epochs
+ * from since on. Queue counters come from the rings and are sampled
+ * without stopping them.
+ */
+static int stats_read_ex(struct pcie_sim_device *dev, u64 since, struct pcie_sim_stats_ex *ex)
+{
+    u32 q;
+    int dir, ret;
+
+    memset(ex, 0, sizeof(*ex));
+    ex->hdr.size = sizeof(*ex);
+    ex->hdr.version = PCIE_SIM_STATS_VERSION;
+
+    spin_lock(&dev->stats_lock);
+    ret = pcie_sim_stats_since(dev->stats_page, &dev->stats_prev, &dev->stats_prev_sq,
+                               since, &ex->xfer, &ex->latency_sq);
+    ex->epoch = dev->stats_page->epoch;
+    ex->prev = dev->stats_prev;
+    ex->prev_latency_sq = dev->stats_prev_sq;
+    memcpy(ex->phases, dev->stats_phases, sizeof(ex->phases));
+    spin_unlock(&dev->stats_lock);
+
+    if (ret)
+        return since > ex->epoch ? -EINVAL : -ESTALE;
+    ex->since_epoch = since ? since : ex->epoch;
+
+    ex->num_queues = min_t(u32, dev->num_rings, PCIE_SIM_STATS_QUEUES);
+    for (q = 0; q < ex->num_queues; q++) {
+        for (dir = 0; dir < 2; dir++) {
+            struct pcie_sim_ring *ring = dir ? &dev->rx_rings[q] : &dev->tx_rings[q];
+            struct pcie_sim_queue_stats *qs = dir ? &ex->rx[q] : &ex->tx[q];
+
+            qs->submissions = atomic64_read(&ring->submissions);
+            qs->completions = atomic64_read(&ring->completions);
+            qs->overruns = atomic64_read(&ring->overruns);
+            qs->doorbells = atomic64_read(&ring->doorbells);
+            qs->depth = pcie_sim_ring_count(ring);
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * PCIE_SIM_IOC_GET_STATS_EX: copy as much of the extended statistics as
+ * the caller's hdr.size asks for and report the size copied. A caller
+ * whose structure has since_epoch gets xfer from that epoch on; -ESTALE
+ * means that epoch is no longer retained.
+ */
+int pcie_sim_stats_get_ex(struct pcie_sim_device *dev, struct pcie_sim_stats_header __user *arg)
+{
+    struct pcie_sim_stats_ex __user *uex = (struct pcie_sim_stats_ex __user *)arg;
+    struct pcie_sim_stats_ex *ex;
+    u32 requested, size;
+    u64 since = 0;
+    int ret;
+
+    if (get_user(requested, &arg->size))
+        return -EFAULT;
+
+    size = pcie_sim_stats_ex_size(requested);
+    if (!size)
+        return -EINVAL;
+
+    if (size >= offsetofend(struct pcie_sim_stats_ex, since_epoch) &&
+        get_user(since, &uex->since_epoch))
+        return -EFAULT;
+
+    ex = kmalloc(sizeof(*ex), GFP_KERNEL);
+    if (!ex)
+        return -ENOMEM;
+
+    ret = stats_read_ex(dev, since, ex);
+    if (ret)
+        goto out;
+
+    ex->hdr.size = size;
+    if (copy_to_user(arg, ex, size))
+        ret = -EFAULT;
+out:
+    kfree(ex);
+    return ret;
+}
+
+/*
+ * Map the counter page read-only at offset 0 of the device node
+ */
+int pcie_sim_stats_mmap(struct pcie_sim_device *dev, struct vm_area_struct *vma)
+{
+    unsigned long size = vma->vm_end - vma->vm_start;
+
+    if (vma->vm_pgoff != 0 || size > PAGE_SIZE)
+        return -EINVAL;
+    if (vma->vm_flags & VM_WRITE)
+        return -EPERM;
+
+    vma->vm_flags &= ~VM_MAYWRITE;
+    return remap_pfn_range(vma, vma->vm_start, virt_to_phys(dev->stats_page) >> PAGE_SHIFT,
+                           size, vma->vm_page_prot);
+}
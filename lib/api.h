@@ -63,6 +63,24 @@ pcie_sim_error_t pcie_sim_transfer(pcie_sim_handle_t handle,
                                  uint32_t direction,
                                  uint64_t *latency_ns);
 
+/**
+ * Transfer data and report where the time went
+ * @param handle Device handle
+ * @param buffer Data buffer
+ * @param size Transfer size in bytes
+ * @param direction Transfer direction (PCIE_SIM_TO_DEVICE or PCIE_SIM_FROM_DEVICE)
+ * @param latency_ns Pointer to store transfer latency (optional)
+ * @param phase_ns Array of PCIE_SIM_PHASES to store the time spent in each
+ *        PCIE_SIM_PHASE_*; phases the backend does not have read 0
+ * @return Error code
+ */
+pcie_sim_error_t pcie_sim_transfer_ex(pcie_sim_handle_t handle,
+                                    void *buffer,
+                                    size_t size,
+                                    uint32_t direction,
+                                    uint64_t *latency_ns,
+                                    uint64_t *phase_ns);
+
 /**
  * Get device statistics
  * @param handle Device handle
@@ -72,6 +90,32 @@ pcie_sim_error_t pcie_sim_transfer(pcie_sim_handle_t handle,
 pcie_sim_error_t pcie_sim_get_stats(pcie_sim_handle_t handle,
                                    struct pcie_sim_stats *stats);
 
+/**
+ * Get extended statistics: per-direction counters, errors by type,
+ * latency and size histograms and, where the backend has rings, per-queue
+ * counters. Set stats->hdr.size to sizeof(*stats) and zero the structure
+ * first; on return hdr.size holds the bytes the backend filled. Set
+ * stats->since_epoch to an epoch from pcie_sim_reset_stats_epoch() to
+ * count from its start even if one more reset happened since.
+ * @param handle Device handle
+ * @param stats Pointer to extended statistics structure
+ * @return Error code; PCIE_SIM_ERROR_PARAM if hdr.size is too small or
+ *         since_epoch is no longer retained
+ */
+pcie_sim_error_t pcie_sim_get_stats_ex(pcie_sim_handle_t handle,
+                                      struct pcie_sim_stats_ex *stats);
+
+/**
+ * Map the device's counter page for sampling without calls into the
+ * backend or its locks. Read it with pcie_sim_stats_page_read(). The page
+ * stays valid until the handle is closed.
+ * @param handle Device handle
+ * @param page Pointer to store the read-only page address
+ * @return Error code; PCIE_SIM_ERROR_DEVICE for devices served by pcie_simd
+ */
+pcie_sim_error_t pcie_sim_stats_map(pcie_sim_handle_t handle,
+                                   const struct pcie_sim_stats_page **page);
+
 /**
  * Reset device statistics
  * @param handle Device handle
@@ -79,6 +123,129 @@ pcie_sim_error_t pcie_sim_get_stats(pcie_sim_handle_t handle,
  */
 pcie_sim_error_t pcie_sim_reset_stats(pcie_sim_handle_t handle);
 
+/**
+ * Reset device statistics by starting a new epoch. The counters of the
+ * epoch that ends are kept as the previous epoch's final values.
+ * @param handle Device handle
+ * @param epoch Pointer to store the epoch just started
+ * @return Error code
+ */
+pcie_sim_error_t pcie_sim_reset_stats_epoch(pcie_sim_handle_t handle, uint64_t *epoch);
+
+/**
+ * Read a 32-bit BAR0 register (offsets and bits in regs.h)
+ * @param handle Device handle
+ * @param offset Register offset, 32-bit aligned
+ * @param value Pointer to store the register value
+ * @return Error code
+ */
+pcie_sim_error_t pcie_sim_mmio_read32(pcie_sim_handle_t handle, uint32_t offset,
+                                     uint32_t *value);
+
+/**
+ * Write a 32-bit BAR0 register, with the same side effects as the kernel
+ * model. Writing CONTROL_DMA_START runs the DMA programmed into the DMA
+ * registers; the DMA address is a pointer in the calling process.
+ * @param handle Device handle
+ * @param offset Register offset, 32-bit aligned
+ * @param value Value to write
+ * @return Error code
+ */
+pcie_sim_error_t pcie_sim_mmio_write32(pcie_sim_handle_t handle, uint32_t offset,
+                                      uint32_t value);
+
+/**
+ * Drain the write-combining buffer (the model's sfence)
+ * @param handle Device handle
+ * @return Error code
+ */
+pcie_sim_error_t pcie_sim_mmio_flush(pcie_sim_handle_t handle);
+
+/**
+ * Set the MMIO cost model (read round trip, posted write, WC flush)
+ * @param handle Device handle
+ * @param config Costs in nanoseconds and PCIE_SIM_MMIO_* flags
+ * @return Error code
+ */
+pcie_sim_error_t pcie_sim_mmio_configure(pcie_sim_handle_t handle,
+                                        const struct pcie_sim_mmio_config *config);
+
+/**
+ * Get MMIO access counters and accumulated modeled cost
+ * @param handle Device handle
+ * @param stats Pointer to MMIO statistics structure
+ * @return Error code
+ */
+pcie_sim_error_t pcie_sim_mmio_get_stats(pcie_sim_handle_t handle,
+                                        struct pcie_sim_mmio_stats *stats);
+
+/**
+ * Reset MMIO counters and discard the access trace
+ * @param handle Device handle
+ * @return Error code
+ */
+pcie_sim_error_t pcie_sim_mmio_reset_stats(pcie_sim_handle_t handle);
+
+/**
+ * Drain recorded register accesses (requires PCIE_SIM_MMIO_TRACE)
+ * @param handle Device handle
+ * @param entries Buffer for trace entries, oldest first
+ * @param max_entries Capacity of entries
+ * @param count Pointer to store the number of entries returned
+ * @return Error code
+ */
+pcie_sim_error_t pcie_sim_mmio_read_trace(pcie_sim_handle_t handle,
+                                         struct pcie_sim_mmio_trace_entry *entries,
+                                         size_t max_entries, size_t *count);
+
+/**
+ * Serialize device state (registers, statistics, fault injection and MMIO
+ * model) into a buffer in the format of snapshot.h
+ * @param handle Device handle
+ * @param buffer Destination, or NULL to only query the size
+ * @param size Capacity of buffer
+ * @param used Pointer to store the snapshot size
+ * @return Error code; PCIE_SIM_ERROR_MEMORY if buffer is too small
+ */
+pcie_sim_error_t pcie_sim_snapshot(pcie_sim_handle_t handle, void *buffer,
+                                  size_t size, size_t *used);
+
+/**
+ * Restore device state from a snapshot buffer. Sections the backend does
+ * not model are ignored, so kernel snapshots load into the simulators.
+ * @param handle Device handle
+ * @param buffer Snapshot
+ * @param size Snapshot size
+ * @return Error code; PCIE_SIM_ERROR_PARAM if the snapshot is malformed
+ */
+pcie_sim_error_t pcie_sim_restore(pcie_sim_handle_t handle, const void *buffer,
+                                 size_t size);
+
+/**
+ * Save a device snapshot to a file
+ * @param handle Device handle
+ * @param path File to create or replace
+ * @return Error code
+ */
+pcie_sim_error_t pcie_sim_snapshot_save(pcie_sim_handle_t handle, const char *path);
+
+/**
+ * Restore a device from a snapshot file
+ * @param handle Device handle
+ * @param path File written by pcie_sim_snapshot_save() or the kernel ioctl
+ * @return Error code
+ */
+pcie_sim_error_t pcie_sim_snapshot_load(pcie_sim_handle_t handle, const char *path);
+
+/**
+ * Report the memory a device holds, by subsystem
+ * @param handle Device handle
+ * @param stats Pointer to memory statistics structure
+ * @return Error code
+ */
+pcie_sim_error_t pcie_sim_get_memory_stats(pcie_sim_handle_t handle,
+                                          struct pcie_sim_memory_stats *stats);
+
 /**
  * Convert error code to string
  * @param error Error code
@@ -0,0 +1,119 @@
+/*
+ * PCIe Simulator Library - Backend Entry Points
+ *
+ * Copyright (c) 2025 Karan Mamaniya <kmamaniya@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Platform backend functions that the public API in core.c dispatches to.
+ * C++ callers that select a backend at compile time (see BasicDevice in
+ * device.hpp) call these directly and skip the dispatch layer.
+ */
+
+#ifndef PCIE_SIM_BACKEND_H
+#define PCIE_SIM_BACKEND_H
+
+#include "types.h"
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef _WIN32
+/* Windows simulation backend (sim/windows_sim.c) */
+pcie_sim_error_t pcie_sim_open_impl(int device_id, pcie_sim_handle_t *handle);
+pcie_sim_error_t pcie_sim_close_impl(pcie_sim_handle_t handle);
+pcie_sim_error_t pcie_sim_transfer_impl(pcie_sim_handle_t handle, void *buffer,
+                                       size_t size, uint32_t direction,
+                                       uint64_t *latency_ns);
+pcie_sim_error_t pcie_sim_transfer_ex_impl(pcie_sim_handle_t handle, void *buffer,
+                                          size_t size, uint32_t direction,
+                                          uint64_t *latency_ns, uint64_t *phase_ns);
+pcie_sim_error_t pcie_sim_get_stats_impl(pcie_sim_handle_t handle,
+                                         struct pcie_sim_stats *stats);
+pcie_sim_error_t pcie_sim_get_stats_ex_impl(pcie_sim_handle_t handle,
+                                            struct pcie_sim_stats_ex *stats);
+pcie_sim_error_t pcie_sim_stats_map_impl(pcie_sim_handle_t handle,
+                                         const struct pcie_sim_stats_page **page);
+pcie_sim_error_t pcie_sim_reset_stats_impl(pcie_sim_handle_t handle);
+pcie_sim_error_t pcie_sim_reset_stats_epoch_impl(pcie_sim_handle_t handle, uint64_t *epoch);
+pcie_sim_error_t pcie_sim_mmio_read32_impl(pcie_sim_handle_t handle, uint32_t offset,
+                                           uint32_t *value);
+pcie_sim_error_t pcie_sim_mmio_write32_impl(pcie_sim_handle_t handle, uint32_t offset,
+                                            uint32_t value);
+pcie_sim_error_t pcie_sim_mmio_flush_impl(pcie_sim_handle_t handle);
+pcie_sim_error_t pcie_sim_mmio_configure_impl(pcie_sim_handle_t handle,
+                                              const struct pcie_sim_mmio_config *config);
+pcie_sim_error_t pcie_sim_mmio_get_stats_impl(pcie_sim_handle_t handle,
+                                              struct pcie_sim_mmio_stats *stats);
+pcie_sim_error_t pcie_sim_mmio_reset_stats_impl(pcie_sim_handle_t handle);
+pcie_sim_error_t pcie_sim_mmio_read_trace_impl(pcie_sim_handle_t handle,
+                                               struct pcie_sim_mmio_trace_entry *entries,
+                                               size_t max_entries, size_t *count);
+pcie_sim_error_t pcie_sim_snapshot_impl(pcie_sim_handle_t handle, void *buffer,
+                                        size_t size, size_t *used);
+pcie_sim_error_t pcie_sim_restore_impl(pcie_sim_handle_t handle, const void *buffer,
+                                       size_t size);
+pcie_sim_error_t pcie_sim_get_memory_stats_impl(pcie_sim_handle_t handle,
+                                                struct pcie_sim_memory_stats *stats);
+#else
+/* Linux simulation backend (sim/linux_sim.c) */
+pcie_sim_error_t pcie_sim_open_linux(int device_id, pcie_sim_handle_t *handle);
+pcie_sim_error_t pcie_sim_close_linux(pcie_sim_handle_t handle);
+pcie_sim_error_t pcie_sim_transfer_linux(pcie_sim_handle_t handle, void *buffer,
+                                        size_t size, uint32_t direction,
+                                        uint64_t *latency_ns);
+pcie_sim_error_t pcie_sim_transfer_ex_linux(pcie_sim_handle_t handle, void *buffer,
+                                           size_t size, uint32_t direction,
+                                           uint64_t *latency_ns, uint64_t *phase_ns);
+pcie_sim_error_t pcie_sim_get_stats_linux(pcie_sim_handle_t handle,
+                                          struct pcie_sim_stats *stats);
+pcie_sim_error_t pcie_sim_get_stats_ex_linux(pcie_sim_handle_t handle,
+                                             struct pcie_sim_stats_ex *stats);
+pcie_sim_error_t pcie_sim_stats_map_linux(pcie_sim_handle_t handle,
+                                          const struct pcie_sim_stats_page **page);
+pcie_sim_error_t pcie_sim_reset_stats_linux(pcie_sim_handle_t handle);
+pcie_sim_error_t pcie_sim_reset_stats_epoch_linux(pcie_sim_handle_t handle, uint64_t *epoch);
+pcie_sim_error_t pcie_sim_mmio_read32_linux(pcie_sim_handle_t handle, uint32_t offset,
+                                            uint32_t *value);
+pcie_sim_error_t pcie_sim_mmio_write32_linux(pcie_sim_handle_t handle, uint32_t offset,
+                                             uint32_t value);
+pcie_sim_error_t pcie_sim_mmio_flush_linux(pcie_sim_handle_t handle);
+pcie_sim_error_t pcie_sim_mmio_configure_linux(pcie_sim_handle_t handle,
+                                               const struct pcie_sim_mmio_config *config);
+pcie_sim_error_t pcie_sim_mmio_get_stats_linux(pcie_sim_handle_t handle,
+                                               struct pcie_sim_mmio_stats *stats);
+pcie_sim_error_t pcie_sim_mmio_reset_stats_linux(pcie_sim_handle_t handle);
+pcie_sim_error_t pcie_sim_mmio_read_trace_linux(pcie_sim_handle_t handle,
+                                                struct pcie_sim_mmio_trace_entry *entries,
+                                                size_t max_entries, size_t *count);
+pcie_sim_error_t pcie_sim_snapshot_linux(pcie_sim_handle_t handle, void *buffer,
+                                         size_t size, size_t *used);
+pcie_sim_error_t pcie_sim_restore_linux(pcie_sim_handle_t handle, const void *buffer,
+                                        size_t size);
+pcie_sim_error_t pcie_sim_get_memory_stats_linux(pcie_sim_handle_t handle,
+                                                 struct pcie_sim_memory_stats *stats);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PCIE_SIM_BACKEND_H */
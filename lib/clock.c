@@ -0,0 +1,434 @@
+/*
+ * PCIe Simulator Library - Timestamps and Delays
+ *
+ * Copyright (c) 2025 Karan Mamaniya <kmamaniya@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Calibrated TSC timestamps with a monotonic clock fallback, and the
+ * sleep-then-spin delay built on them.
+ */
+
+#include "clock.h"
+#include "stats.h"
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <time.h>
+#include <errno.h>
+#endif
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define PCIE_SIM_CLOCK_HAVE_TSC 1
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#include <x86intrin.h>
+#endif
+#endif
+
+/* ns = ticks * mult >> CLOCK_SHIFT. The low half of the split multiply
+ * stays in 64 bits while mult is below 2^40, i.e. for tick rates above
+ * about 15.3 kHz. The OS clocks used run at MHz rates or more, and a TSC
+ * below CLOCK_TSC_MIN_HZ is not used. */
+#define CLOCK_SHIFT 24
+#define CLOCK_MASK ((1ULL << CLOCK_SHIFT) - 1)
+
+/* Calibration window, and the slowest TSC worth using */
+#define CLOCK_CALIBRATE_NS 2000000ULL
+#define CLOCK_TSC_MIN_HZ 100000000ULL
+#define CLOCK_PAIR_TRIES 8
+
+static struct {
+    uint64_t mult;
+    uint64_t inv_mult;              /* ns to ticks, same scale */
+    uint64_t hz;
+    uint64_t base_ticks;            /* Taken together with base_ns */
+    uint64_t base_ns;
+} g_clock;
+
+/* pcie_sim_clock_source_t once calibrated, -1 before */
+static int g_clock_source = -1;
+
+#ifdef _WIN32
+static INIT_ONCE g_clock_once = INIT_ONCE_STATIC_INIT;
+static LARGE_INTEGER g_qpc_frequency;
+#else
+static pthread_once_t g_clock_once = PTHREAD_ONCE_INIT;
+#endif
+
+/*
+ * Ticks of the OS monotonic clock: nanoseconds on Linux, performance
+ * counter ticks on Windows
+ */
+static uint64_t clock_os_ticks(void)
+{
+#ifdef _WIN32
+    LARGE_INTEGER counter;
+
+    if (!g_qpc_frequency.QuadPart)
+        return GetTickCount64() * 1000000ULL;
+    QueryPerformanceCounter(&counter);
+    return (uint64_t)counter.QuadPart;
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+static uint64_t clock_os_hz(void)
+{
+#ifdef _WIN32
+    return g_qpc_frequency.QuadPart ? (uint64_t)g_qpc_frequency.QuadPart : 1000000000ULL;
+#else
+    return 1000000000ULL;
+#endif
+}
+
+/* Split so neither product overflows for any interval */
+static uint64_t clock_scale(uint64_t ticks, uint64_t mult)
+{
+    return (ticks >> CLOCK_SHIFT) * mult + (((ticks & CLOCK_MASK) * mult) >> CLOCK_SHIFT);
+}
+
+/* mult for a counter running at hz */
+static uint64_t clock_mult(uint64_t hz)
+{
+    return ((1000000000ULL << CLOCK_SHIFT) + hz / 2) / hz;
+}
+
+#ifdef PCIE_SIM_CLOCK_HAVE_TSC
+/*
+ * CPUID 0x80000007 EDX bit 8: the TSC rate does not depend on P-, C- or
+ * T-states
+ */
+static int clock_tsc_invariant(void)
+{
+#ifdef _MSC_VER
+    int regs[4];
+
+    __cpuid(regs, 0x80000000);
+    if ((unsigned int)regs[0] < 0x80000007)
+        return 0;
+    __cpuid(regs, 0x80000007);
+    return (regs[3] >> 8) & 1;
+#else
+    unsigned int eax, ebx, ecx, edx;
+
+    if (__get_cpuid_max(0x80000000, NULL) < 0x80000007)
+        return 0;
+    __cpuid(0x80000007, eax, ebx, ecx, edx);
+    (void)eax; (void)ebx; (void)ecx;
+    return (edx >> 8) & 1;
+#endif
+}
+
+/*
+ * TSC reading taken as close as possible to an OS clock reading: the
+ * midpoint of the tightest of a few TSC brackets around it
+ */
+static uint64_t clock_tsc_pair(uint64_t *os_ns)
+{
+    uint64_t mult = clock_mult(clock_os_hz());
+    uint64_t best = UINT64_MAX, tsc = 0;
+    int i;
+
+    for (i = 0; i < CLOCK_PAIR_TRIES; i++) {
+        uint64_t before = __rdtsc();
+        uint64_t ns = clock_scale(clock_os_ticks(), mult);
+        uint64_t width = __rdtsc() - before;
+
+        if (width < best) {
+            best = width;
+            tsc = before + width / 2;
+            *os_ns = ns;
+        }
+    }
+    return tsc;
+}
+
+/*
+ * Measure the TSC against the OS clock. Returns 0 with its rate and
+ * conversion factor, or -1 if it did not advance at a plausible rate.
+ */
+static int clock_tsc_calibrate(uint64_t *hz, uint64_t *mult, uint64_t *inv_mult)
+{
+    uint64_t ns0, ns1, tsc0, tsc1;
+
+    tsc0 = clock_tsc_pair(&ns0);
+    do {
+        tsc1 = clock_tsc_pair(&ns1);
+    } while (ns1 - ns0 < CLOCK_CALIBRATE_NS);
+
+    if (tsc1 <= tsc0)
+        return -1;
+
+    *hz = (uint64_t)((double)(tsc1 - tsc0) * 1e9 / (double)(ns1 - ns0) + 0.5);
+    *mult = ((ns1 - ns0) << CLOCK_SHIFT) / (tsc1 - tsc0);
+    *inv_mult = ((tsc1 - tsc0) << CLOCK_SHIFT) / (ns1 - ns0);
+    return *hz >= CLOCK_TSC_MIN_HZ ? 0 : -1;
+}
+#endif
+
+static void clock_init_once(void)
+{
+    const char *env = getenv(PCIE_SIM_CLOCK_ENV);
+    int source = PCIE_SIM_CLOCK_MONOTONIC;
+
+#ifdef _WIN32
+    if (!QueryPerformanceFrequency(&g_qpc_frequency))
+        g_qpc_frequency.QuadPart = 0;
+#endif
+
+#ifdef PCIE_SIM_CLOCK_HAVE_TSC
+    if (!(env && strcmp(env, "monotonic") == 0) && clock_tsc_invariant() &&
+        clock_tsc_calibrate(&g_clock.hz, &g_clock.mult, &g_clock.inv_mult) == 0)
+        source = PCIE_SIM_CLOCK_TSC;
+#else
+    (void)env;
+#endif
+    if (source != PCIE_SIM_CLOCK_TSC) {
+        g_clock.hz = clock_os_hz();
+        g_clock.mult = clock_mult(g_clock.hz);
+        g_clock.inv_mult = ((g_clock.hz << CLOCK_SHIFT) + 500000000ULL) / 1000000000ULL;
+    }
+
+    g_clock.base_ns = clock_scale(clock_os_ticks(), clock_mult(clock_os_hz()));
+#ifdef PCIE_SIM_CLOCK_HAVE_TSC
+    g_clock.base_ticks = source == PCIE_SIM_CLOCK_TSC ? __rdtsc() : clock_os_ticks();
+#else
+    g_clock.base_ticks = clock_os_ticks();
+#endif
+
+    __atomic_store_n(&g_clock_source, source, __ATOMIC_RELEASE);
+}
+
+#ifdef _WIN32
+static BOOL CALLBACK clock_init_once_win(PINIT_ONCE once, PVOID param, PVOID *context)
+{
+    (void)once; (void)param; (void)context;
+    clock_init_once();
+    return TRUE;
+}
+#endif
+
+static int clock_source(void)
+{
+    int source = __atomic_load_n(&g_clock_source, __ATOMIC_ACQUIRE);
+
+    if (source >= 0)
+        return source;
+
+#ifdef _WIN32
+    InitOnceExecuteOnce(&g_clock_once, clock_init_once_win, NULL, NULL);
+#else
+    pthread_once(&g_clock_once, clock_init_once);
+#endif
+    return __atomic_load_n(&g_clock_source, __ATOMIC_ACQUIRE);
+}
+
+uint64_t pcie_sim_clock_ticks(void)
+{
+#ifdef PCIE_SIM_CLOCK_HAVE_TSC
+    if (clock_source() == PCIE_SIM_CLOCK_TSC)
+        return __rdtsc();
+#else
+    clock_source();
+#endif
+    return clock_os_ticks();
+}
+
+uint64_t pcie_sim_clock_to_ns(uint64_t ticks)
+{
+    clock_source();
+    return clock_scale(ticks, g_clock.mult);
+}
+
+uint64_t pcie_sim_clock_now_ns(void)
+{
+    uint64_t ticks = pcie_sim_clock_ticks();
+
+    return g_clock.base_ns + clock_scale(ticks - g_clock.base_ticks, g_clock.mult);
+}
+
+pcie_sim_clock_source_t pcie_sim_clock_source(void)
+{
+    return (pcie_sim_clock_source_t)clock_source();
+}
+
+uint64_t pcie_sim_clock_hz(void)
+{
+    clock_source();
+    return g_clock.hz;
+}
+
+/*
+ * Delays sleep for all but a margin before the deadline and spin through
+ * the rest. The margin tracks how late sleeps wake up: twice a running
+ * average of the oversleep, weighted 1/8 per sample.
+ */
+#define DELAY_MARGIN_MIN_NS 5000ULL
+#define DELAY_MARGIN_INIT_NS 20000ULL
+#ifdef _WIN32
+#define DELAY_MARGIN_MAX_NS 16000000ULL  /* Sleep() wakes on the scheduler tick */
+#else
+#define DELAY_MARGIN_MAX_NS 200000ULL
+#endif
+
+static uint64_t g_delay_oversleep_ns = DELAY_MARGIN_INIT_NS / 2;
+static struct pcie_sim_delay_stats g_delay_stats;
+
+static inline void clock_cpu_relax(void)
+{
+#ifdef PCIE_SIM_CLOCK_HAVE_TSC
+    _mm_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+static uint64_t delay_margin_ns(void)
+{
+    uint64_t margin = 2 * __atomic_load_n(&g_delay_oversleep_ns, __ATOMIC_RELAXED);
+
+    if (margin < DELAY_MARGIN_MIN_NS)
+        return DELAY_MARGIN_MIN_NS;
+    return margin > DELAY_MARGIN_MAX_NS ? DELAY_MARGIN_MAX_NS : margin;
+}
+
+/* Racing updates lose a sample at worst */
+static void delay_note_oversleep(uint64_t oversleep_ns)
+{
+    int64_t avg = (int64_t)__atomic_load_n(&g_delay_oversleep_ns, __ATOMIC_RELAXED);
+
+    avg += ((int64_t)oversleep_ns - avg) / 8;
+    __atomic_store_n(&g_delay_oversleep_ns, (uint64_t)avg, __ATOMIC_RELAXED);
+}
+
+/*
+ * Sleep for about ns. On Linux the thread's timer slack, 50 us by default,
+ * is lowered for the sleep and then put back.
+ */
+static void delay_sleep(uint64_t ns)
+{
+#ifdef _WIN32
+    if (ns >= 1000000ULL)
+        Sleep((DWORD)(ns / 1000000ULL));
+#else
+    struct timespec ts;
+#ifdef __linux__
+    int slack = prctl(PR_GET_TIMERSLACK, 0, 0, 0, 0);
+
+    if (slack > 1)
+        prctl(PR_SET_TIMERSLACK, 1, 0, 0, 0);
+#endif
+    ts.tv_sec = ns / 1000000000ULL;
+    ts.tv_nsec = ns % 1000000000ULL;
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR)
+        ;
+#ifdef __linux__
+    if (slack > 1)
+        prctl(PR_SET_TIMERSLACK, slack, 0, 0, 0);
+#endif
+#endif
+}
+
+static void delay_account(uint64_t requested_ns, uint64_t late_ns, int slept)
+{
+    struct pcie_sim_delay_stats *s = &g_delay_stats;
+    uint64_t max = __atomic_load_n(&s->late_max_ns, __ATOMIC_RELAXED);
+
+    __atomic_fetch_add(&s->count, 1, __ATOMIC_RELAXED);
+    if (slept)
+        __atomic_fetch_add(&s->slept, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&s->requested_ns, requested_ns, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&s->late_ns, late_ns, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&s->late_hist[pcie_sim_stats_bucket(late_ns, PCIE_SIM_DELAY_BUCKETS)],
+                       1, __ATOMIC_RELAXED);
+    while (late_ns > max &&
+           !__atomic_compare_exchange_n(&s->late_max_ns, &max, late_ns, 0,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+}
+
+void pcie_sim_delay_ns(uint64_t ns)
+{
+    uint64_t start, deadline, now, margin, elapsed;
+    int slept = 0;
+
+    if (!ns)
+        return;
+
+    start = pcie_sim_clock_ticks();
+    deadline = start + clock_scale(ns, g_clock.inv_mult);
+
+    margin = delay_margin_ns();
+    if (ns > margin) {
+        delay_sleep(ns - margin);
+        elapsed = pcie_sim_clock_to_ns(pcie_sim_clock_ticks() - start);
+        delay_note_oversleep(elapsed > ns - margin ? elapsed - (ns - margin) : 0);
+        slept = 1;
+    }
+
+    while ((int64_t)((now = pcie_sim_clock_ticks()) - deadline) < 0)
+        clock_cpu_relax();
+
+    elapsed = pcie_sim_clock_to_ns(now - start);
+    delay_account(ns, elapsed > ns ? elapsed - ns : 0, slept);
+}
+
+void pcie_sim_delay_get_stats(struct pcie_sim_delay_stats *stats)
+{
+    unsigned int i;
+
+    if (!stats)
+        return;
+
+    stats->count = __atomic_load_n(&g_delay_stats.count, __ATOMIC_RELAXED);
+    stats->slept = __atomic_load_n(&g_delay_stats.slept, __ATOMIC_RELAXED);
+    stats->requested_ns = __atomic_load_n(&g_delay_stats.requested_ns, __ATOMIC_RELAXED);
+    stats->late_ns = __atomic_load_n(&g_delay_stats.late_ns, __ATOMIC_RELAXED);
+    stats->late_max_ns = __atomic_load_n(&g_delay_stats.late_max_ns, __ATOMIC_RELAXED);
+    stats->margin_ns = delay_margin_ns();
+    for (i = 0; i < PCIE_SIM_DELAY_BUCKETS; i++)
+        stats->late_hist[i] = __atomic_load_n(&g_delay_stats.late_hist[i], __ATOMIC_RELAXED);
+}
+
+void pcie_sim_delay_reset_stats(void)
+{
+    unsigned int i;
+
+    __atomic_store_n(&g_delay_stats.count, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&g_delay_stats.slept, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&g_delay_stats.requested_ns, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&g_delay_stats.late_ns, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&g_delay_stats.late_max_ns, 0, __ATOMIC_RELAXED);
+    for (i = 0; i < PCIE_SIM_DELAY_BUCKETS; i++)
+        __atomic_store_n(&g_delay_stats.late_hist[i], 0, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,123 @@
+/*
+ * PCIe Simulator Library - Timestamps and Delays
+ *
+ * Copyright (c) 2025 Karan Mamaniya <kmamaniya@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Cheap timestamps for instrumenting transfers. Hot paths record raw ticks
+ * and convert differences to nanoseconds only when they report them. The
+ * simulators' modeled delays are timed on the same clock.
+ */
+
+#ifndef PCIE_SIM_CLOCK_H
+#define PCIE_SIM_CLOCK_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* What pcie_sim_clock_ticks() counts */
+typedef enum {
+    PCIE_SIM_CLOCK_MONOTONIC = 0,   /* The OS monotonic clock */
+    PCIE_SIM_CLOCK_TSC = 1          /* Invariant x86 time stamp counter */
+} pcie_sim_clock_source_t;
+
+/* Set to "monotonic" to keep the TSC out of use */
+#define PCIE_SIM_CLOCK_ENV "PCIE_SIM_CLOCK"
+
+#define PCIE_SIM_DELAY_BUCKETS 32   /* Bucket i: [2^i, 2^(i+1)) ns late */
+
+/* How closely pcie_sim_delay_ns() has kept to its deadlines, process-wide */
+struct pcie_sim_delay_stats {
+    uint64_t count;             /* Delays performed */
+    uint64_t slept;             /* Delays long enough to sleep before spinning */
+    uint64_t requested_ns;      /* Sum of the delays asked for */
+    uint64_t late_ns;           /* Sum of the time past each deadline */
+    uint64_t late_max_ns;
+    uint64_t margin_ns;         /* Current spin margin before a deadline */
+    uint64_t late_hist[PCIE_SIM_DELAY_BUCKETS];
+};
+
+/**
+ * Read the timestamp counter
+ * @return Ticks since an arbitrary origin; only differences are meaningful
+ *
+ * The TSC is used when the CPU reports it invariant, so it runs at a fixed
+ * rate across frequency changes and idle states and agrees between cores.
+ * It is calibrated against the monotonic clock on first use, which takes
+ * a couple of milliseconds. Otherwise ticks come from the monotonic clock.
+ */
+uint64_t pcie_sim_clock_ticks(void);
+
+/**
+ * Convert a tick count to nanoseconds
+ * @param ticks Difference of two pcie_sim_clock_ticks() values
+ * @return Nanoseconds; exact to the calibration for any interval
+ */
+uint64_t pcie_sim_clock_to_ns(uint64_t ticks);
+
+/**
+ * Current time in nanoseconds on the monotonic clock's timeline
+ * @return Nanoseconds; comparable with CLOCK_MONOTONIC readings
+ */
+uint64_t pcie_sim_clock_now_ns(void);
+
+/**
+ * Report where ticks come from
+ * @return PCIE_SIM_CLOCK_TSC or PCIE_SIM_CLOCK_MONOTONIC
+ */
+pcie_sim_clock_source_t pcie_sim_clock_source(void);
+
+/**
+ * Tick rate
+ * @return Ticks per second
+ */
+uint64_t pcie_sim_clock_hz(void);
+
+/**
+ * Wait for ns nanoseconds
+ * @param ns Delay; 0 returns at once
+ *
+ * Sleeps until a margin before the deadline, then spins on the clock, so
+ * it returns within tens of nanoseconds of the deadline unless the thread
+ * is preempted. The margin follows how late recent sleeps woke up. On
+ * Linux the thread's timer slack is lowered for the sleep and restored
+ * afterwards.
+ */
+void pcie_sim_delay_ns(uint64_t ns);
+
+/**
+ * Read the delay accuracy counters
+ * @param stats Filled with the counters since start or the last reset
+ */
+void pcie_sim_delay_get_stats(struct pcie_sim_delay_stats *stats);
+
+/**
+ * Zero the delay accuracy counters; the spin margin is kept
+ */
+void pcie_sim_delay_reset_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PCIE_SIM_CLOCK_H */
@@ -25,6 +25,7 @@
  */
 
 #include "api.h"
+#include "backend.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -48,28 +49,6 @@ struct pcie_sim_handle {
     int is_simulation;  /* Flag to indicate simulation mode */
 };
 
-#ifdef _WIN32
-/* Forward declarations for Windows implementations (defined in windows_sim.c) */
-extern pcie_sim_error_t pcie_sim_open_impl(int device_id, pcie_sim_handle_t *handle);
-extern pcie_sim_error_t pcie_sim_close_impl(pcie_sim_handle_t handle);
-extern pcie_sim_error_t pcie_sim_transfer_impl(pcie_sim_handle_t handle, void *buffer,
-                                              size_t size, uint32_t direction,
-                                              uint64_t *latency_ns);
-extern pcie_sim_error_t pcie_sim_get_stats_impl(pcie_sim_handle_t handle,
-                                                struct pcie_sim_stats *stats);
-extern pcie_sim_error_t pcie_sim_reset_stats_impl(pcie_sim_handle_t handle);
-#else
-/* Forward declarations for Linux implementations (defined in sim/linux_sim.c) */
-extern pcie_sim_error_t pcie_sim_open_linux(int device_id, pcie_sim_handle_t *handle);
-extern pcie_sim_error_t pcie_sim_close_linux(pcie_sim_handle_t handle);
-extern pcie_sim_error_t pcie_sim_transfer_linux(pcie_sim_handle_t handle, void *buffer,
-                                               size_t size, uint32_t direction,
-                                               uint64_t *latency_ns);
-extern pcie_sim_error_t pcie_sim_get_stats_linux(pcie_sim_handle_t handle,
-                                                 struct pcie_sim_stats *stats);
-extern pcie_sim_error_t pcie_sim_reset_stats_linux(pcie_sim_handle_t handle);
-#endif
-
 /*
  * Open a PCIe simulator device
  */
@@ -110,6 +89,23 @@ pcie_sim_error_t pcie_sim_transfer(pcie_sim_handle_t handle,
 #endif
 }
 
+/*
+ * Transfer data with per-phase timing
+ */
+pcie_sim_error_t pcie_sim_transfer_ex(pcie_sim_handle_t handle,
+                                    void *buffer,
+                                    size_t size,
+                                    uint32_t direction,
+                                    uint64_t *latency_ns,
+                                    uint64_t *phase_ns)
+{
+#ifdef _WIN32
+    return pcie_sim_transfer_ex_impl(handle, buffer, size, direction, latency_ns, phase_ns);
+#else
+    return pcie_sim_transfer_ex_linux(handle, buffer, size, direction, latency_ns, phase_ns);
+#endif
+}
+
 /*
  * Get device statistics
  */
@@ -123,6 +119,32 @@ pcie_sim_error_t pcie_sim_get_stats(pcie_sim_handle_t handle,
 #endif
 }
 
+/*
+ * Get extended device statistics
+ */
+pcie_sim_error_t pcie_sim_get_stats_ex(pcie_sim_handle_t handle,
+                                     struct pcie_sim_stats_ex *stats)
+{
+#ifdef _WIN32
+    return pcie_sim_get_stats_ex_impl(handle, stats);
+#else
+    return pcie_sim_get_stats_ex_linux(handle, stats);
+#endif
+}
+
+/*
+ * Map the device counter page
+ */
+pcie_sim_error_t pcie_sim_stats_map(pcie_sim_handle_t handle,
+                                   const struct pcie_sim_stats_page **page)
+{
+#ifdef _WIN32
+    return pcie_sim_stats_map_impl(handle, page);
+#else
+    return pcie_sim_stats_map_linux(handle, page);
+#endif
+}
+
 /*
  * Reset device statistics
  */
@@ -135,14 +157,221 @@ pcie_sim_error_t pcie_sim_reset_stats(pcie_sim_handle_t handle)
 #endif
 }
 
-#ifndef _WIN32
-/* Forward declarations for Linux implementations (defined in sim/linux_sim.c) */
-extern pcie_sim_error_t pcie_sim_open_linux(int device_id, pcie_sim_handle_t *handle);
-extern pcie_sim_error_t pcie_sim_close_linux(pcie_sim_handle_t handle);
-extern pcie_sim_error_t pcie_sim_transfer_linux(pcie_sim_handle_t handle, void *buffer,
-                                               size_t size, uint32_t direction,
-                                               uint64_t *latency_ns);
-extern pcie_sim_error_t pcie_sim_get_stats_linux(pcie_sim_handle_t handle,
-                                                 struct pcie_sim_stats *stats);
-extern pcie_sim_error_t pcie_sim_reset_stats_linux(pcie_sim_handle_t handle);
-#endif /* !_WIN32 */
\ No newline at end of file
+/*
+ * Reset device statistics and report the new epoch
+ */
+pcie_sim_error_t pcie_sim_reset_stats_epoch(pcie_sim_handle_t handle, uint64_t *epoch)
+{
+#ifdef _WIN32
+    return pcie_sim_reset_stats_epoch_impl(handle, epoch);
+#else
+    return pcie_sim_reset_stats_epoch_linux(handle, epoch);
+#endif
+}
+
+/*
+ * Read a BAR0 register
+ */
+pcie_sim_error_t pcie_sim_mmio_read32(pcie_sim_handle_t handle, uint32_t offset,
+                                     uint32_t *value)
+{
+#ifdef _WIN32
+    return pcie_sim_mmio_read32_impl(handle, offset, value);
+#else
+    return pcie_sim_mmio_read32_linux(handle, offset, value);
+#endif
+}
+
+/*
+ * Write a BAR0 register
+ */
+pcie_sim_error_t pcie_sim_mmio_write32(pcie_sim_handle_t handle, uint32_t offset,
+                                      uint32_t value)
+{
+#ifdef _WIN32
+    return pcie_sim_mmio_write32_impl(handle, offset, value);
+#else
+    return pcie_sim_mmio_write32_linux(handle, offset, value);
+#endif
+}
+
+/*
+ * Drain the write-combining buffer
+ */
+pcie_sim_error_t pcie_sim_mmio_flush(pcie_sim_handle_t handle)
+{
+#ifdef _WIN32
+    return pcie_sim_mmio_flush_impl(handle);
+#else
+    return pcie_sim_mmio_flush_linux(handle);
+#endif
+}
+
+/*
+ * Configure the MMIO cost model
+ */
+pcie_sim_error_t pcie_sim_mmio_configure(pcie_sim_handle_t handle,
+                                        const struct pcie_sim_mmio_config *config)
+{
+#ifdef _WIN32
+    return pcie_sim_mmio_configure_impl(handle, config);
+#else
+    return pcie_sim_mmio_configure_linux(handle, config);
+#endif
+}
+
+/*
+ * Get MMIO access statistics
+ */
+pcie_sim_error_t pcie_sim_mmio_get_stats(pcie_sim_handle_t handle,
+                                        struct pcie_sim_mmio_stats *stats)
+{
+#ifdef _WIN32
+    return pcie_sim_mmio_get_stats_impl(handle, stats);
+#else
+    return pcie_sim_mmio_get_stats_linux(handle, stats);
+#endif
+}
+
+/*
+ * Reset MMIO access statistics
+ */
+pcie_sim_error_t pcie_sim_mmio_reset_stats(pcie_sim_handle_t handle)
+{
+#ifdef _WIN32
+    return pcie_sim_mmio_reset_stats_impl(handle);
+#else
+    return pcie_sim_mmio_reset_stats_linux(handle);
+#endif
+}
+
+/*
+ * Drain the MMIO access trace
+ */
+pcie_sim_error_t pcie_sim_mmio_read_trace(pcie_sim_handle_t handle,
+                                         struct pcie_sim_mmio_trace_entry *entries,
+                                         size_t max_entries, size_t *count)
+{
+#ifdef _WIN32
+    return pcie_sim_mmio_read_trace_impl(handle, entries, max_entries, count);
+#else
+    return pcie_sim_mmio_read_trace_linux(handle, entries, max_entries, count);
+#endif
+}
+
+/*
+ * Serialize device state into a buffer
+ */
+pcie_sim_error_t pcie_sim_snapshot(pcie_sim_handle_t handle, void *buffer,
+                                  size_t size, size_t *used)
+{
+#ifdef _WIN32
+    return pcie_sim_snapshot_impl(handle, buffer, size, used);
+#else
+    return pcie_sim_snapshot_linux(handle, buffer, size, used);
+#endif
+}
+
+/*
+ * Restore device state from a buffer
+ */
+pcie_sim_error_t pcie_sim_restore(pcie_sim_handle_t handle, const void *buffer,
+                                 size_t size)
+{
+#ifdef _WIN32
+    return pcie_sim_restore_impl(handle, buffer, size);
+#else
+    return pcie_sim_restore_linux(handle, buffer, size);
+#endif
+}
+
+/*
+ * Report the memory a device holds
+ */
+pcie_sim_error_t pcie_sim_get_memory_stats(pcie_sim_handle_t handle,
+                                          struct pcie_sim_memory_stats *stats)
+{
+#ifdef _WIN32
+    return pcie_sim_get_memory_stats_impl(handle, stats);
+#else
+    return pcie_sim_get_memory_stats_linux(handle, stats);
+#endif
+}
+
+/*
+ * Save a device snapshot to a file
+ */
+pcie_sim_error_t pcie_sim_snapshot_save(pcie_sim_handle_t handle, const char *path)
+{
+    pcie_sim_error_t ret;
+    size_t size = 0;
+    void *buffer;
+    FILE *f;
+
+    if (!path)
+        return PCIE_SIM_ERROR_PARAM;
+
+    ret = pcie_sim_snapshot(handle, NULL, 0, &size);
+    if (ret != PCIE_SIM_SUCCESS)
+        return ret;
+
+    buffer = malloc(size);
+    if (!buffer)
+        return PCIE_SIM_ERROR_MEMORY;
+
+    ret = pcie_sim_snapshot(handle, buffer, size, &size);
+    if (ret == PCIE_SIM_SUCCESS) {
+        f = fopen(path, "wb");
+        if (!f) {
+            ret = PCIE_SIM_ERROR_SYSTEM;
+        } else {
+            if (fwrite(buffer, 1, size, f) != size)
+                ret = PCIE_SIM_ERROR_SYSTEM;
+            if (fclose(f) != 0)
+                ret = PCIE_SIM_ERROR_SYSTEM;
+        }
+    }
+
+    free(buffer);
+    return ret;
+}
+
+/*
+ * Restore a device from a snapshot file
+ */
+pcie_sim_error_t pcie_sim_snapshot_load(pcie_sim_handle_t handle, const char *path)
+{
+    pcie_sim_error_t ret = PCIE_SIM_ERROR_SYSTEM;
+    void *buffer = NULL;
+    long size;
+    FILE *f;
+
+    if (!path)
+        return PCIE_SIM_ERROR_PARAM;
+
+    f = fopen(path, "rb");
+    if (!f)
+        return PCIE_SIM_ERROR_SYSTEM;
+
+    if (fseek(f, 0, SEEK_END) != 0 || (size = ftell(f)) < 0 || fseek(f, 0, SEEK_SET) != 0)
+        goto out;
+
+    if ((unsigned long)size > PCIE_SIM_SNAPSHOT_MAX_SIZE) {
+        ret = PCIE_SIM_ERROR_PARAM;
+        goto out;
+    }
+
+    buffer = malloc(size ? (size_t)size : 1);
+    if (!buffer) {
+        ret = PCIE_SIM_ERROR_MEMORY;
+        goto out;
+    }
+
+    if (fread(buffer, 1, (size_t)size, f) == (size_t)size)
+        ret = pcie_sim_restore(handle, buffer, (size_t)size);
+
+out:
+    free(buffer);
+    fclose(f);
+    return ret;
+}
@@ -29,10 +29,16 @@
 #include <vector>
 #include <string>
 #include <stdexcept>
+#include <utility>
+#include <type_traits>
+#include <cstddef>
 #include <cstdint>
+#include <cstdio>
+#include <cstdlib>
 
 extern "C" {
 #include "pcie_sim.h"
+#include "backend.h"
 }
 
 namespace PCIeSimulator {
@@ -51,6 +57,7 @@ private:
 
 class Statistics {
 public:
+    Statistics() : stats_() {}
     Statistics(const pcie_sim_stats& stats) : stats_(stats) {}
 
     uint64_t total_transfers() const { return stats_.total_transfers; }
@@ -59,6 +66,7 @@ public:
     uint64_t avg_latency_ns() const { return stats_.avg_latency_ns; }
     uint64_t min_latency_ns() const { return stats_.min_latency_ns; }
     uint64_t max_latency_ns() const { return stats_.max_latency_ns; }
+    uint64_t stddev_latency_ns() const { return stats_.stddev_latency_ns; }
 
     double throughput_mbps() const {
         if (total_transfers() == 0) return 0.0;
@@ -74,32 +82,239 @@ enum class Direction {
     FROM_DEVICE = PCIE_SIM_FROM_DEVICE
 };
 
-class Device {
+namespace detail {
+
+// True for types exposing contiguous storage through data() and size()
+template<typename C>
+class is_contiguous {
+    template<typename U>
+    static auto test(U* u) -> decltype(u->data(), u->size(), std::true_type());
+    template<typename U>
+    static std::false_type test(...);
+
+public:
+    static const bool value =
+        decltype(test<typename std::remove_reference<C>::type>(nullptr))::value;
+};
+
+} // namespace detail
+
+// Value-or-error return type used by the non-throwing error policy
+template<typename T>
+class Result {
 public:
-    explicit Device(int device_id = 0) {
-        pcie_sim_error_t err = pcie_sim_open(device_id, &handle_);
+    static Result success(T value) { return Result(std::move(value), PCIE_SIM_SUCCESS); }
+    static Result failure(pcie_sim_error_t error) { return Result(T(), error); }
+
+    bool ok() const { return error_ == PCIE_SIM_SUCCESS; }
+    explicit operator bool() const { return ok(); }
+    pcie_sim_error_t error() const { return error_; }
+
+    T& value() { return value_; }
+    const T& value() const { return value_; }
+    T value_or(const T& fallback) const { return ok() ? value_ : fallback; }
+
+private:
+    Result(T value, pcie_sim_error_t error) : value_(std::move(value)), error_(error) {}
+
+    T value_;
+    pcie_sim_error_t error_;
+};
+
+/*
+ * Error policies decide how BasicDevice reports a failed backend call.
+ * result_type<T> is what value-returning operations return and status_type
+ * is what void operations return.
+ */
+
+// Throw DeviceError (the classic Device behaviour)
+struct ThrowOnError {
+    template<typename T> using result_type = T;
+    typedef void status_type;
+
+    template<typename T> static T success(T value) { return value; }
+    template<typename T> static T failure(pcie_sim_error_t error) { throw DeviceError(error); }
+
+    static void status(pcie_sim_error_t error) {
+        if (error != PCIE_SIM_SUCCESS) throw DeviceError(error);
+    }
+};
+
+// Return Result<T> / pcie_sim_error_t, never throws
+struct ReturnError {
+    template<typename T> using result_type = Result<T>;
+    typedef pcie_sim_error_t status_type;
+
+    template<typename T> static Result<T> success(T value) { return Result<T>::success(std::move(value)); }
+    template<typename T> static Result<T> failure(pcie_sim_error_t error) { return Result<T>::failure(error); }
+
+    static pcie_sim_error_t status(pcie_sim_error_t error) { return error; }
+};
+
+// Treat any device error as fatal, for harnesses where failure is a bug
+struct AbortOnError {
+    template<typename T> using result_type = T;
+    typedef void status_type;
+
+    template<typename T> static T success(T value) { return value; }
+    template<typename T> static T failure(pcie_sim_error_t error) { fatal(error); }
+
+    static void status(pcie_sim_error_t error) {
+        if (error != PCIE_SIM_SUCCESS) fatal(error);
+    }
+
+    [[noreturn]] static void fatal(pcie_sim_error_t error) {
+        std::fprintf(stderr, "pcie_sim: fatal device error: %s\n", pcie_sim_error_string(error));
+        std::abort();
+    }
+};
+
+/*
+ * Backends are stateless adaptors over a C entry point set. CApiBackend goes
+ * through the public API; NativeBackend binds straight to the platform
+ * backend so the compiler sees a single direct call on the hot path.
+ */
+
+struct CApiBackend {
+    static pcie_sim_error_t open(int device_id, pcie_sim_handle_t* handle) {
+        return pcie_sim_open(device_id, handle);
+    }
+    static pcie_sim_error_t close(pcie_sim_handle_t handle) {
+        return pcie_sim_close(handle);
+    }
+    static pcie_sim_error_t transfer(pcie_sim_handle_t handle, void* buffer, size_t size,
+                                     uint32_t direction, uint64_t* latency_ns) {
+        return pcie_sim_transfer(handle, buffer, size, direction, latency_ns);
+    }
+    static pcie_sim_error_t get_stats(pcie_sim_handle_t handle, pcie_sim_stats* stats) {
+        return pcie_sim_get_stats(handle, stats);
+    }
+    static pcie_sim_error_t reset_stats(pcie_sim_handle_t handle) {
+        return pcie_sim_reset_stats(handle);
+    }
+    static pcie_sim_error_t get_stats_ex(pcie_sim_handle_t handle, pcie_sim_stats_ex* stats) {
+        return pcie_sim_get_stats_ex(handle, stats);
+    }
+    static pcie_sim_error_t reset_stats_epoch(pcie_sim_handle_t handle, uint64_t* epoch) {
+        return pcie_sim_reset_stats_epoch(handle, epoch);
+    }
+    static pcie_sim_error_t stats_map(pcie_sim_handle_t handle, const pcie_sim_stats_page** page) {
+        return pcie_sim_stats_map(handle, page);
+    }
+};
+
+#ifdef _WIN32
+struct NativeBackend {
+    static pcie_sim_error_t open(int device_id, pcie_sim_handle_t* handle) {
+        return pcie_sim_open_impl(device_id, handle);
+    }
+    static pcie_sim_error_t close(pcie_sim_handle_t handle) {
+        return pcie_sim_close_impl(handle);
+    }
+    static pcie_sim_error_t transfer(pcie_sim_handle_t handle, void* buffer, size_t size,
+                                     uint32_t direction, uint64_t* latency_ns) {
+        return pcie_sim_transfer_impl(handle, buffer, size, direction, latency_ns);
+    }
+    static pcie_sim_error_t get_stats(pcie_sim_handle_t handle, pcie_sim_stats* stats) {
+        return pcie_sim_get_stats_impl(handle, stats);
+    }
+    static pcie_sim_error_t reset_stats(pcie_sim_handle_t handle) {
+        return pcie_sim_reset_stats_impl(handle);
+    }
+    static pcie_sim_error_t get_stats_ex(pcie_sim_handle_t handle, pcie_sim_stats_ex* stats) {
+        return pcie_sim_get_stats_ex_impl(handle, stats);
+    }
+    static pcie_sim_error_t reset_stats_epoch(pcie_sim_handle_t handle, uint64_t* epoch) {
+        return pcie_sim_reset_stats_epoch_impl(handle, epoch);
+    }
+    static pcie_sim_error_t stats_map(pcie_sim_handle_t handle, const pcie_sim_stats_page** page) {
+        return pcie_sim_stats_map_impl(handle, page);
+    }
+};
+#else
+struct NativeBackend {
+    static pcie_sim_error_t open(int device_id, pcie_sim_handle_t* handle) {
+        return pcie_sim_open_linux(device_id, handle);
+    }
+    static pcie_sim_error_t close(pcie_sim_handle_t handle) {
+        return pcie_sim_close_linux(handle);
+    }
+    static pcie_sim_error_t transfer(pcie_sim_handle_t handle, void* buffer, size_t size,
+                                     uint32_t direction, uint64_t* latency_ns) {
+        return pcie_sim_transfer_linux(handle, buffer, size, direction, latency_ns);
+    }
+    static pcie_sim_error_t get_stats(pcie_sim_handle_t handle, pcie_sim_stats* stats) {
+        return pcie_sim_get_stats_linux(handle, stats);
+    }
+    static pcie_sim_error_t reset_stats(pcie_sim_handle_t handle) {
+        return pcie_sim_reset_stats_linux(handle);
+    }
+    static pcie_sim_error_t get_stats_ex(pcie_sim_handle_t handle, pcie_sim_stats_ex* stats) {
+        return pcie_sim_get_stats_ex_linux(handle, stats);
+    }
+    static pcie_sim_error_t reset_stats_epoch(pcie_sim_handle_t handle, uint64_t* epoch) {
+        return pcie_sim_reset_stats_epoch_linux(handle, epoch);
+    }
+    static pcie_sim_error_t stats_map(pcie_sim_handle_t handle, const pcie_sim_stats_page** page) {
+        return pcie_sim_stats_map_linux(handle, page);
+    }
+};
+#endif
+
+// Tag for constructing a BasicDevice without opening it
+struct deferred_open_t {};
+const deferred_open_t deferred_open = deferred_open_t();
+
+template<typename Backend, typename ErrorPolicy>
+class BasicDevice {
+public:
+    template<typename T>
+    using result_type = typename ErrorPolicy::template result_type<T>;
+    typedef typename ErrorPolicy::status_type status_type;
+
+    // Opens the device; with ReturnError a failed open leaves is_valid() false
+    explicit BasicDevice(int device_id = 0) {
+        pcie_sim_error_t err = Backend::open(device_id, &handle_);
         if (err != PCIE_SIM_SUCCESS) {
-            throw DeviceError(err);
+            handle_ = nullptr;
+            ErrorPolicy::status(err);
         }
     }
 
-    ~Device() {
+    // Closed device, to be opened later with try_open()
+    explicit BasicDevice(deferred_open_t) noexcept {}
+
+    ~BasicDevice() {
         if (handle_) {
-            pcie_sim_close(handle_);
+            Backend::close(handle_);
         }
     }
 
-    Device(const Device&) = delete;
-    Device& operator=(const Device&) = delete;
+    // Open (or reopen) without going through ErrorPolicy
+    pcie_sim_error_t try_open(int device_id) noexcept {
+        if (handle_) {
+            Backend::close(handle_);
+            handle_ = nullptr;
+        }
 
-    Device(Device&& other) noexcept : handle_(other.handle_) {
+        pcie_sim_error_t err = Backend::open(device_id, &handle_);
+        if (err != PCIE_SIM_SUCCESS) {
+            handle_ = nullptr;
+        }
+        return err;
+    }
+
+    BasicDevice(const BasicDevice&) = delete;
+    BasicDevice& operator=(const BasicDevice&) = delete;
+
+    BasicDevice(BasicDevice&& other) noexcept : handle_(other.handle_) {
         other.handle_ = nullptr;
     }
 
-    Device& operator=(Device&& other) noexcept {
+    BasicDevice& operator=(BasicDevice&& other) noexcept {
         if (this != &other) {
             if (handle_) {
-                pcie_sim_close(handle_);
+                Backend::close(handle_);
             }
             handle_ = other.handle_;
             other.handle_ = nullptr;
@@ -107,72 +322,169 @@ public:
         return *this;
     }
 
-    uint64_t transfer(void* buffer, size_t size, Direction direction) {
-        uint64_t latency_ns;
-        pcie_sim_error_t err = pcie_sim_transfer(
+    result_type<uint64_t> transfer(void* buffer, size_t size, Direction direction) {
+        uint64_t latency_ns = 0;
+        pcie_sim_error_t err = Backend::transfer(
+            handle_, buffer, size,
+            static_cast<uint32_t>(direction),
+            &latency_ns
+        );
+
+        if (err != PCIE_SIM_SUCCESS) {
+            return ErrorPolicy::template failure<uint64_t>(err);
+        }
+
+        return ErrorPolicy::success(latency_ns);
+    }
+
+    // Never throws regardless of ErrorPolicy; failures cost no allocation
+    Result<uint64_t> try_transfer(void* buffer, size_t size, Direction direction) noexcept {
+        uint64_t latency_ns = 0;
+        pcie_sim_error_t err = Backend::transfer(
             handle_, buffer, size,
             static_cast<uint32_t>(direction),
             &latency_ns
         );
 
         if (err != PCIE_SIM_SUCCESS) {
-            throw DeviceError(err);
+            return Result<uint64_t>::failure(err);
         }
 
-        return latency_ns;
+        return Result<uint64_t>::success(latency_ns);
     }
 
     template<typename T>
-    uint64_t write(const std::vector<T>& data) {
-        return transfer(const_cast<T*>(data.data()),
-                       data.size() * sizeof(T),
-                       Direction::TO_DEVICE);
+    result_type<uint64_t> write(const T* data, size_t count) {
+        return transfer(device_source(data), count * sizeof(T), Direction::TO_DEVICE);
     }
 
     template<typename T>
-    uint64_t read(std::vector<T>& data) {
-        return transfer(data.data(),
-                       data.size() * sizeof(T),
-                       Direction::FROM_DEVICE);
+    result_type<uint64_t> read(T* data, size_t count) {
+        return transfer(data, count * sizeof(T), Direction::FROM_DEVICE);
+    }
+
+    // Any contiguous buffer: std::vector, std::array, std::string, std::span, ...
+    template<typename Container>
+    typename std::enable_if<detail::is_contiguous<Container>::value, result_type<uint64_t>>::type
+    write(const Container& data) {
+        return write(data.data(), data.size());
     }
 
-    Statistics get_statistics() const {
+    template<typename Container>
+    typename std::enable_if<detail::is_contiguous<Container>::value, result_type<uint64_t>>::type
+    read(Container&& data) {
+        return read(data.data(), data.size());
+    }
+
+    template<typename T, size_t N>
+    result_type<uint64_t> write(const T (&data)[N]) {
+        return write(data, N);
+    }
+
+    template<typename T, size_t N>
+    result_type<uint64_t> read(T (&data)[N]) {
+        return read(data, N);
+    }
+
+    result_type<Statistics> get_statistics() const {
         pcie_sim_stats stats;
-        pcie_sim_error_t err = pcie_sim_get_stats(handle_, &stats);
+        pcie_sim_error_t err = Backend::get_stats(handle_, &stats);
         if (err != PCIE_SIM_SUCCESS) {
-            throw DeviceError(err);
+            return ErrorPolicy::template failure<Statistics>(err);
         }
-        return Statistics(stats);
+        return ErrorPolicy::success(Statistics(stats));
+    }
+
+    status_type reset_statistics() {
+        return ErrorPolicy::status(Backend::reset_stats(handle_));
     }
 
-    void reset_statistics() {
-        pcie_sim_error_t err = pcie_sim_reset_stats(handle_);
+    // Starts a new statistics epoch and returns its number
+    result_type<uint64_t> reset_statistics_epoch() {
+        uint64_t epoch = 0;
+        pcie_sim_error_t err = Backend::reset_stats_epoch(handle_, &epoch);
         if (err != PCIE_SIM_SUCCESS) {
-            throw DeviceError(err);
+            return ErrorPolicy::template failure<uint64_t>(err);
         }
+        return ErrorPolicy::success(epoch);
+    }
+
+    // Read-only counter page, sampled without calls into the backend
+    result_type<const pcie_sim_stats_page*> map_statistics() const {
+        const pcie_sim_stats_page* page = nullptr;
+        pcie_sim_error_t err = Backend::stats_map(handle_, &page);
+        if (err != PCIE_SIM_SUCCESS) {
+            return ErrorPolicy::template failure<const pcie_sim_stats_page*>(err);
+        }
+        return ErrorPolicy::success(page);
+    }
+
+    // Statistics since the start of epoch, even across one later reset
+    result_type<Statistics> get_statistics_since(uint64_t epoch) const {
+        pcie_sim_stats_ex ex{};
+        pcie_sim_stats stats;
+
+        ex.hdr.size = sizeof(ex);
+        ex.since_epoch = epoch;
+        pcie_sim_error_t err = Backend::get_stats_ex(handle_, &ex);
+        if (err != PCIE_SIM_SUCCESS) {
+            return ErrorPolicy::template failure<Statistics>(err);
+        }
+        // Providers older than version 4 leave the squares out
+        bool has_sq = ex.hdr.size >= offsetof(pcie_sim_stats_ex, latency_sq) +
+                                     sizeof(ex.latency_sq);
+        pcie_sim_stats_summary(&ex.xfer, has_sq ? &ex.latency_sq : nullptr, &stats);
+        return ErrorPolicy::success(Statistics(stats));
     }
 
     bool is_valid() const { return handle_ != nullptr; }
 
 private:
+    // The C transfer entry point is bidirectional and takes a mutable
+    // pointer; TO_DEVICE transfers only ever read from it.
+    static void* device_source(const void* data) {
+        return const_cast<void*>(data);
+    }
+
     pcie_sim_handle_t handle_ = nullptr;
 };
 
+// Default device: public C API with exceptions, as before
+typedef BasicDevice<CApiBackend, ThrowOnError> Device;
+
+// Hot-path device: direct backend calls, errors returned as values
+typedef BasicDevice<NativeBackend, ReturnError> FastDevice;
+
 class DeviceManager {
 public:
     static std::unique_ptr<Device> open_device(int device_id = 0) {
         return std::unique_ptr<Device>(new Device(device_id));
     }
 
+    // IDs of the devices that can be opened, probed without exceptions
+    static std::vector<int> list_devices(int max_devices = 8) {
+        std::vector<int> ids;
+        Device probe(deferred_open);
+
+        for (int i = 0; i < max_devices; ++i) {
+            if (probe.try_open(i) != PCIE_SIM_SUCCESS) {
+                continue;
+            }
+            ids.push_back(i);
+        }
+
+        return ids;
+    }
+
     static std::vector<std::unique_ptr<Device>> open_all_devices(int max_devices = 8) {
         std::vector<std::unique_ptr<Device>> devices;
 
         for (int i = 0; i < max_devices; ++i) {
-            try {
-                devices.push_back(std::unique_ptr<Device>(new Device(i)));
-            } catch (const DeviceError&) {
-                break;
+            std::unique_ptr<Device> device(new Device(deferred_open));
+            if (device->try_open(i) != PCIE_SIM_SUCCESS) {
+                continue;
             }
+            devices.push_back(std::move(device));
         }
 
         return devices;
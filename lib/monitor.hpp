@@ -43,6 +43,7 @@ struct PerformanceMetrics {
     double latency_avg_us;
     double latency_min_us;
     double latency_max_us;
+    double latency_stddev_us;
     double error_rate;
 
     void print(std::ostream& os = std::cout) const {
@@ -52,17 +53,26 @@ struct PerformanceMetrics {
            << "Throughput: " << throughput_mbps << " Mbps\n"
            << "Latency - Avg: " << latency_avg_us << " μs, "
            << "Min: " << latency_min_us << " μs, "
-           << "Max: " << latency_max_us << " μs\n"
+           << "Max: " << latency_max_us << " μs, "
+           << "Std Dev: " << latency_stddev_us << " μs\n"
            << "Error Rate: " << (error_rate * 100.0) << "%\n";
     }
 };
 
 class PerformanceMonitor {
 public:
-    explicit PerformanceMonitor(Device& device) : device_(device) {}
+    // Samples the device's counter page when the backend has one, so
+    // frequent sampling stays off the transfer path's locks
+    explicit PerformanceMonitor(Device& device) : device_(device) {
+        try {
+            page_ = device_.map_statistics();
+        } catch (const DeviceError&) {
+            page_ = nullptr;
+        }
+    }
 
     PerformanceMetrics get_current_metrics() const {
-        auto stats = device_.get_statistics();
+        Statistics stats = page_ ? sample_page() : device_.get_statistics();
 
         PerformanceMetrics metrics{};
         metrics.transfers = stats.total_transfers();
@@ -72,6 +82,7 @@ public:
         metrics.latency_avg_us = stats.avg_latency_ns() / 1000.0;
         metrics.latency_min_us = stats.min_latency_ns() / 1000.0;
         metrics.latency_max_us = stats.max_latency_ns() / 1000.0;
+        metrics.latency_stddev_us = stats.stddev_latency_ns() / 1000.0;
         metrics.error_rate = metrics.transfers > 0 ?
             static_cast<double>(metrics.errors) / metrics.transfers : 0.0;
 
@@ -114,7 +125,18 @@ public:
     }
 
 private:
+    Statistics sample_page() const {
+        pcie_sim_transfer_stats xfer;
+        pcie_sim_latency_sq sq;
+        pcie_sim_stats stats;
+
+        pcie_sim_stats_page_read(page_, &xfer, &sq);
+        pcie_sim_stats_summary(&xfer, &sq, &stats);
+        return Statistics(stats);
+    }
+
     Device& device_;
+    const pcie_sim_stats_page* page_ = nullptr;
     std::atomic<bool> monitoring_{false};
     std::thread monitor_thread_;
 };
@@ -138,26 +160,25 @@ public:
     PerformanceMetrics run_benchmark(const BenchmarkConfig& config = BenchmarkConfig()) {
         std::vector<uint8_t> buffer(config.transfer_size);
 
-        device_.reset_statistics();
-
         if (config.warmup) {
             for (size_t i = 0; i < config.warmup_transfers; ++i) {
                 device_.transfer(buffer.data(), buffer.size(), config.direction);
             }
-            device_.reset_statistics();
         }
 
-        auto start_time = std::chrono::high_resolution_clock::now();
+        // The measurement window is one epoch; a concurrent reset by
+        // another user of the device does not cut it short
+        uint64_t epoch = device_.reset_statistics_epoch();
+
+        uint64_t start_ticks = pcie_sim_clock_ticks();
 
         for (size_t i = 0; i < config.num_transfers; ++i) {
             device_.transfer(buffer.data(), buffer.size(), config.direction);
         }
 
-        auto end_time = std::chrono::high_resolution_clock::now();
-        auto duration = std::chrono::duration_cast<std::chrono::microseconds>(
-            end_time - start_time);
+        uint64_t elapsed_ns = pcie_sim_clock_to_ns(pcie_sim_clock_ticks() - start_ticks);
 
-        auto stats = device_.get_statistics();
+        auto stats = device_.get_statistics_since(epoch);
 
         PerformanceMetrics metrics{};
         metrics.transfers = stats.total_transfers();
@@ -166,10 +187,11 @@ public:
         metrics.latency_avg_us = stats.avg_latency_ns() / 1000.0;
         metrics.latency_min_us = stats.min_latency_ns() / 1000.0;
         metrics.latency_max_us = stats.max_latency_ns() / 1000.0;
+        metrics.latency_stddev_us = stats.stddev_latency_ns() / 1000.0;
         metrics.error_rate = metrics.transfers > 0 ?
             static_cast<double>(metrics.errors) / metrics.transfers : 0.0;
 
-        double total_time_s = duration.count() / 1e6;
+        double total_time_s = elapsed_ns / 1e9;
         metrics.throughput_mbps = (metrics.bytes * 8.0) / (total_time_s * 1e6);
 
         return metrics;
@@ -30,5 +30,9 @@
 
 #include "../lib/types.h"
 #include "../lib/api.h"
+#include "../lib/regs.h"
+#include "../lib/snapshot.h"
+#include "../lib/stats.h"
+#include "../lib/clock.h"
 
 #endif /* PCIE_SIM_H */
\ No newline at end of file
@@ -0,0 +1,179 @@
+/*
+ * PCIe Simulator - Per-Thread Device Pool
+ *
+ * Copyright (c) 2025 Karan Mamaniya <kmamaniya@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef POOL_H
+#define POOL_H
+
+#include "device.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <mutex>
+#include <set>
+
+namespace PCIeSimulator {
+
+/*
+ * DevicePool enumerates every available device and keeps one shared handle
+ * to each, then hands each worker thread its own handle per device. Handles
+ * are per thread rather than views of the shared one because a handle is a
+ * queue: a pcie_simd connection has one submission ring behind one lock, so
+ * threads sharing it would serialize. A thread's first local() call for a
+ * device opens its handle, with the pool lock held only to record it. The
+ * handle lives as long as the pool, so each thread opens a device at most
+ * once, and later calls are answered from a thread_local cache without
+ * locking.
+ */
+class DevicePool {
+public:
+    explicit DevicePool(int max_devices = 8) : serial_(register_pool()) {
+        for (int i = 0; i < max_devices; ++i) {
+            std::unique_ptr<Device> device(new Device(deferred_open));
+            if (device->try_open(i) != PCIE_SIM_SUCCESS) {
+                continue;
+            }
+            device_ids_.push_back(i);
+            shared_.push_back(std::move(device));
+        }
+    }
+
+    ~DevicePool() {
+        unregister_pool(serial_);
+    }
+
+    DevicePool(const DevicePool&) = delete;
+    DevicePool& operator=(const DevicePool&) = delete;
+
+    size_t size() const { return device_ids_.size(); }
+    const std::vector<int>& device_ids() const { return device_ids_; }
+
+    bool contains(int device_id) const {
+        return std::find(device_ids_.begin(), device_ids_.end(), device_id) != device_ids_.end();
+    }
+
+    // Handle shared by all threads, e.g. for statistics and control
+    Device* device(int device_id) const {
+        for (size_t i = 0; i < device_ids_.size(); ++i) {
+            if (device_ids_[i] == device_id) {
+                return shared_[i].get();
+            }
+        }
+        return nullptr;
+    }
+
+    // Calling thread's own handle; nullptr if the device is not in the pool
+    Device* local(int device_id) {
+        std::vector<CacheEntry>& cache = thread_cache();
+        for (size_t i = 0; i < cache.size(); ++i) {
+            if (cache[i].pool_serial == serial_ && cache[i].device_id == device_id) {
+                return cache[i].device;
+            }
+        }
+        return open_local(device_id);
+    }
+
+    // Number of per-thread handles opened so far
+    size_t local_handle_count() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return local_.size();
+    }
+
+private:
+    struct CacheEntry {
+        uint64_t pool_serial;
+        int device_id;
+        Device* device;
+    };
+
+    Device* open_local(int device_id) {
+        if (!contains(device_id)) {
+            return nullptr;
+        }
+
+        std::unique_ptr<Device> device(new Device(deferred_open));
+        if (device->try_open(device_id) != PCIE_SIM_SUCCESS) {
+            return nullptr;
+        }
+
+        Device* raw = device.get();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            local_.push_back(std::move(device));
+        }
+
+        std::vector<CacheEntry>& cache = thread_cache();
+        prune_dead_pools(cache);
+        CacheEntry entry = { serial_, device_id, raw };
+        cache.push_back(entry);
+        return raw;
+    }
+
+    static std::vector<CacheEntry>& thread_cache() {
+        static thread_local std::vector<CacheEntry> cache;
+        return cache;
+    }
+
+    // Serials of live pools; lets threads drop cache entries of destroyed pools
+    static std::mutex& registry_mutex() {
+        static std::mutex mutex;
+        return mutex;
+    }
+
+    static std::set<uint64_t>& live_pools() {
+        static std::set<uint64_t> pools;
+        return pools;
+    }
+
+    static uint64_t register_pool() {
+        static uint64_t next_serial = 0;
+        std::lock_guard<std::mutex> lock(registry_mutex());
+        uint64_t serial = ++next_serial;
+        live_pools().insert(serial);
+        return serial;
+    }
+
+    static void unregister_pool(uint64_t serial) {
+        std::lock_guard<std::mutex> lock(registry_mutex());
+        live_pools().erase(serial);
+    }
+
+    static void prune_dead_pools(std::vector<CacheEntry>& cache) {
+        std::lock_guard<std::mutex> lock(registry_mutex());
+        const std::set<uint64_t>& live = live_pools();
+        cache.erase(std::remove_if(cache.begin(), cache.end(),
+                                   [&live](const CacheEntry& entry) {
+                                       return live.count(entry.pool_serial) == 0;
+                                   }),
+                    cache.end());
+    }
+
+    const uint64_t serial_;
+    std::vector<int> device_ids_;
+    std::vector<std::unique_ptr<Device>> shared_;
+    std::vector<std::unique_ptr<Device>> local_;
+    mutable std::mutex mutex_;
+};
+
+} // namespace PCIeSimulator
+
+#endif // POOL_H
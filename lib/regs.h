@@ -0,0 +1,105 @@
+/*
+ * PCIe Simulator - BAR0 Register Map
+ *
+ * Copyright (c) 2025 Karan Mamaniya <kmamaniya@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Register offsets and bit definitions of the simulated device's BAR0,
+ * shared by the kernel module and the userspace simulators.
+ */
+
+#ifndef PCIE_SIM_REGS_H
+#define PCIE_SIM_REGS_H
+
+/*
+ * Plain integer constants only: this header is included by the kernel
+ * module as well as by userspace.
+ */
+
+/* BAR0 - Control registers (4KB) */
+#define PCIE_SIM_BAR0_SIZE              0x1000
+
+/* Value of PCIE_SIM_REG_DEVICE_ID after reset */
+#define PCIE_SIM_DEVICE_ID_VALUE        0x1234ABCD
+
+/* Control register offsets */
+#define PCIE_SIM_REG_DEVICE_ID          0x000  /* Device identification */
+#define PCIE_SIM_REG_STATUS             0x004  /* Device status */
+#define PCIE_SIM_REG_CONTROL            0x008  /* Device control */
+#define PCIE_SIM_REG_DMA_ADDR_LO        0x010  /* DMA address low 32 bits */
+#define PCIE_SIM_REG_DMA_ADDR_HI        0x014  /* DMA address high 32 bits */
+#define PCIE_SIM_REG_DMA_SIZE           0x018  /* DMA transfer size */
+#define PCIE_SIM_REG_DMA_CONTROL        0x01C  /* DMA control */
+#define PCIE_SIM_REG_INTERRUPT_STATUS   0x020  /* Interrupt status (write 1 to clear) */
+#define PCIE_SIM_REG_INTERRUPT_ENABLE   0x024  /* Interrupt enable */
+#define PCIE_SIM_REG_PERF_LATENCY       0x030  /* Last transfer latency (us) */
+#define PCIE_SIM_REG_PERF_COUNT         0x034  /* Transfer counter */
+#define PCIE_SIM_REG_ERROR_STATUS       0x040  /* Error status */
+#define PCIE_SIM_REG_ERROR_INJECT       0x044  /* Error injection control */
+
+/*
+ * Tail doorbells: one TX/RX pair per queue, 8 bytes apart. The host writes
+ * the ring's producer index to publish the descriptors before it.
+ */
+#define PCIE_SIM_MAX_QUEUES             16
+#define PCIE_SIM_REG_DOORBELL_BASE      0x100
+#define PCIE_SIM_REG_DOORBELL_END       (PCIE_SIM_REG_DOORBELL_BASE + PCIE_SIM_MAX_QUEUES * 8)
+#define PCIE_SIM_REG_TX_DOORBELL_Q(q)   (PCIE_SIM_REG_DOORBELL_BASE + (q) * 8)
+#define PCIE_SIM_REG_RX_DOORBELL_Q(q)   (PCIE_SIM_REG_DOORBELL_BASE + (q) * 8 + 4)
+#define PCIE_SIM_REG_TX_DOORBELL        PCIE_SIM_REG_TX_DOORBELL_Q(0)
+#define PCIE_SIM_REG_RX_DOORBELL        PCIE_SIM_REG_RX_DOORBELL_Q(0)
+#define PCIE_SIM_REG_IS_DOORBELL(off)   ((off) >= PCIE_SIM_REG_DOORBELL_BASE && \
+                                         (off) < PCIE_SIM_REG_DOORBELL_END)
+
+/* Status register bits */
+#define PCIE_SIM_STATUS_DEVICE_READY        (1U << 0)
+#define PCIE_SIM_STATUS_DMA_BUSY            (1U << 1)
+#define PCIE_SIM_STATUS_ERROR               (1U << 2)
+#define PCIE_SIM_STATUS_INTERRUPT_PENDING   (1U << 3)
+
+/* Control register bits */
+#define PCIE_SIM_CONTROL_DEVICE_ENABLE  (1U << 0)
+#define PCIE_SIM_CONTROL_DMA_START      (1U << 1)
+#define PCIE_SIM_CONTROL_DMA_RESET      (1U << 2)  /* Self-clearing */
+#define PCIE_SIM_CONTROL_IRQ_ENABLE     (1U << 3)
+
+/* DMA control register bits */
+#define PCIE_SIM_DMA_CONTROL_DIRECTION  (1U << 0)  /* 0=TO_DEVICE, 1=FROM_DEVICE */
+#define PCIE_SIM_DMA_CONTROL_ENABLE     (1U << 1)
+#define PCIE_SIM_DMA_CONTROL_INTERRUPT  (1U << 2)
+
+/* Interrupt status/enable bits */
+#define PCIE_SIM_IRQ_DMA_COMPLETE       (1U << 0)
+#define PCIE_SIM_IRQ_DMA_ERROR          (1U << 1)
+#define PCIE_SIM_IRQ_BUFFER_OVERRUN     (1U << 2)
+#define PCIE_SIM_IRQ_DEVICE_ERROR       (1U << 3)
+
+/* Error injection register: low byte is the fault rate (1 in N), 0 = off */
+#define PCIE_SIM_ERROR_INJECT_RATE_MASK 0xFFU
+
+/* Per-register access counters cover offsets 0x000-0x07C */
+#define PCIE_SIM_MMIO_TRACKED_REGS      32
+
+/* MMIO cost model flags */
+#define PCIE_SIM_MMIO_WRITE_COMBINE     (1U << 0)  /* Coalesce writes per 64-byte line */
+#define PCIE_SIM_MMIO_STALL             (1U << 1)  /* Busy-wait the modeled cost */
+#define PCIE_SIM_MMIO_TRACE             (1U << 2)  /* Record accesses in the trace */
+
+#endif /* PCIE_SIM_REGS_H */
@@ -0,0 +1,300 @@
+/*
+ * PCIe Simulator - Device Snapshot Format
+ *
+ * Copyright (c) 2025 Karan Mamaniya <kmamaniya@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Binary snapshot of simulated device state, shared by the kernel module
+ * and the userspace simulators.
+ */
+
+#ifndef PCIE_SIM_SNAPSHOT_H
+#define PCIE_SIM_SNAPSHOT_H
+
+/*
+ * Included by the kernel module as well as by userspace, so only
+ * fixed-width types and freestanding helpers are used here.
+ */
+#ifdef __KERNEL__
+#include <linux/types.h>
+#include <linux/string.h>
+#else
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#endif
+
+/*
+ * A snapshot is a header followed by sections. Each section is a type,
+ * a payload size and the payload, padded to 8 bytes. Readers skip
+ * section types they do not know and accept payloads shorter or longer
+ * than their own structures, so either side can grow a section.
+ */
+#define PCIE_SIM_SNAPSHOT_MAGIC     0x504E5350  /* "PSNP" */
+#define PCIE_SIM_SNAPSHOT_VERSION   1
+
+/* Largest snapshot a loader accepts: 32 rings of 64K descriptors plus slack */
+#define PCIE_SIM_SNAPSHOT_MAX_SIZE  (64U * 1024 * 1024)
+
+/* Section types */
+#define PCIE_SIM_SNAP_REGS          1   /* BAR0 words from offset 0, trailing zeros dropped */
+#define PCIE_SIM_SNAP_STATS         2   /* struct pcie_sim_snapshot_stats */
+#define PCIE_SIM_SNAP_ERROR         3   /* struct pcie_sim_snapshot_error */
+#define PCIE_SIM_SNAP_RNG           4   /* struct pcie_sim_snapshot_rng */
+#define PCIE_SIM_SNAP_MMIO          5   /* struct pcie_sim_snapshot_mmio */
+#define PCIE_SIM_SNAP_RING_CONFIG   6   /* struct pcie_sim_snapshot_ring_config */
+#define PCIE_SIM_SNAP_RING          7   /* struct pcie_sim_snapshot_ring, SQ, CQ */
+#define PCIE_SIM_SNAP_TRANSFER_STATS 8  /* struct pcie_sim_transfer_stats (stats.h) */
+#define PCIE_SIM_SNAP_LATENCY_SQ    9   /* struct pcie_sim_latency_sq (stats.h) */
+
+struct pcie_sim_snapshot_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;          /* Whole snapshot, header included */
+    uint32_t sections;
+    uint32_t checksum;      /* pcie_sim_snapshot_checksum() of everything after the header */
+    uint32_t reserved;
+};
+
+struct pcie_sim_snapshot_section {
+    uint32_t type;
+    uint32_t size;          /* Payload bytes, excluding padding */
+};
+
+/* Transfer statistics, same layout as struct pcie_sim_stats */
+struct pcie_sim_snapshot_stats {
+    uint64_t total_transfers;
+    uint64_t total_bytes;
+    uint64_t total_errors;
+    uint64_t avg_latency_ns;
+    uint64_t min_latency_ns;
+    uint64_t max_latency_ns;
+    uint64_t stddev_latency_ns;
+};
+
+/* Error injection configuration and progress */
+struct pcie_sim_snapshot_error {
+    uint32_t scenario;
+    uint32_t probability;           /* 0.01% units */
+    uint32_t recovery_time_ms;
+    uint32_t simulate_errors;
+    uint32_t fault_injection_rate;  /* 1 in N, from PCIE_SIM_REG_ERROR_INJECT */
+    uint32_t fault_counter;         /* DMAs counted toward the next fault */
+};
+
+/* Pseudo-random generator behind transfer jitter and fault decisions */
+struct pcie_sim_snapshot_rng {
+    uint32_t state[4];
+};
+
+/* MMIO cost model and counters */
+struct pcie_sim_snapshot_mmio {
+    uint32_t read_ns;
+    uint32_t write_ns;
+    uint32_t wc_flush_ns;
+    uint32_t flags;
+    uint64_t reads;
+    uint64_t writes;
+    uint64_t wc_coalesced;
+    uint64_t wc_flushes;
+    uint64_t read_cost_ns;
+    uint64_t write_cost_ns;
+    uint64_t doorbells;
+    uint64_t reg_reads[32];
+    uint64_t reg_writes[32];
+};
+
+struct pcie_sim_snapshot_ring_config {
+    uint32_t ring_size;
+    uint32_t num_rings;
+};
+
+/*
+ * One idle ring: every posted descriptor was completed and reaped, so
+ * the producer and consumer indices coincide. Followed by ring_size
+ * 16-byte SQ entries and ring_size 8-byte CQ entries; the CQ must be
+ * kept so stale entries keep their phase tags.
+ */
+struct pcie_sim_snapshot_ring {
+    uint32_t queue;
+    uint32_t direction;     /* 0 = TX, 1 = RX */
+    uint32_t head;          /* SQ index, also the device's tail */
+    uint32_t cq_tail;       /* CQ index, also the driver's head */
+    uint32_t cq_phase;      /* Phase tag of the next CQ entry */
+    uint32_t reserved;
+    uint64_t submissions;
+    uint64_t completions;
+    uint64_t overruns;
+    uint64_t doorbells;
+    uint64_t fetches;
+    uint64_t fetch_stalls;
+    uint64_t writebacks;
+    uint64_t fetch_cost_ns;
+    uint64_t writeback_cost_ns;
+    uint64_t reaped;
+};
+
+/* PCIE_SIM_IOC_SAVE_SNAPSHOT / PCIE_SIM_IOC_LOAD_SNAPSHOT argument */
+struct pcie_sim_snapshot_buf {
+    uint64_t data;          /* User buffer */
+    uint32_t size;          /* Buffer size */
+    uint32_t used;          /* Snapshot size; set on -ENOSPC too */
+};
+
+/*
+ * FNV-1a over a byte range
+ */
+static inline uint32_t pcie_sim_snapshot_checksum(const void *data, size_t len)
+{
+    const uint8_t *p = (const uint8_t *)data;
+    uint32_t hash = 2166136261U;
+
+    while (len--) {
+        hash ^= *p++;
+        hash *= 16777619U;
+    }
+    return hash;
+}
+
+/*
+ * Snapshot writer. With a NULL or short buffer nothing is written but
+ * used still grows, so a first pass can size the buffer.
+ */
+struct pcie_sim_snapshot_writer {
+    uint8_t *buf;
+    size_t size;
+    size_t used;
+    uint32_t sections;
+};
+
+static inline void pcie_sim_snapshot_begin(struct pcie_sim_snapshot_writer *w,
+                                           void *buf, size_t size)
+{
+    w->buf = (uint8_t *)buf;
+    w->size = buf ? size : 0;
+    w->used = sizeof(struct pcie_sim_snapshot_header);
+    w->sections = 0;
+}
+
+/*
+ * Append a section and return its zeroed payload to fill in, or NULL
+ * if it does not fit
+ */
+static inline void *pcie_sim_snapshot_add(struct pcie_sim_snapshot_writer *w,
+                                          uint32_t type, uint32_t len)
+{
+    size_t start = w->used;
+    size_t total = sizeof(struct pcie_sim_snapshot_section) + ((len + 7U) & ~7U);
+    struct pcie_sim_snapshot_section *s;
+
+    w->used += total;
+    w->sections++;
+    if (w->used > w->size)
+        return NULL;
+
+    memset(w->buf + start, 0, total);
+    s = (struct pcie_sim_snapshot_section *)(w->buf + start);
+    s->type = type;
+    s->size = len;
+    return s + 1;
+}
+
+/*
+ * Fill in the header. Returns the snapshot size; the snapshot is only
+ * complete if that is no larger than the buffer.
+ */
+static inline size_t pcie_sim_snapshot_end(struct pcie_sim_snapshot_writer *w)
+{
+    struct pcie_sim_snapshot_header *h = (struct pcie_sim_snapshot_header *)w->buf;
+
+    if (w->used <= w->size) {
+        h->magic = PCIE_SIM_SNAPSHOT_MAGIC;
+        h->version = PCIE_SIM_SNAPSHOT_VERSION;
+        h->size = (uint32_t)w->used;
+        h->sections = w->sections;
+        h->reserved = 0;
+        h->checksum = pcie_sim_snapshot_checksum(h + 1, w->used - sizeof(*h));
+    }
+    return w->used;
+}
+
+/*
+ * Check the header, checksum and section bounds. Returns 0 if valid.
+ */
+static inline int pcie_sim_snapshot_check(const void *buf, size_t size)
+{
+    const struct pcie_sim_snapshot_header *h = (const struct pcie_sim_snapshot_header *)buf;
+    size_t off = sizeof(*h);
+    uint32_t i;
+
+    if (size < sizeof(*h) || h->magic != PCIE_SIM_SNAPSHOT_MAGIC ||
+        h->version != PCIE_SIM_SNAPSHOT_VERSION || h->size != size ||
+        h->checksum != pcie_sim_snapshot_checksum(h + 1, size - sizeof(*h)))
+        return -1;
+
+    for (i = 0; i < h->sections; i++) {
+        const struct pcie_sim_snapshot_section *s;
+
+        if (size - off < sizeof(*s))
+            return -1;
+        s = (const struct pcie_sim_snapshot_section *)((const uint8_t *)buf + off);
+        off += sizeof(*s);
+        if (size - off < ((s->size + 7ULL) & ~7ULL))
+            return -1;
+        off += (s->size + 7U) & ~7U;
+    }
+
+    return off == size ? 0 : -1;
+}
+
+/*
+ * Iterate over the sections of a checked snapshot: pass NULL for the
+ * first. Returns NULL after the last.
+ */
+static inline const struct pcie_sim_snapshot_section *
+pcie_sim_snapshot_next(const void *buf, const struct pcie_sim_snapshot_section *prev)
+{
+    const struct pcie_sim_snapshot_header *h = (const struct pcie_sim_snapshot_header *)buf;
+    const uint8_t *next;
+
+    if (!prev)
+        next = (const uint8_t *)(h + 1);
+    else
+        next = (const uint8_t *)(prev + 1) + ((prev->size + 7U) & ~7U);
+
+    if (next >= (const uint8_t *)buf + h->size)
+        return NULL;
+    return (const struct pcie_sim_snapshot_section *)next;
+}
+
+/*
+ * Copy a section payload into a structure, zero-filling what the
+ * section does not cover
+ */
+static inline void pcie_sim_snapshot_copy(void *dst, size_t dst_size,
+                                          const struct pcie_sim_snapshot_section *s)
+{
+    size_t n = s->size < dst_size ? s->size : dst_size;
+
+    memcpy(dst, s + 1, n);
+    memset((uint8_t *)dst + n, 0, dst_size - n);
+}
+
+#endif /* PCIE_SIM_SNAPSHOT_H */
@@ -0,0 +1,668 @@
+/*
+ * PCIe Simulator - Statistics ABI
+ *
+ * Copyright (c) 2025 Karan Mamaniya <kmamaniya@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Transfer statistics shared by the kernel module, the library and the
+ * simulators: the summary returned by PCIE_SIM_IOC_GET_STATS and the
+ * versioned, extensible set returned by PCIE_SIM_IOC_GET_STATS_EX.
+ */
+
+#ifndef PCIE_SIM_STATS_H
+#define PCIE_SIM_STATS_H
+
+/*
+ * Included by the kernel module as well as by userspace, so only
+ * fixed-width types and freestanding helpers are used here.
+ */
+#ifdef __KERNEL__
+#include <linux/types.h>
+#include <linux/stddef.h>
+#include <linux/string.h>
+#include <linux/math64.h>
+#include <linux/compiler.h>
+#include <asm/barrier.h>
+#else
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#endif
+
+/* Summary statistics, the PCIE_SIM_IOC_GET_STATS layout */
+struct pcie_sim_stats {
+    uint64_t total_transfers;
+    uint64_t total_bytes;
+    uint64_t total_errors;
+    uint64_t avg_latency_ns;
+    uint64_t min_latency_ns;
+    uint64_t max_latency_ns;
+    uint64_t stddev_latency_ns;     /* Population standard deviation */
+};
+
+/*
+ * Extended statistics. The caller sets hdr.size to the size of its
+ * structure; the provider fills at most that much, and at most its own
+ * structure, and returns the bytes filled in hdr.size. Fields are only
+ * ever appended, so old callers keep working against new providers and
+ * new callers can tell from hdr.size which fields an old provider filled.
+ */
+#define PCIE_SIM_STATS_VERSION      4  /* 2: epochs, 3: transfer phases, 4: latency squares */
+
+#define PCIE_SIM_STATS_QUEUES       16  /* PCIE_SIM_MAX_QUEUES */
+#define PCIE_SIM_STATS_LAT_BUCKETS  32  /* Bucket i: [2^i, 2^(i+1)) ns, last open-ended */
+#define PCIE_SIM_STATS_SIZE_BUCKETS 24  /* Bucket i: [2^i, 2^(i+1)) bytes */
+
+/* Failed transfers by cause */
+#define PCIE_SIM_STATS_ERR_INVALID  0   /* Bad size, direction or buffer */
+#define PCIE_SIM_STATS_ERR_NOMEM    1   /* Bounce buffer or ring allocation failed */
+#define PCIE_SIM_STATS_ERR_FAULT    2   /* Copy to or from the caller's buffer failed */
+#define PCIE_SIM_STATS_ERR_BUSY     3   /* Submission ring full */
+#define PCIE_SIM_STATS_ERR_DEVICE   4   /* Device completed with an error status */
+#define PCIE_SIM_STATS_ERR_TIMEOUT  5   /* No completion in time */
+#define PCIE_SIM_STATS_ERR_TYPES    8
+
+/*
+ * Phases of a transfer, in the order it passes through them. A phase a
+ * backend does not have reads 0.
+ */
+#define PCIE_SIM_PHASE_ALLOC        0   /* Bounce buffer allocation */
+#define PCIE_SIM_PHASE_COPY_IN      1   /* Copy from the caller's buffer */
+#define PCIE_SIM_PHASE_QUEUE        2   /* Submitted until the device starts on it */
+#define PCIE_SIM_PHASE_WIRE         3   /* Device executing: data movement and modeled delay */
+#define PCIE_SIM_PHASE_COMPLETION   4   /* Device done until the submitter runs again */
+#define PCIE_SIM_PHASE_COPY_OUT     5   /* Copy to the caller's buffer */
+#define PCIE_SIM_PHASES             6
+
+struct pcie_sim_stats_header {
+    uint32_t size;          /* In: caller's structure size; out: bytes filled */
+    uint32_t version;       /* Out: PCIE_SIM_STATS_VERSION */
+};
+
+/* Completed transfers in one direction */
+struct pcie_sim_dir_stats {
+    uint64_t transfers;
+    uint64_t bytes;
+    uint64_t errors;
+    uint64_t latency_sum_ns;
+    uint64_t latency_min_ns;
+    uint64_t latency_max_ns;
+};
+
+/* Transfer counters as a device accumulates them */
+struct pcie_sim_transfer_stats {
+    struct pcie_sim_dir_stats dir[2];   /* 0 = to device, 1 = from device */
+    uint64_t errors[PCIE_SIM_STATS_ERR_TYPES];
+    uint64_t latency_hist[PCIE_SIM_STATS_LAT_BUCKETS];
+    uint64_t size_hist[PCIE_SIM_STATS_SIZE_BUCKETS];
+};
+
+/* Unsigned 128-bit value, low word first */
+struct pcie_sim_u128 {
+    uint64_t lo;
+    uint64_t hi;
+};
+
+/*
+ * Sums of squared latencies, which give the latency variance. They sit
+ * beside a struct pcie_sim_transfer_stats rather than in it because that
+ * layout is fixed inside struct pcie_sim_stats_ex.
+ */
+struct pcie_sim_latency_sq {
+    struct pcie_sim_u128 dir[2];        /* ns^2; 0 = to device, 1 = from device */
+};
+
+/* Time spent in one transfer phase */
+struct pcie_sim_phase_stats {
+    uint64_t count;
+    uint64_t sum_ns;
+    uint64_t max_ns;
+    uint64_t hist[PCIE_SIM_STATS_LAT_BUCKETS];   /* Same buckets as latency_hist */
+};
+
+/* One submission ring */
+struct pcie_sim_queue_stats {
+    uint64_t submissions;
+    uint64_t completions;
+    uint64_t overruns;      /* Submissions refused because the ring was full */
+    uint64_t doorbells;
+    uint32_t depth;         /* Descriptors in flight when sampled */
+    uint32_t reserved;
+};
+
+struct pcie_sim_stats_ex {
+    struct pcie_sim_stats_header hdr;
+    uint32_t num_queues;    /* Valid entries in tx and rx; 0 without rings */
+    uint32_t reserved;
+    struct pcie_sim_transfer_stats xfer;
+    struct pcie_sim_queue_stats tx[PCIE_SIM_STATS_QUEUES];
+    struct pcie_sim_queue_stats rx[PCIE_SIM_STATS_QUEUES];
+
+    /* Version 2 */
+    uint64_t epoch;         /* Out: current epoch; every reset starts the next */
+    uint64_t since_epoch;   /* In: first epoch xfer covers, 0 = current; out: as used */
+    struct pcie_sim_transfer_stats prev;    /* Out: final counters of epoch - 1 */
+
+    /* Version 3 */
+    struct pcie_sim_phase_stats phases[PCIE_SIM_PHASES];    /* Current epoch */
+
+    /* Version 4 */
+    struct pcie_sim_latency_sq latency_sq;      /* Out: for xfer */
+    struct pcie_sim_latency_sq prev_latency_sq; /* Out: for prev */
+};
+
+/*
+ * Epochs. A device starts in epoch 1. A reset retires the current
+ * counters as the previous epoch's final values and starts the next
+ * epoch from zero, in one step under the device's statistics lock, so no
+ * transfer is lost or counted in both. A reader that noted the epoch when
+ * its measurement window began can still read the whole window after one
+ * concurrent reset.
+ */
+#define PCIE_SIM_STATS_FIRST_EPOCH  1
+
+/*
+ * Counter page. Each device publishes its current-epoch counters in one
+ * read-only page that monitors map and sample without a system call or a
+ * lock: mmap() offset 0 of /dev/pcie_simN, or pcie_sim_stats_map() in the
+ * library. The producer bumps seq to odd before it changes the page and
+ * back to even after, so a reader retries while seq is odd or changed
+ * under it (pcie_sim_stats_page_read()).
+ */
+#define PCIE_SIM_STATS_PAGE_MAGIC   0x50535047  /* "PSPG" */
+#define PCIE_SIM_STATS_PAGE_SIZE    4096
+
+struct pcie_sim_stats_page {
+    uint32_t magic;
+    uint32_t version;       /* PCIE_SIM_STATS_VERSION */
+    uint32_t seq;           /* Odd while an update is in progress */
+    uint32_t reserved;
+    uint64_t epoch;
+    struct pcie_sim_transfer_stats xfer;    /* Current epoch */
+    struct pcie_sim_latency_sq latency_sq;  /* Current epoch */
+};
+
+/*
+ * Histogram bucket of a value: floor(log2(value)), clamped to the last
+ * bucket. 0 and 1 both land in bucket 0.
+ */
+static inline unsigned int pcie_sim_stats_bucket(uint64_t value, unsigned int buckets)
+{
+    unsigned int b = 0;
+
+    while (value > 1 && b < buckets - 1) {
+        value >>= 1;
+        b++;
+    }
+    return b;
+}
+
+/*
+ * 128-bit arithmetic for the squared latencies. Sums of squares overflow
+ * 64 bits once latencies reach seconds, and the kernel has neither
+ * floating point nor a portable 128-bit type.
+ */
+static inline struct pcie_sim_u128 pcie_sim_u128_mul(uint64_t a, uint64_t b)
+{
+    uint64_t a_lo = (uint32_t)a, a_hi = a >> 32;
+    uint64_t b_lo = (uint32_t)b, b_hi = b >> 32;
+    uint64_t p0 = a_lo * b_lo, p1 = a_lo * b_hi, p2 = a_hi * b_lo;
+    uint64_t mid = (p0 >> 32) + (uint32_t)p1 + (uint32_t)p2;
+    struct pcie_sim_u128 r;
+
+    r.lo = (mid << 32) | (uint32_t)p0;
+    r.hi = a_hi * b_hi + (p1 >> 32) + (p2 >> 32) + (mid >> 32);
+    return r;
+}
+
+static inline void pcie_sim_u128_add(struct pcie_sim_u128 *a, struct pcie_sim_u128 b)
+{
+    a->lo += b.lo;
+    a->hi += b.hi + (a->lo < b.lo);
+}
+
+/* a - b, or 0 if b is larger */
+static inline struct pcie_sim_u128 pcie_sim_u128_sub(struct pcie_sim_u128 a, struct pcie_sim_u128 b)
+{
+    struct pcie_sim_u128 r = { 0, 0 };
+
+    if (a.hi > b.hi || (a.hi == b.hi && a.lo >= b.lo)) {
+        r.lo = a.lo - b.lo;
+        r.hi = a.hi - b.hi - (a.lo < b.lo);
+    }
+    return r;
+}
+
+/* a * b, keeping the low 128 bits */
+static inline struct pcie_sim_u128 pcie_sim_u128_scale(struct pcie_sim_u128 a, uint64_t b)
+{
+    struct pcie_sim_u128 r = pcie_sim_u128_mul(a.lo, b);
+
+    r.hi += a.hi * b;
+    return r;
+}
+
+/* a <= b */
+static inline int pcie_sim_u128_le(struct pcie_sim_u128 a, struct pcie_sim_u128 b)
+{
+    return a.hi < b.hi || (a.hi == b.hi && a.lo <= b.lo);
+}
+
+/* a / d, full 128-bit quotient */
+static inline struct pcie_sim_u128 pcie_sim_u128_divq(struct pcie_sim_u128 a, uint64_t d)
+{
+    struct pcie_sim_u128 q;
+    uint64_t rem;
+    int i;
+
+    /* High word first; the remainder, below d, carries into the low word */
+#ifdef __KERNEL__
+    q.hi = div64_u64_rem(a.hi, d, &rem);
+#else
+    q.hi = a.hi / d;
+    rem = a.hi % d;
+#endif
+    q.lo = 0;
+    for (i = 63; i >= 0; i--) {
+        uint64_t carry = rem >> 63;
+
+        rem = (rem << 1) | ((a.lo >> i) & 1);
+        q.lo <<= 1;
+        if (carry || rem >= d) {
+            rem -= d;
+            q.lo |= 1;
+        }
+    }
+    return q;
+}
+
+/* a / d, saturated to 64 bits */
+static inline uint64_t pcie_sim_u128_div(struct pcie_sim_u128 a, uint64_t d)
+{
+    struct pcie_sim_u128 q = pcie_sim_u128_divq(a, d);
+
+    return q.hi ? ~0ULL : q.lo;
+}
+
+static inline uint64_t pcie_sim_isqrt(uint64_t v)
+{
+    uint64_t r = 0, bit = 1ULL << 62;
+
+    while (bit > v)
+        bit >>= 2;
+    while (bit) {
+        if (v >= r + bit) {
+            v -= r + bit;
+            r = (r >> 1) + bit;
+        } else {
+            r >>= 1;
+        }
+        bit >>= 2;
+    }
+    return r;
+}
+
+/* floor(sqrt(v)) of a 128-bit value, which always fits in 64 bits */
+static inline uint64_t pcie_sim_u128_isqrt(struct pcie_sim_u128 v)
+{
+    uint64_t r = 0;
+    int i;
+
+    if (!v.hi)
+        return pcie_sim_isqrt(v.lo);
+
+    /* Set result bits from the top while the square stays within v */
+    for (i = 63; i >= 0; i--) {
+        uint64_t t = r | (1ULL << i);
+
+        if (pcie_sim_u128_le(pcie_sim_u128_mul(t, t), v))
+            r = t;
+    }
+    return r;
+}
+
+/*
+ * Population standard deviation of n latencies summing to sum, whose
+ * squares sum to sq. Taking the squares about q = sum / n keeps the
+ * arithmetic exact: sum((x - q)^2) = sq - q * (sum + sum % n), and that
+ * over n is the variance to within 1 ns^2.
+ */
+static inline uint64_t pcie_sim_stats_stddev(uint64_t sum, uint64_t n, struct pcie_sim_u128 sq)
+{
+    struct pcie_sim_u128 shift;
+    uint64_t q, r;
+
+    if (n < 2)
+        return 0;
+
+#ifdef __KERNEL__
+    q = div64_u64_rem(sum, n, &r);
+#else
+    q = sum / n;
+    r = sum % n;
+#endif
+    shift = pcie_sim_u128_mul(q, sum);
+    pcie_sim_u128_add(&shift, pcie_sim_u128_mul(q, r));
+    return pcie_sim_u128_isqrt(pcie_sim_u128_divq(pcie_sim_u128_sub(sq, shift), n));
+}
+
+/*
+ * Count a completed transfer
+ */
+static inline void pcie_sim_stats_account(struct pcie_sim_transfer_stats *s, uint32_t dir,
+                                          uint64_t bytes, uint64_t latency_ns)
+{
+    struct pcie_sim_dir_stats *d = &s->dir[dir & 1];
+
+    d->transfers++;
+    d->bytes += bytes;
+    d->latency_sum_ns += latency_ns;
+    if (d->transfers == 1 || latency_ns < d->latency_min_ns)
+        d->latency_min_ns = latency_ns;
+    if (latency_ns > d->latency_max_ns)
+        d->latency_max_ns = latency_ns;
+
+    s->latency_hist[pcie_sim_stats_bucket(latency_ns, PCIE_SIM_STATS_LAT_BUCKETS)]++;
+    s->size_hist[pcie_sim_stats_bucket(bytes, PCIE_SIM_STATS_SIZE_BUCKETS)]++;
+}
+
+/*
+ * Count the squared latency of a completed transfer
+ */
+static inline void pcie_sim_stats_account_sq(struct pcie_sim_latency_sq *sq, uint32_t dir,
+                                             uint64_t latency_ns)
+{
+    pcie_sim_u128_add(&sq->dir[dir & 1], pcie_sim_u128_mul(latency_ns, latency_ns));
+}
+
+/*
+ * Count a completed transfer on a counter page; callers bracket it with
+ * pcie_sim_stats_page_begin() and pcie_sim_stats_page_end()
+ */
+static inline void pcie_sim_stats_page_account(struct pcie_sim_stats_page *p, uint32_t dir,
+                                               uint64_t bytes, uint64_t latency_ns)
+{
+    pcie_sim_stats_account(&p->xfer, dir, bytes, latency_ns);
+    pcie_sim_stats_account_sq(&p->latency_sq, dir, latency_ns);
+}
+
+/*
+ * Count the phase times of a completed transfer
+ */
+static inline void pcie_sim_stats_phases(struct pcie_sim_phase_stats *p, const uint64_t *phase_ns)
+{
+    unsigned int i;
+
+    for (i = 0; i < PCIE_SIM_PHASES; i++) {
+        p[i].count++;
+        p[i].sum_ns += phase_ns[i];
+        if (phase_ns[i] > p[i].max_ns)
+            p[i].max_ns = phase_ns[i];
+        p[i].hist[pcie_sim_stats_bucket(phase_ns[i], PCIE_SIM_STATS_LAT_BUCKETS)]++;
+    }
+}
+
+/*
+ * Nanoseconds from a to b, or 0 if modeled costs put a after b
+ */
+static inline uint64_t pcie_sim_phase_ns(uint64_t a, uint64_t b)
+{
+    return b > a ? b - a : 0;
+}
+
+/*
+ * Count a failed transfer; a request rejected for a bad direction has none
+ */
+static inline void pcie_sim_stats_error(struct pcie_sim_transfer_stats *s, uint32_t dir,
+                                        unsigned int type)
+{
+    if (dir <= 1)
+        s->dir[dir].errors++;
+    s->errors[type < PCIE_SIM_STATS_ERR_TYPES ? type : PCIE_SIM_STATS_ERR_DEVICE]++;
+}
+
+/*
+ * Reduce the counters to the summary statistics
+ */
+static inline void pcie_sim_stats_summary(const struct pcie_sim_transfer_stats *s,
+                                          const struct pcie_sim_latency_sq *sq,
+                                          struct pcie_sim_stats *out)
+{
+    struct pcie_sim_u128 latency_sq = { 0, 0 };
+    uint64_t latency_sum = 0;
+    unsigned int i;
+
+    memset(out, 0, sizeof(*out));
+
+    for (i = 0; i < 2; i++) {
+        const struct pcie_sim_dir_stats *d = &s->dir[i];
+
+        if (!d->transfers)
+            continue;
+        if (!out->total_transfers || d->latency_min_ns < out->min_latency_ns)
+            out->min_latency_ns = d->latency_min_ns;
+        if (d->latency_max_ns > out->max_latency_ns)
+            out->max_latency_ns = d->latency_max_ns;
+        out->total_transfers += d->transfers;
+        out->total_bytes += d->bytes;
+        latency_sum += d->latency_sum_ns;
+        if (sq)
+            pcie_sim_u128_add(&latency_sq, sq->dir[i]);
+    }
+
+    for (i = 0; i < PCIE_SIM_STATS_ERR_TYPES; i++)
+        out->total_errors += s->errors[i];
+
+    if (out->total_transfers) {
+#ifdef __KERNEL__
+        out->avg_latency_ns = div64_u64(latency_sum, out->total_transfers);
+#else
+        out->avg_latency_ns = latency_sum / out->total_transfers;
+#endif
+        if (sq)
+            out->stddev_latency_ns = pcie_sim_stats_stddev(latency_sum, out->total_transfers,
+                                                           latency_sq);
+    }
+}
+
+/*
+ * Rebuild counters from summary statistics, for snapshots that carry only
+ * those. Transfers are credited to the to-device direction and errors to
+ * the device; the histograms start empty. The squares are rebuilt from the
+ * mean and standard deviation: n * (avg^2 + stddev^2).
+ */
+static inline void pcie_sim_stats_from_summary(struct pcie_sim_transfer_stats *s,
+                                               struct pcie_sim_latency_sq *sq,
+                                               const struct pcie_sim_stats *in)
+{
+    struct pcie_sim_u128 mean_sq = pcie_sim_u128_mul(in->avg_latency_ns, in->avg_latency_ns);
+    struct pcie_sim_u128 sum = pcie_sim_u128_mul(in->avg_latency_ns, in->total_transfers);
+
+    memset(s, 0, sizeof(*s));
+    memset(sq, 0, sizeof(*sq));
+    pcie_sim_u128_add(&mean_sq, pcie_sim_u128_mul(in->stddev_latency_ns, in->stddev_latency_ns));
+    sq->dir[0] = pcie_sim_u128_scale(mean_sq, in->total_transfers);
+    s->dir[0].transfers = in->total_transfers;
+    s->dir[0].bytes = in->total_bytes;
+    s->dir[0].latency_sum_ns = sum.hi ? ~0ULL : sum.lo;
+    s->dir[0].latency_min_ns = in->min_latency_ns;
+    s->dir[0].latency_max_ns = in->max_latency_ns;
+    s->errors[PCIE_SIM_STATS_ERR_DEVICE] = in->total_errors;
+}
+
+/*
+ * Add the counters of src to dst
+ */
+static inline void pcie_sim_stats_merge(struct pcie_sim_transfer_stats *dst,
+                                        const struct pcie_sim_transfer_stats *src)
+{
+    unsigned int i;
+
+    for (i = 0; i < 2; i++) {
+        struct pcie_sim_dir_stats *d = &dst->dir[i];
+        const struct pcie_sim_dir_stats *s = &src->dir[i];
+
+        if (s->transfers && (!d->transfers || s->latency_min_ns < d->latency_min_ns))
+            d->latency_min_ns = s->latency_min_ns;
+        if (s->latency_max_ns > d->latency_max_ns)
+            d->latency_max_ns = s->latency_max_ns;
+        d->transfers += s->transfers;
+        d->bytes += s->bytes;
+        d->errors += s->errors;
+        d->latency_sum_ns += s->latency_sum_ns;
+    }
+    for (i = 0; i < PCIE_SIM_STATS_ERR_TYPES; i++)
+        dst->errors[i] += src->errors[i];
+    for (i = 0; i < PCIE_SIM_STATS_LAT_BUCKETS; i++)
+        dst->latency_hist[i] += src->latency_hist[i];
+    for (i = 0; i < PCIE_SIM_STATS_SIZE_BUCKETS; i++)
+        dst->size_hist[i] += src->size_hist[i];
+}
+
+/*
+ * Retire the current counters of a page into prev and start the next epoch
+ */
+static inline void pcie_sim_stats_new_epoch(struct pcie_sim_stats_page *p,
+                                            struct pcie_sim_transfer_stats *prev,
+                                            struct pcie_sim_latency_sq *prev_sq)
+{
+    *prev = p->xfer;
+    *prev_sq = p->latency_sq;
+    memset(&p->xfer, 0, sizeof(p->xfer));
+    memset(&p->latency_sq, 0, sizeof(p->latency_sq));
+    p->epoch++;
+}
+
+/*
+ * Counters accumulated since the start of epoch since (0 = the current
+ * one). Returns 0, or -1 if since is older than the previous epoch, whose
+ * predecessors are gone, or newer than the current one.
+ */
+static inline int pcie_sim_stats_since(const struct pcie_sim_stats_page *p,
+                                       const struct pcie_sim_transfer_stats *prev,
+                                       const struct pcie_sim_latency_sq *prev_sq,
+                                       uint64_t since, struct pcie_sim_transfer_stats *out,
+                                       struct pcie_sim_latency_sq *out_sq)
+{
+    unsigned int i;
+
+    if (!since || since == p->epoch) {
+        *out = p->xfer;
+        *out_sq = p->latency_sq;
+        return 0;
+    }
+    if (since + 1 != p->epoch)
+        return -1;
+
+    *out = *prev;
+    pcie_sim_stats_merge(out, &p->xfer);
+    *out_sq = *prev_sq;
+    for (i = 0; i < 2; i++)
+        pcie_sim_u128_add(&out_sq->dir[i], p->latency_sq.dir[i]);
+    return 0;
+}
+
+/*
+ * The since_epoch of a caller that provides size bytes, or 0 if its
+ * structure predates the field
+ */
+static inline uint64_t pcie_sim_stats_ex_since(const struct pcie_sim_stats_ex *ex, uint32_t size)
+{
+    return size >= offsetof(struct pcie_sim_stats_ex, since_epoch) + sizeof(ex->since_epoch) ?
+           ex->since_epoch : 0;
+}
+
+/*
+ * Writer side of the counter page. Writers are serialized by the
+ * device's statistics lock; these only order the page against readers.
+ */
+static inline void pcie_sim_stats_page_init(struct pcie_sim_stats_page *p)
+{
+    memset(p, 0, sizeof(*p));
+    p->magic = PCIE_SIM_STATS_PAGE_MAGIC;
+    p->version = PCIE_SIM_STATS_VERSION;
+    p->epoch = PCIE_SIM_STATS_FIRST_EPOCH;
+}
+
+static inline void pcie_sim_stats_page_begin(struct pcie_sim_stats_page *p)
+{
+#ifdef __KERNEL__
+    WRITE_ONCE(p->seq, p->seq + 1);
+    smp_wmb();
+#else
+    __atomic_store_n(&p->seq, p->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+#endif
+}
+
+static inline void pcie_sim_stats_page_end(struct pcie_sim_stats_page *p)
+{
+#ifdef __KERNEL__
+    smp_wmb();
+    WRITE_ONCE(p->seq, p->seq + 1);
+#else
+    __atomic_store_n(&p->seq, p->seq + 1, __ATOMIC_RELEASE);
+#endif
+}
+
+#ifndef __KERNEL__
+/*
+ * Copy a consistent set of counters, and their squared latencies if sq is
+ * not NULL, out of a mapped counter page. Returns the epoch they belong
+ * to, or 0 if the page is not a counter page.
+ */
+static inline uint64_t pcie_sim_stats_page_read(const struct pcie_sim_stats_page *p,
+                                                struct pcie_sim_transfer_stats *out,
+                                                struct pcie_sim_latency_sq *sq)
+{
+    uint32_t seq;
+    uint64_t epoch;
+
+    if (p->magic != PCIE_SIM_STATS_PAGE_MAGIC)
+        return 0;
+
+    for (;;) {
+        seq = __atomic_load_n(&p->seq, __ATOMIC_ACQUIRE);
+        if (seq & 1)
+            continue;
+        memcpy(out, (const void *)&p->xfer, sizeof(*out));
+        if (sq)
+            memcpy(sq, (const void *)&p->latency_sq, sizeof(*sq));
+        epoch = p->epoch;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&p->seq, __ATOMIC_RELAXED) == seq)
+            return epoch;
+    }
+}
+#endif
+
+/*
+ * Bytes of a complete structure to hand to a caller that provides
+ * requested bytes, or 0 if that cannot even hold the header
+ */
+static inline uint32_t pcie_sim_stats_ex_size(uint32_t requested)
+{
+    if (requested < sizeof(struct pcie_sim_stats_header))
+        return 0;
+    return requested < sizeof(struct pcie_sim_stats_ex) ?
+           requested : (uint32_t)sizeof(struct pcie_sim_stats_ex);
+}
+
+#endif /* PCIE_SIM_STATS_H */
@@ -30,6 +30,9 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <sys/types.h>
+#include "regs.h"
+#include "snapshot.h"
+#include "stats.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -52,14 +55,55 @@ typedef struct pcie_sim_handle *pcie_sim_handle_t;
 #define PCIE_SIM_TO_DEVICE   0
 #define PCIE_SIM_FROM_DEVICE 1
 
-/* Device statistics structure */
-struct pcie_sim_stats {
-    uint64_t total_transfers;
+/* Default costs: ~1 us read round trip, cheap posted writes */
+#define PCIE_SIM_MMIO_DEFAULT_READ_NS     1000
+#define PCIE_SIM_MMIO_DEFAULT_WRITE_NS    50
+#define PCIE_SIM_MMIO_DEFAULT_WC_FLUSH_NS 50
+
+/* MMIO cost model; costs are charged to the accessing thread */
+struct pcie_sim_mmio_config {
+    uint32_t read_ns;       /* Uncached read round trip */
+    uint32_t write_ns;      /* Posted write */
+    uint32_t wc_flush_ns;   /* Write-combining buffer flush (one TLP) */
+    uint32_t flags;         /* PCIE_SIM_MMIO_* */
+};
+
+/* MMIO access counters */
+struct pcie_sim_mmio_stats {
+    uint64_t reads;
+    uint64_t writes;
+    uint64_t wc_coalesced;  /* Writes merged into a pending WC line */
+    uint64_t wc_flushes;
+    uint64_t read_cost_ns;
+    uint64_t write_cost_ns; /* Posted writes plus WC flushes */
+    uint64_t doorbells;     /* Writes to the TX/RX tail doorbells */
+    uint64_t reg_reads[PCIE_SIM_MMIO_TRACKED_REGS];
+    uint64_t reg_writes[PCIE_SIM_MMIO_TRACKED_REGS];
+};
+
+/*
+ * Memory held by a device, by subsystem. Each field counts memory the
+ * others do not, so total_bytes is their sum (bounce_peak_bytes excluded).
+ * Backends report zero for subsystems they do not model.
+ */
+struct pcie_sim_memory_stats {
     uint64_t total_bytes;
-    uint64_t total_errors;
-    uint64_t avg_latency_ns;
-    uint64_t min_latency_ns;
-    uint64_t max_latency_ns;
+    uint64_t device_bytes;      /* Device state, less the counters below */
+    uint64_t bar_bytes;         /* BAR0 register file */
+    uint64_t ring_bytes;        /* Descriptor queues and slot arrays */
+    uint64_t bounce_bytes;      /* Transfer bounce buffers in use */
+    uint64_t bounce_peak_bytes; /* Most bounce_bytes seen */
+    uint64_t stats_bytes;       /* Statistics, MMIO counters and trace */
+    uint64_t engine_bytes;      /* Device engine thread stacks */
+};
+
+/* One recorded register access */
+struct pcie_sim_mmio_trace_entry {
+    uint64_t timestamp_ns;
+    uint32_t offset;
+    uint32_t value;
+    uint32_t is_write;
+    uint32_t cost_ns;
 };
 
 /* IOCTL definitions (must match kernel) */
@@ -76,6 +120,36 @@ struct pcie_sim_transfer_req {
 #define PCIE_SIM_IOC_GET_STATS   _IOR(PCIE_SIM_IOC_MAGIC, 2, struct pcie_sim_stats)
 #define PCIE_SIM_IOC_RESET_STATS _IO(PCIE_SIM_IOC_MAGIC, 3)
 
+/* Extended statistics; the argument is a struct pcie_sim_stats_ex, see stats.h */
+#define PCIE_SIM_IOC_GET_STATS_EX _IOWR(PCIE_SIM_IOC_MAGIC, 10, struct pcie_sim_stats_header)
+#define PCIE_SIM_IOC_RESET_STATS_EPOCH _IOR(PCIE_SIM_IOC_MAGIC, 11, uint64_t)
+
+/* Transfer that also returns the time spent in each PCIE_SIM_PHASE_* */
+struct pcie_sim_transfer_req_ex {
+    struct pcie_sim_transfer_req req;
+    uint64_t phase_ns[PCIE_SIM_PHASES];
+};
+
+#define PCIE_SIM_IOC_TRANSFER_EX _IOWR(PCIE_SIM_IOC_MAGIC, 12, struct pcie_sim_transfer_req_ex)
+
+/* Ring geometry; ring_size is a power of two */
+#define PCIE_SIM_RING_MIN_SIZE 8
+#define PCIE_SIM_RING_MAX_SIZE 65536
+
+struct pcie_sim_ring_config {
+    uint32_t ring_size;     /* Descriptors per ring */
+    uint32_t num_rings;     /* Rings per direction, 1-PCIE_SIM_MAX_QUEUES */
+};
+
+#define PCIE_SIM_IOC_SET_RING_CONFIG _IOW(PCIE_SIM_IOC_MAGIC, 5, struct pcie_sim_ring_config)
+#define PCIE_SIM_IOC_GET_RING_CONFIG _IOR(PCIE_SIM_IOC_MAGIC, 6, struct pcie_sim_ring_config)
+
+/* Snapshot save/load; the buffer holds the format of snapshot.h */
+#define PCIE_SIM_IOC_SAVE_SNAPSHOT _IOWR(PCIE_SIM_IOC_MAGIC, 7, struct pcie_sim_snapshot_buf)
+#define PCIE_SIM_IOC_LOAD_SNAPSHOT _IOW(PCIE_SIM_IOC_MAGIC, 8, struct pcie_sim_snapshot_buf)
+
+#define PCIE_SIM_IOC_GET_MEMORY_STATS _IOR(PCIE_SIM_IOC_MAGIC, 9, struct pcie_sim_memory_stats)
+
 #ifdef __cplusplus
 }
 #endif
@@ -28,6 +28,10 @@
 #ifndef _WIN32
 
 #include "../lib/api.h"
+#include "../lib/backend.h"
+#include "simd.h"
+#include "mmio_sim.h"
+#include "../lib/clock.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -37,21 +41,52 @@
 #include <sys/ioctl.h>
 #include <time.h>
 #include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 /* Maximum number of simulated devices */
 #define MAX_DEVICES 8
 
+/* Shared-memory segment layout, selected with PCIE_SIM_SHM=<name> */
+#define LINUX_SIM_SHM_ENV        "PCIE_SIM_SHM"
+#define LINUX_SIM_SHM_MAGIC      0x50534853  /* "PSHS" */
+#define LINUX_SIM_SHM_VERSION    8
+#define LINUX_SIM_SHM_TIMEOUT_MS 2000
+#define LINUX_SIM_SHM_TRIES      3
+
 /* Simulated device state for Linux */
 struct linux_device_state {
     int active;
     pthread_mutex_t mutex;
-    struct pcie_sim_stats stats;
+    struct pcie_sim_stats_page stats;           /* Current epoch, read lock-free too */
+    struct pcie_sim_transfer_stats stats_prev;  /* Final counters of epoch - 1 */
+    struct pcie_sim_latency_sq stats_prev_sq;
+    struct pcie_sim_phase_stats phases[PCIE_SIM_PHASES];    /* Current epoch */
     struct timespec start_time;
     char device_name[64];
+    pthread_mutex_t mmio_mutex;     /* Serializes BAR0 accesses; taken before mutex */
+    struct pcie_sim_bar0 bar0;
+};
+
+/* Device table as mapped by every process sharing a segment */
+struct linux_sim_shm_region {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t region_size;
+    uint32_t ready;         /* Published last by the creating process */
+    pthread_mutex_t attach_mutex;
+    uint32_t attached;      /* Processes mapping the segment */
+    uint32_t unlinked;      /* The last process has removed its name */
+    struct linux_device_state devices[MAX_DEVICES];
 };
 
 /* Global simulation state */
-static struct linux_device_state g_sim_devices[MAX_DEVICES];
+static struct linux_device_state g_local_devices[MAX_DEVICES];
+static struct linux_device_state *g_sim_devices = g_local_devices;
+static struct linux_sim_shm_region *g_shm_region = NULL;
+static char g_shm_name[256];
+static pid_t g_shm_pid;         /* Attached process; forked children are not */
+static int g_sim_shared = 0;
 static int g_sim_initialized = 0;
 static pthread_mutex_t g_init_mutex = PTHREAD_MUTEX_INITIALIZER;
 
@@ -60,52 +95,234 @@ struct pcie_sim_handle {
     int fd;
     int device_id;
     int is_simulation;
+    struct simd_client *remote;     /* Set when the device lives in pcie_simd */
 };
 
 /*
- * Initialize Linux simulation system
+ * Initialize a device mutex, process-shared and robust for shared segments
  */
-static void linux_sim_init(void)
+static int linux_sim_mutex_init(pthread_mutex_t *mutex, int shared)
 {
-    pthread_mutex_lock(&g_init_mutex);
+    pthread_mutexattr_t attr;
+    int ret;
 
-    if (!g_sim_initialized) {
-        /* Initialize all device mutexes */
+    pthread_mutexattr_init(&attr);
+    if (shared) {
+        pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+        pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+    }
+    ret = pthread_mutex_init(mutex, &attr);
+    pthread_mutexattr_destroy(&attr);
+
+    return ret;
+}
+
+/*
+ * Lock a mutex; recovers the lock if its owner process died holding it
+ */
+static void linux_sim_mutex_lock(pthread_mutex_t *mutex)
+{
+    /* The dead owner may have left a counter update half done, but the
+     * stats stay usable, so mark the mutex consistent and carry on */
+    if (pthread_mutex_lock(mutex) == EOWNERDEAD)
+        pthread_mutex_consistent(mutex);
+}
+
+static void linux_sim_lock(struct linux_device_state *dev)
+{
+    linux_sim_mutex_lock(&dev->mutex);
+}
+
+static void linux_sim_unlock(struct linux_device_state *dev)
+{
+    pthread_mutex_unlock(&dev->mutex);
+}
+
+static void linux_sim_sleep_ms(unsigned int ms)
+{
+    struct timespec ts = { ms / 1000, (long)(ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+}
+
+/*
+ * Map (creating if needed) the shared device table called name. Sets
+ * *creator when this process created and initialized it.
+ */
+static struct linux_sim_shm_region *linux_sim_shm_map(const char *name, int *creator)
+{
+    struct linux_sim_shm_region *region;
+    const size_t size = sizeof(*region);
+    struct stat st;
+    unsigned int waited_ms = 0;
+    int fd;
+
+    /* Owner-only: the segment holds device state other users must not touch */
+    *creator = 1;
+    fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0 && errno == EEXIST) {
+        *creator = 0;
+        fd = shm_open(name, O_RDWR, 0);
+    }
+    if (fd < 0) {
+        fprintf(stderr, "pcie_sim: shm_open(%s) failed: %s\n", name, strerror(errno));
+        return NULL;
+    }
+
+    if (*creator) {
+        if (ftruncate(fd, size) != 0) {
+            fprintf(stderr, "pcie_sim: ftruncate(%s) failed: %s\n", name, strerror(errno));
+            close(fd);
+            shm_unlink(name);
+            return NULL;
+        }
+    } else {
+        /* The creator may not have sized the segment yet */
+        while (fstat(fd, &st) == 0 && (size_t)st.st_size < size) {
+            if (waited_ms >= LINUX_SIM_SHM_TIMEOUT_MS) {
+                fprintf(stderr, "pcie_sim: %s is smaller than expected; remove /dev/shm%s\n",
+                        name, name);
+                close(fd);
+                return NULL;
+            }
+            linux_sim_sleep_ms(1);
+            waited_ms++;
+        }
+    }
+
+    region = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (region == MAP_FAILED) {
+        fprintf(stderr, "pcie_sim: mmap(%s) failed: %s\n", name, strerror(errno));
+        return NULL;
+    }
+
+    if (*creator) {
+        linux_sim_mutex_init(&region->attach_mutex, 1);
+        region->attached = 1;
+        region->unlinked = 0;
         for (int i = 0; i < MAX_DEVICES; i++) {
-            pthread_mutex_init(&g_sim_devices[i].mutex, NULL);
-            g_sim_devices[i].active = 0;
+            linux_sim_mutex_init(&region->devices[i].mutex, 1);
+            linux_sim_mutex_init(&region->devices[i].mmio_mutex, 1);
+            region->devices[i].active = 0;
+        }
+        region->magic = LINUX_SIM_SHM_MAGIC;
+        region->version = LINUX_SIM_SHM_VERSION;
+        region->region_size = (uint32_t)size;
+        __atomic_store_n(&region->ready, 1, __ATOMIC_RELEASE);
+    } else {
+        while (!__atomic_load_n(&region->ready, __ATOMIC_ACQUIRE)) {
+            if (waited_ms >= LINUX_SIM_SHM_TIMEOUT_MS) {
+                fprintf(stderr, "pcie_sim: %s was never initialized; remove /dev/shm%s\n",
+                        name, name);
+                munmap(region, size);
+                return NULL;
+            }
+            linux_sim_sleep_ms(1);
+            waited_ms++;
+        }
+
+        if (region->magic != LINUX_SIM_SHM_MAGIC ||
+            region->version != LINUX_SIM_SHM_VERSION ||
+            region->region_size != size) {
+            fprintf(stderr, "pcie_sim: %s has an incompatible layout\n", name);
+            munmap(region, size);
+            return NULL;
         }
-        g_sim_initialized = 1;
     }
 
-    pthread_mutex_unlock(&g_init_mutex);
+    return region;
+}
+
+/*
+ * Drop this process's attachment at exit. The last process to detach
+ * removes the name, so the segment goes away with its last user and a
+ * layout change does not find a stale one.
+ */
+static void linux_sim_shm_detach(void)
+{
+    struct linux_sim_shm_region *region = g_shm_region;
+
+    if (!region || getpid() != g_shm_pid)
+        return;
+
+    linux_sim_mutex_lock(&region->attach_mutex);
+    if (--region->attached == 0) {
+        region->unlinked = 1;
+        shm_unlink(g_shm_name);
+    }
+    pthread_mutex_unlock(&region->attach_mutex);
 }
 
 /*
- * Get high-resolution timestamp in nanoseconds
+ * Attach to the shared device table named by PCIE_SIM_SHM
  */
-static uint64_t linux_sim_get_time_ns(void)
+static int linux_sim_shm_attach(const char *env_name)
 {
-    struct timespec ts;
-    clock_gettime(CLOCK_MONOTONIC, &ts);
-    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+    struct linux_sim_shm_region *region = NULL;
+    int creator, gone, tries;
+
+    /* POSIX shm names start with a single slash */
+    snprintf(g_shm_name, sizeof(g_shm_name), "%s%s", env_name[0] == '/' ? "" : "/", env_name);
+
+    for (tries = 0; tries < LINUX_SIM_SHM_TRIES && !region; tries++) {
+        region = linux_sim_shm_map(g_shm_name, &creator);
+        if (!region)
+            return -1;
+        if (creator)
+            break;
+
+        /* The last user may have removed the name since we opened it */
+        linux_sim_mutex_lock(&region->attach_mutex);
+        gone = region->unlinked;
+        if (!gone)
+            region->attached++;
+        pthread_mutex_unlock(&region->attach_mutex);
+        if (gone) {
+            munmap(region, sizeof(*region));
+            region = NULL;
+        }
+    }
+    if (!region) {
+        fprintf(stderr, "pcie_sim: %s kept being removed while attaching\n", g_shm_name);
+        return -1;
+    }
+
+    g_shm_region = region;
+    g_sim_devices = region->devices;
+    g_sim_shared = 1;
+    g_shm_pid = getpid();
+    atexit(linux_sim_shm_detach);
+    return 0;
 }
 
 /*
- * Simulate transfer delay with nanosecond precision
+ * Initialize Linux simulation system
  */
-static void linux_sim_delay(uint64_t delay_ns)
+static int linux_sim_init(void)
 {
-    struct timespec ts;
+    const char *shm_name;
+    int ret = 0;
 
-    /* Only delay if significant enough (> 1000ns) */
-    if (delay_ns < 1000)
-        return;
+    pthread_mutex_lock(&g_init_mutex);
 
-    ts.tv_sec = delay_ns / 1000000000ULL;
-    ts.tv_nsec = delay_ns % 1000000000ULL;
+    if (!g_sim_initialized) {
+        shm_name = getenv(LINUX_SIM_SHM_ENV);
+        if (shm_name && shm_name[0]) {
+            ret = linux_sim_shm_attach(shm_name);
+        } else {
+            /* Initialize all device mutexes */
+            for (int i = 0; i < MAX_DEVICES; i++) {
+                linux_sim_mutex_init(&g_sim_devices[i].mutex, 0);
+                linux_sim_mutex_init(&g_sim_devices[i].mmio_mutex, 0);
+                g_sim_devices[i].active = 0;
+            }
+        }
+        if (ret == 0)
+            g_sim_initialized = 1;
+    }
 
-    nanosleep(&ts, NULL);
+    pthread_mutex_unlock(&g_init_mutex);
+    return ret;
 }
 
 /*
@@ -113,13 +330,38 @@ static void linux_sim_delay(uint64_t delay_ns)
  */
 pcie_sim_error_t pcie_sim_open_linux(int device_id, pcie_sim_handle_t *handle)
 {
+    struct linux_device_state *dev;
     struct pcie_sim_handle *h;
 
+    const char *simd_socket;
+    pcie_sim_error_t ret;
+
     if (!handle || device_id < 0 || device_id >= MAX_DEVICES)
         return PCIE_SIM_ERROR_PARAM;
 
+    /* Devices hosted by a pcie_simd daemon bypass the in-process model */
+    simd_socket = getenv(SIMD_SOCKET_ENV);
+    if (simd_socket && simd_socket[0]) {
+        h = calloc(1, sizeof(*h));
+        if (!h)
+            return PCIE_SIM_ERROR_MEMORY;
+
+        ret = simd_client_connect(simd_socket, device_id, &h->remote);
+        if (ret != PCIE_SIM_SUCCESS) {
+            free(h);
+            return ret;
+        }
+        h->fd = -1;
+        h->device_id = device_id;
+        h->is_simulation = 1;
+
+        *handle = h;
+        return PCIE_SIM_SUCCESS;
+    }
+
     /* Initialize simulation if needed */
-    linux_sim_init();
+    if (linux_sim_init() != 0)
+        return PCIE_SIM_ERROR_SYSTEM;
 
     /* Allocate handle structure */
     h = malloc(sizeof(*h));
@@ -130,17 +372,22 @@ pcie_sim_error_t pcie_sim_open_linux(int device_id, pcie_sim_handle_t *handle)
     h->fd = -1;  /* No real device file descriptor */
     h->device_id = device_id;
     h->is_simulation = 1;
+    h->remote = NULL;
 
     /* Initialize device state */
-    pthread_mutex_lock(&g_sim_devices[device_id].mutex);
-    if (!g_sim_devices[device_id].active) {
-        g_sim_devices[device_id].active = 1;
-        memset(&g_sim_devices[device_id].stats, 0, sizeof(g_sim_devices[device_id].stats));
-        clock_gettime(CLOCK_MONOTONIC, &g_sim_devices[device_id].start_time);
-        snprintf(g_sim_devices[device_id].device_name, sizeof(g_sim_devices[device_id].device_name),
-                 "pcie_sim%d", device_id);
+    dev = &g_sim_devices[device_id];
+    linux_sim_lock(dev);
+    if (!dev->active) {
+        dev->active = 1;
+        pcie_sim_stats_page_init(&dev->stats);
+        memset(&dev->stats_prev, 0, sizeof(dev->stats_prev));
+        memset(&dev->stats_prev_sq, 0, sizeof(dev->stats_prev_sq));
+        memset(dev->phases, 0, sizeof(dev->phases));
+        clock_gettime(CLOCK_MONOTONIC, &dev->start_time);
+        snprintf(dev->device_name, sizeof(dev->device_name), "pcie_sim%d", device_id);
+        pcie_sim_bar0_init(&dev->bar0);
     }
-    pthread_mutex_unlock(&g_sim_devices[device_id].mutex);
+    linux_sim_unlock(dev);
 
     *handle = h;
     return PCIE_SIM_SUCCESS;
@@ -155,27 +402,43 @@ pcie_sim_error_t pcie_sim_close_linux(pcie_sim_handle_t handle)
         return PCIE_SIM_ERROR_PARAM;
 
     /* No real file descriptor to close in simulation mode */
+    simd_client_close(handle->remote);
     free(handle);
     return PCIE_SIM_SUCCESS;
 }
 
 /*
- * Linux implementation of pcie_sim_transfer (simulation)
+ * Simulated transfer. The model has no bounce buffer or copies: the time
+ * waiting for a shared device is queue wait, the modeled delay is wire
+ * time and accounting the result is completion.
  */
-pcie_sim_error_t pcie_sim_transfer_linux(pcie_sim_handle_t handle,
-                                        void *buffer,
-                                        size_t size,
-                                        uint32_t direction,
-                                        uint64_t *latency_ns)
+static pcie_sim_error_t linux_sim_transfer(pcie_sim_handle_t handle, void *buffer,
+                                           size_t size, uint32_t direction,
+                                           uint64_t *latency_ns, uint64_t *phase_ns)
 {
-    uint64_t start_time, end_time, transfer_latency;
+    struct linux_device_state *dev;
+    uint64_t start_time, end_time, transfer_latency, current_latency;
     uint64_t base_latency_per_mb = 10000; /* 10μs per MB base latency */
+    uint64_t phases[PCIE_SIM_PHASES] = { 0 };
+    uint64_t submit_time, done_time;
     uint64_t size_mb;
 
     if (!handle || !buffer || size == 0 || handle->device_id >= MAX_DEVICES)
         return PCIE_SIM_ERROR_PARAM;
 
-    start_time = linux_sim_get_time_ns();
+    if (handle->remote)
+        return simd_client_transfer(handle->remote, buffer, size, direction, latency_ns,
+                                    phase_ns);
+
+    dev = &g_sim_devices[handle->device_id];
+    submit_time = pcie_sim_clock_ticks();
+
+    /* Shared devices serialize transfers on the link, as the kernel driver
+     * does with its per-device mutex, so processes contend for it */
+    if (g_sim_shared)
+        linux_sim_lock(dev);
+
+    start_time = pcie_sim_clock_ticks();
 
     /* Simulate transfer with realistic timing */
     size_mb = (size + 1024*1024 - 1) / (1024*1024); /* Round up to MB */
@@ -189,37 +452,57 @@ pcie_sim_error_t pcie_sim_transfer_linux(pcie_sim_handle_t handle,
     }
 
     /* Simulate the transfer delay */
-    linux_sim_delay(transfer_latency);
+    pcie_sim_delay_ns(transfer_latency);
 
-    end_time = linux_sim_get_time_ns();
+    end_time = pcie_sim_clock_ticks();
 
     /* Update device statistics */
-    pthread_mutex_lock(&g_sim_devices[handle->device_id].mutex);
-    g_sim_devices[handle->device_id].stats.total_transfers++;
-    g_sim_devices[handle->device_id].stats.total_bytes += size;
-
-    /* Update latency statistics */
-    uint64_t current_latency = end_time - start_time;
-    if (g_sim_devices[handle->device_id].stats.total_transfers == 1) {
-        g_sim_devices[handle->device_id].stats.avg_latency_ns = current_latency;
-        g_sim_devices[handle->device_id].stats.min_latency_ns = current_latency;
-        g_sim_devices[handle->device_id].stats.max_latency_ns = current_latency;
-    } else {
-        g_sim_devices[handle->device_id].stats.avg_latency_ns =
-            (g_sim_devices[handle->device_id].stats.avg_latency_ns + current_latency) / 2;
-        if (current_latency < g_sim_devices[handle->device_id].stats.min_latency_ns)
-            g_sim_devices[handle->device_id].stats.min_latency_ns = current_latency;
-        if (current_latency > g_sim_devices[handle->device_id].stats.max_latency_ns)
-            g_sim_devices[handle->device_id].stats.max_latency_ns = current_latency;
-    }
-    pthread_mutex_unlock(&g_sim_devices[handle->device_id].mutex);
+    if (!g_sim_shared)
+        linux_sim_lock(dev);
+    done_time = pcie_sim_clock_ticks();
+    current_latency = pcie_sim_clock_to_ns(end_time - start_time);
+    phases[PCIE_SIM_PHASE_QUEUE] = pcie_sim_clock_to_ns(start_time - submit_time);
+    phases[PCIE_SIM_PHASE_WIRE] = current_latency;
+    phases[PCIE_SIM_PHASE_COMPLETION] = pcie_sim_clock_to_ns(done_time - end_time);
+    pcie_sim_stats_page_begin(&dev->stats);
+    pcie_sim_stats_page_account(&dev->stats, direction, size, current_latency);
+    pcie_sim_stats_page_end(&dev->stats);
+    pcie_sim_stats_phases(dev->phases, phases);
+    linux_sim_unlock(dev);
 
     if (latency_ns)
-        *latency_ns = end_time - start_time;
+        *latency_ns = current_latency;
+    if (phase_ns)
+        memcpy(phase_ns, phases, sizeof(phases));
 
     return PCIE_SIM_SUCCESS;
 }
 
+/*
+ * Linux implementation of pcie_sim_transfer (simulation)
+ */
+pcie_sim_error_t pcie_sim_transfer_linux(pcie_sim_handle_t handle,
+                                        void *buffer,
+                                        size_t size,
+                                        uint32_t direction,
+                                        uint64_t *latency_ns)
+{
+    return linux_sim_transfer(handle, buffer, size, direction, latency_ns, NULL);
+}
+
+/*
+ * Linux implementation of pcie_sim_transfer_ex (simulation)
+ */
+pcie_sim_error_t pcie_sim_transfer_ex_linux(pcie_sim_handle_t handle, void *buffer,
+                                           size_t size, uint32_t direction,
+                                           uint64_t *latency_ns, uint64_t *phase_ns)
+{
+    if (!phase_ns)
+        return PCIE_SIM_ERROR_PARAM;
+
+    return linux_sim_transfer(handle, buffer, size, direction, latency_ns, phase_ns);
+}
+
 /*
  * Linux implementation of pcie_sim_get_stats (simulation)
  */
@@ -229,11 +512,81 @@ pcie_sim_error_t pcie_sim_get_stats_linux(pcie_sim_handle_t handle,
     if (!handle || !stats || handle->device_id >= MAX_DEVICES)
         return PCIE_SIM_ERROR_PARAM;
 
-    /* Copy current stats from simulation */
-    pthread_mutex_lock(&g_sim_devices[handle->device_id].mutex);
-    *stats = g_sim_devices[handle->device_id].stats;
-    pthread_mutex_unlock(&g_sim_devices[handle->device_id].mutex);
+    if (handle->remote)
+        return simd_client_get_stats(handle->remote, stats);
+
+    /* Summarize current stats from simulation */
+    linux_sim_lock(&g_sim_devices[handle->device_id]);
+    pcie_sim_stats_summary(&g_sim_devices[handle->device_id].stats.xfer,
+                           &g_sim_devices[handle->device_id].stats.latency_sq, stats);
+    linux_sim_unlock(&g_sim_devices[handle->device_id]);
+
+    return PCIE_SIM_SUCCESS;
+}
+
+/*
+ * Linux implementation of pcie_sim_get_stats_ex (simulation). There are
+ * no rings in the simulator, so no queue statistics.
+ */
+pcie_sim_error_t pcie_sim_get_stats_ex_linux(pcie_sim_handle_t handle,
+                                             struct pcie_sim_stats_ex *stats)
+{
+    struct linux_device_state *dev;
+    struct pcie_sim_stats_ex ex;
+    uint32_t size;
+    int ret;
+
+    if (!handle || !stats || handle->device_id >= MAX_DEVICES)
+        return PCIE_SIM_ERROR_PARAM;
+
+    size = pcie_sim_stats_ex_size(stats->hdr.size);
+    if (!size)
+        return PCIE_SIM_ERROR_PARAM;
+
+    if (handle->remote)
+        return simd_client_get_stats_ex(handle->remote, stats);
+
+    memset(&ex, 0, sizeof(ex));
+    ex.since_epoch = pcie_sim_stats_ex_since(stats, size);
+
+    dev = &g_sim_devices[handle->device_id];
+    linux_sim_lock(dev);
+    ret = pcie_sim_stats_since(&dev->stats, &dev->stats_prev, &dev->stats_prev_sq,
+                               ex.since_epoch, &ex.xfer, &ex.latency_sq);
+    ex.epoch = dev->stats.epoch;
+    ex.prev = dev->stats_prev;
+    ex.prev_latency_sq = dev->stats_prev_sq;
+    memcpy(ex.phases, dev->phases, sizeof(ex.phases));
+    linux_sim_unlock(dev);
+
+    /* The epoch asked for is no longer retained, or not reached yet */
+    if (ret)
+        return PCIE_SIM_ERROR_PARAM;
+    if (!ex.since_epoch)
+        ex.since_epoch = ex.epoch;
+
+    ex.hdr.size = size;
+    ex.hdr.version = PCIE_SIM_STATS_VERSION;
+    memcpy(stats, &ex, size);
+
+    return PCIE_SIM_SUCCESS;
+}
+
+/*
+ * Linux implementation of pcie_sim_stats_map (simulation). The page is
+ * part of the device table, shared with other processes when it is.
+ */
+pcie_sim_error_t pcie_sim_stats_map_linux(pcie_sim_handle_t handle,
+                                          const struct pcie_sim_stats_page **page)
+{
+    if (!handle || !page || handle->device_id >= MAX_DEVICES)
+        return PCIE_SIM_ERROR_PARAM;
+
+    /* The counters live in the pcie_simd process */
+    if (handle->remote)
+        return PCIE_SIM_ERROR_DEVICE;
 
+    *page = &g_sim_devices[handle->device_id].stats;
     return PCIE_SIM_SUCCESS;
 }
 
@@ -241,16 +594,332 @@ pcie_sim_error_t pcie_sim_get_stats_linux(pcie_sim_handle_t handle,
  * Linux implementation of pcie_sim_reset_stats (simulation)
  */
 pcie_sim_error_t pcie_sim_reset_stats_linux(pcie_sim_handle_t handle)
+{
+    uint64_t epoch;
+
+    return pcie_sim_reset_stats_epoch_linux(handle, &epoch);
+}
+
+/*
+ * Linux implementation of pcie_sim_reset_stats_epoch (simulation)
+ */
+pcie_sim_error_t pcie_sim_reset_stats_epoch_linux(pcie_sim_handle_t handle, uint64_t *epoch)
+{
+    struct linux_device_state *dev;
+
+    if (!handle || !epoch || handle->device_id >= MAX_DEVICES)
+        return PCIE_SIM_ERROR_PARAM;
+
+    if (handle->remote)
+        return simd_client_reset_stats(handle->remote, epoch);
+
+    /* Retire the counters and start the next epoch */
+    dev = &g_sim_devices[handle->device_id];
+    linux_sim_lock(dev);
+    pcie_sim_stats_page_begin(&dev->stats);
+    pcie_sim_stats_new_epoch(&dev->stats, &dev->stats_prev, &dev->stats_prev_sq);
+    pcie_sim_stats_page_end(&dev->stats);
+    memset(dev->phases, 0, sizeof(dev->phases));
+    *epoch = dev->stats.epoch;
+    linux_sim_unlock(dev);
+
+    return PCIE_SIM_SUCCESS;
+}
+
+/*
+ * BAR0 hooks: in-process DMA addresses are plain pointers in the caller
+ */
+static int linux_sim_bar0_dma(void *ctx, uint64_t addr, uint32_t size,
+                              uint32_t direction, uint64_t *latency_ns)
+{
+    return pcie_sim_transfer_linux(ctx, (void *)(uintptr_t)addr, size,
+                                   direction, latency_ns) == PCIE_SIM_SUCCESS ? 0 : -1;
+}
+
+static int linux_sim_bar0_stats(void *ctx, struct pcie_sim_stats *stats)
+{
+    return pcie_sim_get_stats_linux(ctx, stats) == PCIE_SIM_SUCCESS ? 0 : -1;
+}
+
+static const struct pcie_sim_bar0_ops linux_sim_bar0_ops = {
+    linux_sim_bar0_dma,
+    linux_sim_bar0_stats,
+    NULL,
+    pcie_sim_clock_now_ns,
+};
+
+/*
+ * Validate a handle for register access and lock its BAR0
+ */
+static pcie_sim_error_t linux_sim_bar0_lock(pcie_sim_handle_t handle,
+                                            struct linux_device_state **dev)
 {
     if (!handle || handle->device_id >= MAX_DEVICES)
         return PCIE_SIM_ERROR_PARAM;
 
-    /* Reset simulation stats */
-    pthread_mutex_lock(&g_sim_devices[handle->device_id].mutex);
-    memset(&g_sim_devices[handle->device_id].stats, 0, sizeof(g_sim_devices[handle->device_id].stats));
-    pthread_mutex_unlock(&g_sim_devices[handle->device_id].mutex);
+    /* Registers live in this process; daemon-hosted devices have none here */
+    if (handle->remote)
+        return PCIE_SIM_ERROR_DEVICE;
+
+    *dev = &g_sim_devices[handle->device_id];
+    linux_sim_mutex_lock(&(*dev)->mmio_mutex);
+    return PCIE_SIM_SUCCESS;
+}
+
+static void linux_sim_bar0_unlock(struct linux_device_state *dev)
+{
+    pthread_mutex_unlock(&dev->mmio_mutex);
+}
+
+/*
+ * Linux implementation of pcie_sim_mmio_read32 (simulation)
+ */
+pcie_sim_error_t pcie_sim_mmio_read32_linux(pcie_sim_handle_t handle,
+                                            uint32_t offset, uint32_t *value)
+{
+    struct linux_device_state *dev;
+    pcie_sim_error_t ret;
+
+    if (!value)
+        return PCIE_SIM_ERROR_PARAM;
+
+    if (!pcie_sim_bar0_valid(offset)) {
+        *value = 0xFFFFFFFF;    /* What the kernel returns for bad offsets */
+        return PCIE_SIM_ERROR_PARAM;
+    }
+
+    ret = linux_sim_bar0_lock(handle, &dev);
+    if (ret != PCIE_SIM_SUCCESS)
+        return ret;
+    *value = pcie_sim_bar0_read(&dev->bar0, offset, &linux_sim_bar0_ops, handle);
+    linux_sim_bar0_unlock(dev);
+
+    return PCIE_SIM_SUCCESS;
+}
+
+/*
+ * Linux implementation of pcie_sim_mmio_write32 (simulation)
+ */
+pcie_sim_error_t pcie_sim_mmio_write32_linux(pcie_sim_handle_t handle,
+                                             uint32_t offset, uint32_t value)
+{
+    struct linux_device_state *dev;
+    pcie_sim_error_t ret;
+
+    if (!pcie_sim_bar0_valid(offset))
+        return PCIE_SIM_ERROR_PARAM;
+
+    ret = linux_sim_bar0_lock(handle, &dev);
+    if (ret != PCIE_SIM_SUCCESS)
+        return ret;
+    pcie_sim_bar0_write(&dev->bar0, offset, value, &linux_sim_bar0_ops, handle);
+    linux_sim_bar0_unlock(dev);
+
+    return PCIE_SIM_SUCCESS;
+}
+
+/*
+ * Linux implementation of pcie_sim_mmio_flush (simulation)
+ */
+pcie_sim_error_t pcie_sim_mmio_flush_linux(pcie_sim_handle_t handle)
+{
+    struct linux_device_state *dev;
+    pcie_sim_error_t ret;
+
+    ret = linux_sim_bar0_lock(handle, &dev);
+    if (ret != PCIE_SIM_SUCCESS)
+        return ret;
+    pcie_sim_bar0_flush(&dev->bar0, &linux_sim_bar0_ops);
+    linux_sim_bar0_unlock(dev);
+
+    return PCIE_SIM_SUCCESS;
+}
+
+/*
+ * Linux implementation of pcie_sim_mmio_configure (simulation)
+ */
+pcie_sim_error_t pcie_sim_mmio_configure_linux(pcie_sim_handle_t handle,
+                                               const struct pcie_sim_mmio_config *config)
+{
+    struct linux_device_state *dev;
+    pcie_sim_error_t ret;
+
+    if (!config)
+        return PCIE_SIM_ERROR_PARAM;
+
+    ret = linux_sim_bar0_lock(handle, &dev);
+    if (ret != PCIE_SIM_SUCCESS)
+        return ret;
+    /* Settle pending combined writes under the old model */
+    pcie_sim_bar0_flush(&dev->bar0, &linux_sim_bar0_ops);
+    dev->bar0.cost = *config;
+    linux_sim_bar0_unlock(dev);
+
+    return PCIE_SIM_SUCCESS;
+}
+
+/*
+ * Linux implementation of pcie_sim_mmio_get_stats (simulation)
+ */
+pcie_sim_error_t pcie_sim_mmio_get_stats_linux(pcie_sim_handle_t handle,
+                                               struct pcie_sim_mmio_stats *stats)
+{
+    struct linux_device_state *dev;
+    pcie_sim_error_t ret;
+
+    if (!stats)
+        return PCIE_SIM_ERROR_PARAM;
+
+    ret = linux_sim_bar0_lock(handle, &dev);
+    if (ret != PCIE_SIM_SUCCESS)
+        return ret;
+    *stats = dev->bar0.stats;
+    linux_sim_bar0_unlock(dev);
+
+    return PCIE_SIM_SUCCESS;
+}
+
+/*
+ * Linux implementation of pcie_sim_mmio_reset_stats (simulation)
+ */
+pcie_sim_error_t pcie_sim_mmio_reset_stats_linux(pcie_sim_handle_t handle)
+{
+    struct linux_device_state *dev;
+    pcie_sim_error_t ret;
+
+    ret = linux_sim_bar0_lock(handle, &dev);
+    if (ret != PCIE_SIM_SUCCESS)
+        return ret;
+    pcie_sim_bar0_reset_stats(&dev->bar0);
+    linux_sim_bar0_unlock(dev);
+
+    return PCIE_SIM_SUCCESS;
+}
+
+/*
+ * Linux implementation of pcie_sim_mmio_read_trace (simulation)
+ */
+pcie_sim_error_t pcie_sim_mmio_read_trace_linux(pcie_sim_handle_t handle,
+                                                struct pcie_sim_mmio_trace_entry *entries,
+                                                size_t max_entries, size_t *count)
+{
+    struct linux_device_state *dev;
+    pcie_sim_error_t ret;
+
+    if (!entries || !count)
+        return PCIE_SIM_ERROR_PARAM;
+
+    ret = linux_sim_bar0_lock(handle, &dev);
+    if (ret != PCIE_SIM_SUCCESS)
+        return ret;
+    *count = pcie_sim_bar0_read_trace(&dev->bar0, entries, max_entries);
+    linux_sim_bar0_unlock(dev);
+
+    return PCIE_SIM_SUCCESS;
+}
+
+/*
+ * Linux implementation of pcie_sim_snapshot (simulation). A NULL buffer
+ * only reports the size needed.
+ */
+pcie_sim_error_t pcie_sim_snapshot_linux(pcie_sim_handle_t handle, void *buffer,
+                                         size_t size, size_t *used)
+{
+    struct pcie_sim_snapshot_writer w;
+    struct linux_device_state *dev;
+    struct pcie_sim_stats *stats;
+    void *xfer, *sq;
+    pcie_sim_error_t ret;
+
+    if (!used)
+        return PCIE_SIM_ERROR_PARAM;
+
+    ret = linux_sim_bar0_lock(handle, &dev);
+    if (ret != PCIE_SIM_SUCCESS)
+        return ret;
+    linux_sim_lock(dev);
+
+    /* Write-combined data still in flight is not device state yet */
+    pcie_sim_bar0_flush(&dev->bar0, &linux_sim_bar0_ops);
+
+    pcie_sim_snapshot_begin(&w, buffer, size);
+    stats = pcie_sim_snapshot_add(&w, PCIE_SIM_SNAP_STATS, sizeof(*stats));
+    if (stats)
+        pcie_sim_stats_summary(&dev->stats.xfer, &dev->stats.latency_sq, stats);
+    xfer = pcie_sim_snapshot_add(&w, PCIE_SIM_SNAP_TRANSFER_STATS, sizeof(dev->stats.xfer));
+    if (xfer)
+        memcpy(xfer, &dev->stats.xfer, sizeof(dev->stats.xfer));
+    sq = pcie_sim_snapshot_add(&w, PCIE_SIM_SNAP_LATENCY_SQ, sizeof(dev->stats.latency_sq));
+    if (sq)
+        memcpy(sq, &dev->stats.latency_sq, sizeof(dev->stats.latency_sq));
+    pcie_sim_bar0_save(&dev->bar0, &w);
+    *used = pcie_sim_snapshot_end(&w);
+
+    linux_sim_unlock(dev);
+    linux_sim_bar0_unlock(dev);
+
+    return !buffer || *used <= size ? PCIE_SIM_SUCCESS : PCIE_SIM_ERROR_MEMORY;
+}
+
+/*
+ * Linux implementation of pcie_sim_restore (simulation)
+ */
+pcie_sim_error_t pcie_sim_restore_linux(pcie_sim_handle_t handle, const void *buffer,
+                                        size_t size)
+{
+    const struct pcie_sim_snapshot_section *s = NULL;
+    struct linux_device_state *dev;
+    pcie_sim_error_t ret;
+
+    if (!buffer || pcie_sim_snapshot_check(buffer, size) != 0)
+        return PCIE_SIM_ERROR_PARAM;
+
+    ret = linux_sim_bar0_lock(handle, &dev);
+    if (ret != PCIE_SIM_SUCCESS)
+        return ret;
+    linux_sim_lock(dev);
+
+    /* Full counters, when present, follow and replace the summary */
+    pcie_sim_stats_page_begin(&dev->stats);
+    while ((s = pcie_sim_snapshot_next(buffer, s)) != NULL) {
+        if (s->type == PCIE_SIM_SNAP_STATS) {
+            struct pcie_sim_stats stats;
+
+            pcie_sim_snapshot_copy(&stats, sizeof(stats), s);
+            pcie_sim_stats_from_summary(&dev->stats.xfer, &dev->stats.latency_sq, &stats);
+        } else if (s->type == PCIE_SIM_SNAP_TRANSFER_STATS) {
+            pcie_sim_snapshot_copy(&dev->stats.xfer, sizeof(dev->stats.xfer), s);
+        } else if (s->type == PCIE_SIM_SNAP_LATENCY_SQ) {
+            pcie_sim_snapshot_copy(&dev->stats.latency_sq, sizeof(dev->stats.latency_sq), s);
+        }
+    }
+    pcie_sim_stats_page_end(&dev->stats);
+    pcie_sim_bar0_load(&dev->bar0, buffer);
+
+    linux_sim_unlock(dev);
+    linux_sim_bar0_unlock(dev);
+
+    return PCIE_SIM_SUCCESS;
+}
+
+/*
+ * Linux implementation of pcie_sim_get_memory_stats (simulation)
+ */
+pcie_sim_error_t pcie_sim_get_memory_stats_linux(pcie_sim_handle_t handle,
+                                                 struct pcie_sim_memory_stats *stats)
+{
+    if (!handle || !stats || handle->device_id >= MAX_DEVICES)
+        return PCIE_SIM_ERROR_PARAM;
+
+    /* The device's memory belongs to the pcie_simd process */
+    if (handle->remote)
+        return PCIE_SIM_ERROR_DEVICE;
 
+    pcie_sim_bar0_memory(stats, sizeof(struct linux_device_state),
+                         sizeof(g_sim_devices[0].stats) + sizeof(g_sim_devices[0].stats_prev) +
+                         sizeof(g_sim_devices[0].stats_prev_sq) +
+                         sizeof(g_sim_devices[0].phases));
     return PCIE_SIM_SUCCESS;
 }
 
-#endif /* !_WIN32 */
\ No newline at end of file
+#endif /* !_WIN32 */
@@ -0,0 +1,430 @@
+/*
+ * PCIe Simulator - BAR0 Register Model
+ *
+ * Copyright (c) 2025 Karan Mamaniya <kmamaniya@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Platform-independent BAR0 register state machine used by the Linux and
+ * Windows simulation backends and by pcie_simd's vfio-user server.
+ */
+
+#include "mmio_sim.h"
+#include <string.h>
+
+/*
+ * Set up a fresh register file with the default cost model
+ */
+void pcie_sim_bar0_init(struct pcie_sim_bar0 *bar0)
+{
+    memset(bar0, 0, sizeof(*bar0));
+    bar0->cost.read_ns = PCIE_SIM_MMIO_DEFAULT_READ_NS;
+    bar0->cost.write_ns = PCIE_SIM_MMIO_DEFAULT_WRITE_NS;
+    bar0->cost.wc_flush_ns = PCIE_SIM_MMIO_DEFAULT_WC_FLUSH_NS;
+    pcie_sim_bar0_reset(bar0);
+}
+
+/*
+ * Reset registers to the values pcie_sim_mmio_init() programs
+ */
+void pcie_sim_bar0_reset(struct pcie_sim_bar0 *bar0)
+{
+    memset(bar0->regs, 0, sizeof(bar0->regs));
+    bar0->dma_active = 0;
+    bar0->pending_interrupts = 0;
+    bar0->simulate_errors = 0;
+    bar0->fault_injection_rate = 0;
+    bar0->dma_count = 0;
+    bar0->wc_pending = 0;
+    bar0->regs[PCIE_SIM_REG_DEVICE_ID / 4] = PCIE_SIM_DEVICE_ID_VALUE;
+    bar0->regs[PCIE_SIM_REG_STATUS / 4] = PCIE_SIM_STATUS_DEVICE_READY;
+    bar0->regs[PCIE_SIM_REG_CONTROL / 4] = PCIE_SIM_CONTROL_DEVICE_ENABLE;
+    bar0->regs[PCIE_SIM_REG_INTERRUPT_ENABLE / 4] =
+        PCIE_SIM_IRQ_DMA_COMPLETE | PCIE_SIM_IRQ_DMA_ERROR;
+}
+
+/*
+ * Stall the caller for the modeled cost when PCIE_SIM_MMIO_STALL is set
+ */
+static void pcie_sim_bar0_charge(struct pcie_sim_bar0 *bar0,
+                                 const struct pcie_sim_bar0_ops *ops, uint32_t cost_ns)
+{
+    uint64_t end;
+
+    if (!cost_ns || !(bar0->cost.flags & PCIE_SIM_MMIO_STALL) || !ops->now_ns)
+        return;
+
+    end = ops->now_ns() + cost_ns;
+    while (ops->now_ns() < end)
+        ;
+}
+
+static void pcie_sim_bar0_record(struct pcie_sim_bar0 *bar0,
+                                 const struct pcie_sim_bar0_ops *ops, uint32_t offset,
+                                 uint32_t value, uint32_t is_write, uint32_t cost_ns)
+{
+    struct pcie_sim_mmio_trace_entry *e;
+
+    if (!(bar0->cost.flags & PCIE_SIM_MMIO_TRACE))
+        return;
+
+    e = &bar0->trace[bar0->trace_head % PCIE_SIM_BAR0_TRACE_ENTRIES];
+    e->timestamp_ns = ops->now_ns ? ops->now_ns() : 0;
+    e->offset = offset;
+    e->value = value;
+    e->is_write = is_write;
+    e->cost_ns = cost_ns;
+
+    /* Oldest entries are overwritten */
+    if (++bar0->trace_head - bar0->trace_tail > PCIE_SIM_BAR0_TRACE_ENTRIES)
+        bar0->trace_tail = bar0->trace_head - PCIE_SIM_BAR0_TRACE_ENTRIES;
+}
+
+/*
+ * Drain the write-combining buffer, as an sfence or an uncached read would
+ */
+void pcie_sim_bar0_flush(struct pcie_sim_bar0 *bar0, const struct pcie_sim_bar0_ops *ops)
+{
+    if (!bar0->wc_pending)
+        return;
+
+    bar0->wc_pending = 0;
+    bar0->stats.wc_flushes++;
+    bar0->stats.write_cost_ns += bar0->cost.wc_flush_ns;
+    pcie_sim_bar0_charge(bar0, ops, bar0->cost.wc_flush_ns);
+}
+
+void pcie_sim_bar0_reset_stats(struct pcie_sim_bar0 *bar0)
+{
+    memset(&bar0->stats, 0, sizeof(bar0->stats));
+    bar0->trace_tail = bar0->trace_head;
+}
+
+/*
+ * Copy out and consume up to max recorded accesses, oldest first
+ */
+size_t pcie_sim_bar0_read_trace(struct pcie_sim_bar0 *bar0,
+                                struct pcie_sim_mmio_trace_entry *entries, size_t max)
+{
+    size_t n = 0;
+
+    while (n < max && bar0->trace_tail != bar0->trace_head) {
+        entries[n++] = bar0->trace[bar0->trace_tail % PCIE_SIM_BAR0_TRACE_ENTRIES];
+        bar0->trace_tail++;
+    }
+
+    return n;
+}
+
+/*
+ * Append the register file, fault injection state and MMIO model to a
+ * snapshot. The caller flushes pending write-combined data first.
+ */
+void pcie_sim_bar0_save(const struct pcie_sim_bar0 *bar0, struct pcie_sim_snapshot_writer *w)
+{
+    struct pcie_sim_snapshot_error *err;
+    struct pcie_sim_snapshot_mmio *mmio;
+    uint32_t words = PCIE_SIM_BAR0_SIZE / 4;
+    void *regs;
+
+    /* Most of BAR0 is unused; only store up to the last nonzero register */
+    while (words && !bar0->regs[words - 1])
+        words--;
+
+    regs = pcie_sim_snapshot_add(w, PCIE_SIM_SNAP_REGS, words * 4);
+    if (regs)
+        memcpy(regs, bar0->regs, words * 4);
+
+    err = pcie_sim_snapshot_add(w, PCIE_SIM_SNAP_ERROR, sizeof(*err));
+    if (err) {
+        err->simulate_errors = bar0->simulate_errors;
+        err->fault_injection_rate = bar0->fault_injection_rate;
+        err->fault_counter = bar0->dma_count;
+    }
+
+    mmio = pcie_sim_snapshot_add(w, PCIE_SIM_SNAP_MMIO, sizeof(*mmio));
+    if (mmio) {
+        mmio->read_ns = bar0->cost.read_ns;
+        mmio->write_ns = bar0->cost.write_ns;
+        mmio->wc_flush_ns = bar0->cost.wc_flush_ns;
+        mmio->flags = bar0->cost.flags;
+        mmio->reads = bar0->stats.reads;
+        mmio->writes = bar0->stats.writes;
+        mmio->wc_coalesced = bar0->stats.wc_coalesced;
+        mmio->wc_flushes = bar0->stats.wc_flushes;
+        mmio->read_cost_ns = bar0->stats.read_cost_ns;
+        mmio->write_cost_ns = bar0->stats.write_cost_ns;
+        mmio->doorbells = bar0->stats.doorbells;
+        memcpy(mmio->reg_reads, bar0->stats.reg_reads, sizeof(mmio->reg_reads));
+        memcpy(mmio->reg_writes, bar0->stats.reg_writes, sizeof(mmio->reg_writes));
+    }
+}
+
+/*
+ * Apply the BAR0 sections of a checked snapshot. Sections it lacks leave
+ * the matching state alone; the access trace is discarded.
+ */
+void pcie_sim_bar0_load(struct pcie_sim_bar0 *bar0, const void *snapshot)
+{
+    const struct pcie_sim_snapshot_section *s = NULL;
+    struct pcie_sim_snapshot_error err;
+    struct pcie_sim_snapshot_mmio mmio;
+
+    while ((s = pcie_sim_snapshot_next(snapshot, s)) != NULL) {
+        switch (s->type) {
+        case PCIE_SIM_SNAP_REGS:
+            pcie_sim_snapshot_copy(bar0->regs, sizeof(bar0->regs), s);
+            break;
+
+        case PCIE_SIM_SNAP_ERROR:
+            pcie_sim_snapshot_copy(&err, sizeof(err), s);
+            bar0->simulate_errors = err.simulate_errors;
+            bar0->fault_injection_rate = err.fault_injection_rate;
+            bar0->dma_count = err.fault_counter;
+            break;
+
+        case PCIE_SIM_SNAP_MMIO:
+            pcie_sim_snapshot_copy(&mmio, sizeof(mmio), s);
+            bar0->cost.read_ns = mmio.read_ns;
+            bar0->cost.write_ns = mmio.write_ns;
+            bar0->cost.wc_flush_ns = mmio.wc_flush_ns;
+            bar0->cost.flags = mmio.flags;
+            bar0->stats.reads = mmio.reads;
+            bar0->stats.writes = mmio.writes;
+            bar0->stats.wc_coalesced = mmio.wc_coalesced;
+            bar0->stats.wc_flushes = mmio.wc_flushes;
+            bar0->stats.read_cost_ns = mmio.read_cost_ns;
+            bar0->stats.write_cost_ns = mmio.write_cost_ns;
+            bar0->stats.doorbells = mmio.doorbells;
+            memcpy(bar0->stats.reg_reads, mmio.reg_reads, sizeof(mmio.reg_reads));
+            memcpy(bar0->stats.reg_writes, mmio.reg_writes, sizeof(mmio.reg_writes));
+            break;
+        }
+    }
+
+    /* Faults fire on every Nth DMA; a rate of 0 would divide by zero */
+    if (!bar0->fault_injection_rate)
+        bar0->simulate_errors = 0;
+
+    bar0->dma_active = 0;
+    bar0->wc_pending = 0;
+    bar0->trace_tail = bar0->trace_head;
+}
+
+/*
+ * Signal the host if an enabled interrupt is pending and IRQs are on
+ */
+static void pcie_sim_bar0_raise_irq(struct pcie_sim_bar0 *bar0,
+                                    const struct pcie_sim_bar0_ops *ops, void *ctx)
+{
+    uint32_t active = bar0->regs[PCIE_SIM_REG_INTERRUPT_STATUS / 4] &
+                      bar0->regs[PCIE_SIM_REG_INTERRUPT_ENABLE / 4];
+
+    if (active && ops->irq &&
+        (bar0->regs[PCIE_SIM_REG_CONTROL / 4] & PCIE_SIM_CONTROL_IRQ_ENABLE))
+        ops->irq(ctx);
+}
+
+/*
+ * Execute a DMA_START and post its result, as pcie_sim_mmio_update_dma() does
+ */
+static void pcie_sim_bar0_dma(struct pcie_sim_bar0 *bar0,
+                              const struct pcie_sim_bar0_ops *ops, void *ctx)
+{
+    uint32_t dma_control = bar0->regs[PCIE_SIM_REG_DMA_CONTROL / 4];
+    uint64_t addr = ((uint64_t)bar0->regs[PCIE_SIM_REG_DMA_ADDR_HI / 4] << 32) |
+                    bar0->regs[PCIE_SIM_REG_DMA_ADDR_LO / 4];
+    uint32_t size = bar0->regs[PCIE_SIM_REG_DMA_SIZE / 4];
+    uint32_t direction = (dma_control & PCIE_SIM_DMA_CONTROL_DIRECTION) ?
+                         PCIE_SIM_FROM_DEVICE : PCIE_SIM_TO_DEVICE;
+    uint64_t latency = 0;
+    int success = 0;
+
+    if (!(dma_control & PCIE_SIM_DMA_CONTROL_ENABLE))
+        return;
+
+    bar0->dma_active = 1;
+
+    /* Injected faults fail every Nth DMA */
+    if (!(bar0->simulate_errors &&
+          ++bar0->dma_count % bar0->fault_injection_rate == 0))
+        success = size > 0 && ops->dma(ctx, addr, size, direction, &latency) == 0;
+
+    bar0->dma_active = 0;
+
+    bar0->regs[PCIE_SIM_REG_STATUS / 4] &= ~PCIE_SIM_STATUS_DMA_BUSY;
+    if (!success)
+        bar0->regs[PCIE_SIM_REG_STATUS / 4] |= PCIE_SIM_STATUS_ERROR;
+
+    bar0->regs[PCIE_SIM_REG_INTERRUPT_STATUS / 4] |=
+        success ? PCIE_SIM_IRQ_DMA_COMPLETE : PCIE_SIM_IRQ_DMA_ERROR;
+
+    if (success) {
+        struct pcie_sim_stats stats;
+
+        bar0->regs[PCIE_SIM_REG_PERF_LATENCY / 4] = (uint32_t)(latency / 1000);
+        if (ops->stats && ops->stats(ctx, &stats) == 0)
+            bar0->regs[PCIE_SIM_REG_PERF_COUNT / 4] = (uint32_t)stats.total_transfers;
+    }
+
+    bar0->pending_interrupts = 1;
+
+    if (dma_control & PCIE_SIM_DMA_CONTROL_INTERRUPT)
+        pcie_sim_bar0_raise_irq(bar0, ops, ctx);
+}
+
+/*
+ * Read a register; the caller has checked pcie_sim_bar0_valid()
+ */
+uint32_t pcie_sim_bar0_read(struct pcie_sim_bar0 *bar0, uint32_t offset,
+                            const struct pcie_sim_bar0_ops *ops, void *ctx)
+{
+    struct pcie_sim_stats stats;
+    uint32_t value;
+
+    /* Uncached reads are ordered behind pending combined writes */
+    pcie_sim_bar0_flush(bar0, ops);
+
+    bar0->stats.reads++;
+    bar0->stats.read_cost_ns += bar0->cost.read_ns;
+    if (offset / 4 < PCIE_SIM_MMIO_TRACKED_REGS)
+        bar0->stats.reg_reads[offset / 4]++;
+
+    value = bar0->regs[offset / 4];
+
+    switch (offset) {
+    case PCIE_SIM_REG_STATUS:
+        value &= ~(PCIE_SIM_STATUS_DMA_BUSY | PCIE_SIM_STATUS_INTERRUPT_PENDING);
+        if (bar0->dma_active)
+            value |= PCIE_SIM_STATUS_DMA_BUSY;
+        if (bar0->pending_interrupts)
+            value |= PCIE_SIM_STATUS_INTERRUPT_PENDING;
+        break;
+
+    case PCIE_SIM_REG_PERF_LATENCY:
+        /* Average latency in microseconds */
+        if (ops->stats && ops->stats(ctx, &stats) == 0)
+            value = (uint32_t)(stats.avg_latency_ns / 1000);
+        break;
+
+    case PCIE_SIM_REG_PERF_COUNT:
+        if (ops->stats && ops->stats(ctx, &stats) == 0)
+            value = (uint32_t)stats.total_transfers;
+        break;
+    }
+
+    pcie_sim_bar0_record(bar0, ops, offset, value, 0, bar0->cost.read_ns);
+    pcie_sim_bar0_charge(bar0, ops, bar0->cost.read_ns);
+
+    return value;
+}
+
+/*
+ * Account a posted write. With write combining, writes to the pending
+ * 64-byte line are merged and only the flush is charged. The register side
+ * effects still happen immediately; only the cost is deferred.
+ */
+static void pcie_sim_bar0_account_write(struct pcie_sim_bar0 *bar0, uint32_t offset,
+                                        uint32_t value, const struct pcie_sim_bar0_ops *ops)
+{
+    uint32_t cost = bar0->cost.write_ns;
+
+    bar0->stats.writes++;
+    if (offset / 4 < PCIE_SIM_MMIO_TRACKED_REGS)
+        bar0->stats.reg_writes[offset / 4]++;
+
+    if (bar0->cost.flags & PCIE_SIM_MMIO_WRITE_COMBINE) {
+        uint32_t line = offset & ~63U;
+
+        cost = 0;
+        if (bar0->wc_pending && bar0->wc_line == line) {
+            bar0->stats.wc_coalesced++;
+        } else {
+            pcie_sim_bar0_flush(bar0, ops);
+            bar0->wc_line = line;
+            bar0->wc_pending = 1;
+        }
+    } else {
+        bar0->stats.write_cost_ns += cost;
+    }
+
+    pcie_sim_bar0_record(bar0, ops, offset, value, 1, cost);
+    pcie_sim_bar0_charge(bar0, ops, cost);
+}
+
+/*
+ * Write a register; the caller has checked pcie_sim_bar0_valid()
+ */
+void pcie_sim_bar0_write(struct pcie_sim_bar0 *bar0, uint32_t offset, uint32_t value,
+                         const struct pcie_sim_bar0_ops *ops, void *ctx)
+{
+    pcie_sim_bar0_account_write(bar0, offset, value, ops);
+
+    if (PCIE_SIM_REG_IS_DOORBELL(offset))
+        bar0->stats.doorbells++;
+
+    switch (offset) {
+    case PCIE_SIM_REG_CONTROL:
+        if (value & PCIE_SIM_CONTROL_DMA_RESET) {
+            bar0->dma_active = 0;
+            value &= ~PCIE_SIM_CONTROL_DMA_RESET;  /* Self-clearing bit */
+        }
+        bar0->regs[offset / 4] = value;
+        if (value & PCIE_SIM_CONTROL_DMA_START)
+            pcie_sim_bar0_dma(bar0, ops, ctx);
+        return;
+
+    case PCIE_SIM_REG_INTERRUPT_STATUS:
+        /* Writing to interrupt status clears the bits */
+        bar0->regs[offset / 4] &= ~value;
+        if (bar0->regs[offset / 4] == 0)
+            bar0->pending_interrupts = 0;
+        return;
+
+    case PCIE_SIM_REG_ERROR_INJECT:
+        /* As in the module, a zero rate disables injection but keeps the rate */
+        if (value & PCIE_SIM_ERROR_INJECT_RATE_MASK) {
+            bar0->fault_injection_rate = value & PCIE_SIM_ERROR_INJECT_RATE_MASK;
+            bar0->simulate_errors = 1;
+        } else {
+            bar0->simulate_errors = 0;
+        }
+        break;
+    }
+
+    bar0->regs[offset / 4] = value;
+}
+
+/*
+ * Fill in the memory footprint of a simulated device of device_size bytes
+ * that embeds a BAR0 and stats_size bytes of its own statistics. The
+ * simulators have no rings, bounce buffers or engine threads.
+ */
+void pcie_sim_bar0_memory(struct pcie_sim_memory_stats *mem, size_t device_size,
+                          size_t stats_size)
+{
+    const struct pcie_sim_bar0 *bar0 = NULL;
+    size_t counters = stats_size + sizeof(bar0->stats) + sizeof(bar0->trace);
+
+    memset(mem, 0, sizeof(*mem));
+    mem->bar_bytes = sizeof(bar0->regs);
+    mem->stats_bytes = counters;
+    mem->device_bytes = device_size - counters - mem->bar_bytes;
+    mem->total_bytes = device_size;
+}
@@ -0,0 +1,100 @@
+/*
+ * PCIe Simulator - BAR0 Register Model
+ *
+ * Copyright (c) 2025 Karan Mamaniya <kmamaniya@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Userspace BAR0 state machine, modeled on kernel/mmio.c so drivers can be
+ * exercised without the kernel module. Register layout, access costs,
+ * status bits, interrupt clearing and error injection match the module.
+ * One difference remains: setting PCIE_SIM_CONTROL_DMA_START here runs the
+ * DMA programmed into the DMA_* registers through the host's dma hook. The
+ * module has no address space to run it in, so there the bit is only
+ * stored and transfers go through the ioctls or the rings.
+ */
+
+#ifndef PCIE_SIM_MMIO_SIM_H
+#define PCIE_SIM_MMIO_SIM_H
+
+#include "../lib/types.h"
+#include "../lib/regs.h"
+#include "../lib/snapshot.h"
+
+/*
+ * Hooks into whatever hosts the register file. ctx is passed through
+ * untouched, so the same BAR0 state can be driven from different
+ * handles (or processes) with different DMA address spaces.
+ */
+struct pcie_sim_bar0_ops {
+    /* Run the DMA programmed into BAR0; returns 0 on success */
+    int (*dma)(void *ctx, uint64_t addr, uint32_t size, uint32_t direction,
+               uint64_t *latency_ns);
+    /* Fetch device statistics for the PERF_* registers */
+    int (*stats)(void *ctx, struct pcie_sim_stats *stats);
+    /* Signal an enabled interrupt; optional */
+    void (*irq)(void *ctx);
+    /* Monotonic clock for the trace and PCIE_SIM_MMIO_STALL; optional */
+    uint64_t (*now_ns)(void);
+};
+
+/* Register accesses kept for pcie_sim_mmio_read_trace() */
+#define PCIE_SIM_BAR0_TRACE_ENTRIES 256
+
+/* BAR0 register file and the internal state behind its side effects */
+struct pcie_sim_bar0 {
+    uint32_t regs[PCIE_SIM_BAR0_SIZE / 4];
+    uint32_t dma_active;
+    uint32_t pending_interrupts;
+    uint32_t simulate_errors;
+    uint32_t fault_injection_rate;
+    uint32_t dma_count;
+
+    /* Cost model and accounting; survive register resets */
+    struct pcie_sim_mmio_config cost;
+    struct pcie_sim_mmio_stats stats;
+    uint32_t wc_line;               /* Offset of the pending WC line */
+    uint32_t wc_pending;
+    uint32_t trace_head;            /* Free running */
+    uint32_t trace_tail;
+    struct pcie_sim_mmio_trace_entry trace[PCIE_SIM_BAR0_TRACE_ENTRIES];
+};
+
+void pcie_sim_bar0_init(struct pcie_sim_bar0 *bar0);
+void pcie_sim_bar0_reset(struct pcie_sim_bar0 *bar0);
+uint32_t pcie_sim_bar0_read(struct pcie_sim_bar0 *bar0, uint32_t offset,
+                            const struct pcie_sim_bar0_ops *ops, void *ctx);
+void pcie_sim_bar0_write(struct pcie_sim_bar0 *bar0, uint32_t offset, uint32_t value,
+                         const struct pcie_sim_bar0_ops *ops, void *ctx);
+void pcie_sim_bar0_flush(struct pcie_sim_bar0 *bar0, const struct pcie_sim_bar0_ops *ops);
+void pcie_sim_bar0_reset_stats(struct pcie_sim_bar0 *bar0);
+size_t pcie_sim_bar0_read_trace(struct pcie_sim_bar0 *bar0,
+                                struct pcie_sim_mmio_trace_entry *entries, size_t max);
+void pcie_sim_bar0_save(const struct pcie_sim_bar0 *bar0, struct pcie_sim_snapshot_writer *w);
+void pcie_sim_bar0_load(struct pcie_sim_bar0 *bar0, const void *snapshot);
+void pcie_sim_bar0_memory(struct pcie_sim_memory_stats *mem, size_t device_size,
+                          size_t stats_size);
+
+/* Offsets must be 32-bit aligned and inside BAR0 */
+static inline int pcie_sim_bar0_valid(uint32_t offset)
+{
+    return offset < PCIE_SIM_BAR0_SIZE && (offset & 3) == 0;
+}
+
+#endif /* PCIE_SIM_MMIO_SIM_H */
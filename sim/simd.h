@@ -0,0 +1,131 @@
+/*
+ * PCIe Simulator - Simulator Daemon Protocol
+ *
+ * Copyright (c) 2025 Karan Mamaniya <kmamaniya@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Wire protocol and shared-memory layout between pcie_simd and its clients.
+ * Clients handshake over a Unix socket, then exchange descriptors through
+ * SPSC rings in a shared memfd and ring eventfd doorbells.
+ */
+
+#ifndef PCIE_SIM_SIMD_H
+#define PCIE_SIM_SIMD_H
+
+#include "../lib/types.h"
+#include <stddef.h>
+
+/* Environment variable naming the daemon socket; unset = in-process model */
+#define SIMD_SOCKET_ENV      "PCIE_SIMD_SOCKET"
+#define SIMD_DEFAULT_SOCKET  "/tmp/pcie_simd.sock"
+
+#define SIMD_MAGIC           0x53494d44  /* "SIMD" */
+#define SIMD_VERSION         5
+
+/* Ring geometry (entries must be a power of two) */
+#define SIMD_RING_ENTRIES    64
+#define SIMD_DATA_SIZE       (1024 * 1024)  /* Matches kernel MAX_TRANSFER_SIZE */
+#define SIMD_CACHELINE       64
+
+/* Descriptor opcodes */
+#define SIMD_OP_TRANSFER     1
+#define SIMD_OP_GET_STATS    2
+#define SIMD_OP_RESET_STATS  3
+#define SIMD_OP_GET_STATS_EX 4
+
+/* Handshake sent by the client right after connect() */
+struct simd_hello {
+    uint32_t magic;
+    uint32_t version;
+    int32_t device_id;
+    uint32_t reserved;
+};
+
+/*
+ * Handshake reply. On success it carries three descriptors as SCM_RIGHTS:
+ * the shared region memfd, the submission doorbell eventfd and the
+ * completion doorbell eventfd.
+ */
+struct simd_welcome {
+    int32_t status;         /* pcie_sim_error_t */
+    uint32_t ring_entries;
+    uint64_t region_size;
+};
+
+/* Submission queue entry, written by the client */
+struct simd_desc {
+    uint32_t opcode;
+    uint32_t direction;
+    uint64_t offset;        /* Into simd_region.data */
+    uint64_t size;
+    uint64_t cookie;
+};
+
+/* Completion queue entry, written by the daemon */
+struct simd_cqe {
+    uint64_t cookie;
+    int32_t status;         /* pcie_sim_error_t */
+    uint32_t reserved;
+    uint64_t latency_ns;
+};
+
+/* Single-producer/single-consumer ring indices, free running */
+struct simd_ring_ctrl {
+    uint32_t head;          /* Written by the producer only */
+    uint8_t pad0[SIMD_CACHELINE - sizeof(uint32_t)];
+    uint32_t tail;          /* Written by the consumer only */
+    uint8_t pad1[SIMD_CACHELINE - sizeof(uint32_t)];
+};
+
+/* Layout of the memfd shared between one client and the daemon */
+struct simd_region {
+    struct simd_ring_ctrl sq;                   /* Client -> daemon */
+    struct simd_ring_ctrl cq;                   /* Daemon -> client */
+    struct simd_desc sq_entries[SIMD_RING_ENTRIES];
+    struct simd_cqe cq_entries[SIMD_RING_ENTRIES];
+    struct pcie_sim_stats stats;                /* SIMD_OP_GET_STATS result */
+    struct pcie_sim_stats_ex stats_ex;          /* SIMD_OP_GET_STATS_EX since_epoch and result */
+    uint64_t epoch;                             /* SIMD_OP_RESET_STATS result */
+    uint8_t data[SIMD_DATA_SIZE] __attribute__((aligned(SIMD_CACHELINE)));
+};
+
+/* Entries currently queued in a ring */
+static inline uint32_t simd_ring_count(struct simd_ring_ctrl *ring)
+{
+    return __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) -
+           __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+}
+
+/* Client-side connection (sim/simd_client.c) */
+struct simd_client;
+
+pcie_sim_error_t simd_client_connect(const char *socket_path, int device_id,
+                                     struct simd_client **client);
+void simd_client_close(struct simd_client *client);
+pcie_sim_error_t simd_client_transfer(struct simd_client *client, void *buffer,
+                                      size_t size, uint32_t direction,
+                                      uint64_t *latency_ns, uint64_t *phase_ns);
+pcie_sim_error_t simd_client_get_stats(struct simd_client *client,
+                                       struct pcie_sim_stats *stats);
+pcie_sim_error_t simd_client_get_stats_ex(struct simd_client *client,
+                                          struct pcie_sim_stats_ex *stats);
+pcie_sim_error_t simd_client_reset_stats(struct simd_client *client, uint64_t *epoch);
+
+#endif /* PCIE_SIM_SIMD_H */
@@ -0,0 +1,412 @@
+/*
+ * PCIe Simulator - Simulator Daemon Client
+ *
+ * Copyright (c) 2025 Karan Mamaniya <kmamaniya@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Client side of the pcie_simd protocol. Used by the Linux backend when
+ * PCIE_SIMD_SOCKET names a running daemon.
+ */
+
+#ifndef _WIN32
+
+#include "simd.h"
+#include "../lib/clock.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+/* How long to wait for the daemon before declaring it gone */
+#define SIMD_CLIENT_TIMEOUT_MS 5000
+
+/* Connection to one device hosted by pcie_simd */
+struct simd_client {
+    int sock;
+    int submit_fd;
+    int complete_fd;
+    struct simd_region *region;
+    size_t region_size;
+    uint64_t next_cookie;
+    int broken;                 /* A descriptor was abandoned in flight */
+    pthread_mutex_t lock;       /* The rings are SPSC; one submitter at a time */
+};
+
+/*
+ * Receive the welcome message and the three descriptors that come with it
+ */
+static int simd_client_recv_welcome(int sock, struct simd_welcome *welcome, int fds[3])
+{
+    char control[CMSG_SPACE(3 * sizeof(int))];
+    struct iovec iov = { welcome, sizeof(*welcome) };
+    struct msghdr msg;
+    struct cmsghdr *cmsg;
+    ssize_t n;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    do {
+        n = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+    } while (n < 0 && errno == EINTR);
+    if (n != (ssize_t)sizeof(*welcome))
+        return -1;
+
+    fds[0] = fds[1] = fds[2] = -1;
+    for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS &&
+            cmsg->cmsg_len == CMSG_LEN(3 * sizeof(int)))
+            memcpy(fds, CMSG_DATA(cmsg), 3 * sizeof(int));
+    }
+
+    return 0;
+}
+
+/*
+ * Connect to the daemon and map the shared rings for one device
+ */
+pcie_sim_error_t simd_client_connect(const char *socket_path, int device_id,
+                                     struct simd_client **client)
+{
+    struct sockaddr_un addr;
+    struct simd_hello hello;
+    struct simd_welcome welcome;
+    struct simd_client *c;
+    int fds[3];
+    int sock;
+
+    if (!socket_path || !client)
+        return PCIE_SIM_ERROR_PARAM;
+
+    sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (sock < 0)
+        return PCIE_SIM_ERROR_SYSTEM;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, socket_path, sizeof(addr.sun_path) - 1);
+    if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        fprintf(stderr, "pcie_sim: cannot reach pcie_simd at %s: %s\n",
+                socket_path, strerror(errno));
+        close(sock);
+        return PCIE_SIM_ERROR_DEVICE;
+    }
+
+    memset(&hello, 0, sizeof(hello));
+    hello.magic = SIMD_MAGIC;
+    hello.version = SIMD_VERSION;
+    hello.device_id = device_id;
+    if (send(sock, &hello, sizeof(hello), MSG_NOSIGNAL) != (ssize_t)sizeof(hello) ||
+        simd_client_recv_welcome(sock, &welcome, fds) != 0) {
+        close(sock);
+        return PCIE_SIM_ERROR_DEVICE;
+    }
+
+    if (welcome.status != PCIE_SIM_SUCCESS) {
+        close(sock);
+        return (pcie_sim_error_t)welcome.status;
+    }
+
+    if (fds[0] < 0 || fds[1] < 0 || fds[2] < 0 ||
+        welcome.ring_entries != SIMD_RING_ENTRIES ||
+        welcome.region_size != sizeof(struct simd_region))
+        goto err_fds;
+
+    c = calloc(1, sizeof(*c));
+    if (!c)
+        goto err_fds;
+
+    c->region = mmap(NULL, sizeof(struct simd_region), PROT_READ | PROT_WRITE,
+                     MAP_SHARED, fds[0], 0);
+    close(fds[0]);
+    if (c->region == MAP_FAILED) {
+        free(c);
+        close(fds[1]);
+        close(fds[2]);
+        close(sock);
+        return PCIE_SIM_ERROR_MEMORY;
+    }
+
+    c->sock = sock;
+    c->submit_fd = fds[1];
+    c->complete_fd = fds[2];
+    c->region_size = sizeof(struct simd_region);
+    pthread_mutex_init(&c->lock, NULL);
+
+    *client = c;
+    return PCIE_SIM_SUCCESS;
+
+err_fds:
+    for (int i = 0; i < 3; i++)
+        if (fds[i] >= 0)
+            close(fds[i]);
+    close(sock);
+    return PCIE_SIM_ERROR_DEVICE;
+}
+
+/*
+ * Disconnect; the daemon notices the hangup and tears down its engine
+ */
+void simd_client_close(struct simd_client *client)
+{
+    if (!client)
+        return;
+
+    munmap(client->region, client->region_size);
+    close(client->submit_fd);
+    close(client->complete_fd);
+    close(client->sock);
+    pthread_mutex_destroy(&client->lock);
+    free(client);
+}
+
+/*
+ * Post one descriptor and wait for its completion. Caller holds client->lock.
+ *
+ * A descriptor given up on is still owned by the daemon, which may yet
+ * touch the data area and post its completion. Nothing later on the
+ * connection could be trusted, so the client is marked broken and fails
+ * every further request; the caller reopens the device.
+ */
+static pcie_sim_error_t simd_client_submit(struct simd_client *client,
+                                           const struct simd_desc *desc,
+                                           struct simd_cqe *cqe)
+{
+    struct simd_region *r = client->region;
+    struct pollfd pfd[2];
+    uint64_t value = 1;
+    uint32_t head, tail;
+
+    if (client->broken)
+        return PCIE_SIM_ERROR_DEVICE;
+
+    /* Synchronous callers keep at most one descriptor in flight, so the
+     * submission ring always has room */
+    head = r->sq.head;
+    r->sq_entries[head & (SIMD_RING_ENTRIES - 1)] = *desc;
+    __atomic_store_n(&r->sq.head, head + 1, __ATOMIC_RELEASE);
+
+    if (write(client->submit_fd, &value, sizeof(value)) != sizeof(value)) {
+        client->broken = 1;
+        return PCIE_SIM_ERROR_SYSTEM;
+    }
+
+    pfd[0].fd = client->complete_fd;
+    pfd[0].events = POLLIN;
+    pfd[1].fd = client->sock;
+    pfd[1].events = POLLIN;
+
+    tail = r->cq.tail;
+    while (__atomic_load_n(&r->cq.head, __ATOMIC_ACQUIRE) == tail) {
+        int n = poll(pfd, 2, SIMD_CLIENT_TIMEOUT_MS);
+
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0) {
+            client->broken = 1;
+            return PCIE_SIM_ERROR_TIMEOUT;
+        }
+        if (pfd[1].revents & (POLLIN | POLLHUP | POLLERR)) {
+            client->broken = 1;
+            return PCIE_SIM_ERROR_DEVICE;   /* Daemon went away */
+        }
+        if (pfd[0].revents & POLLIN)
+            (void)!read(client->complete_fd, &value, sizeof(value));
+    }
+
+    *cqe = r->cq_entries[tail & (SIMD_RING_ENTRIES - 1)];
+    __atomic_store_n(&r->cq.tail, tail + 1, __ATOMIC_RELEASE);
+
+    if (cqe->cookie != desc->cookie) {
+        client->broken = 1;
+        return PCIE_SIM_ERROR_DEVICE;
+    }
+
+    return PCIE_SIM_SUCCESS;
+}
+
+/*
+ * Transfer through the daemon, staging data in the shared data area. In
+ * the phase times, staging is the copy in or out, the daemon's device
+ * latency the wire time and the rest of the round trip the queue wait.
+ */
+pcie_sim_error_t simd_client_transfer(struct simd_client *client, void *buffer,
+                                      size_t size, uint32_t direction,
+                                      uint64_t *latency_ns, uint64_t *phase_ns)
+{
+    uint64_t t0, t1, t2, t3;
+    struct simd_desc desc;
+    struct simd_cqe cqe;
+    pcie_sim_error_t ret;
+
+    if (!client || !buffer || size == 0 || size > SIMD_DATA_SIZE)
+        return PCIE_SIM_ERROR_PARAM;
+
+    pthread_mutex_lock(&client->lock);
+
+    /* An abandoned transfer may still be using the data area */
+    if (client->broken) {
+        pthread_mutex_unlock(&client->lock);
+        return PCIE_SIM_ERROR_DEVICE;
+    }
+
+    t0 = pcie_sim_clock_ticks();
+    if (direction == PCIE_SIM_TO_DEVICE)
+        memcpy(client->region->data, buffer, size);
+    t1 = pcie_sim_clock_ticks();
+
+    memset(&desc, 0, sizeof(desc));
+    desc.opcode = SIMD_OP_TRANSFER;
+    desc.direction = direction;
+    desc.offset = 0;
+    desc.size = size;
+    desc.cookie = ++client->next_cookie;
+
+    ret = simd_client_submit(client, &desc, &cqe);
+    if (ret == PCIE_SIM_SUCCESS)
+        ret = (pcie_sim_error_t)cqe.status;
+    t2 = pcie_sim_clock_ticks();
+
+    if (ret == PCIE_SIM_SUCCESS && direction == PCIE_SIM_FROM_DEVICE)
+        memcpy(buffer, client->region->data, size);
+    t3 = pcie_sim_clock_ticks();
+
+    pthread_mutex_unlock(&client->lock);
+
+    if (ret == PCIE_SIM_SUCCESS && latency_ns)
+        *latency_ns = cqe.latency_ns;
+    if (ret == PCIE_SIM_SUCCESS && phase_ns) {
+        memset(phase_ns, 0, PCIE_SIM_PHASES * sizeof(*phase_ns));
+        phase_ns[PCIE_SIM_PHASE_COPY_IN] = pcie_sim_clock_to_ns(t1 - t0);
+        phase_ns[PCIE_SIM_PHASE_QUEUE] = pcie_sim_phase_ns(cqe.latency_ns,
+                                                           pcie_sim_clock_to_ns(t2 - t1));
+        phase_ns[PCIE_SIM_PHASE_WIRE] = cqe.latency_ns;
+        phase_ns[PCIE_SIM_PHASE_COPY_OUT] = pcie_sim_clock_to_ns(t3 - t2);
+    }
+
+    return ret;
+}
+
+/*
+ * Fetch the daemon-side device statistics
+ */
+pcie_sim_error_t simd_client_get_stats(struct simd_client *client,
+                                       struct pcie_sim_stats *stats)
+{
+    struct simd_desc desc;
+    struct simd_cqe cqe;
+    pcie_sim_error_t ret;
+
+    if (!client || !stats)
+        return PCIE_SIM_ERROR_PARAM;
+
+    pthread_mutex_lock(&client->lock);
+
+    memset(&desc, 0, sizeof(desc));
+    desc.opcode = SIMD_OP_GET_STATS;
+    desc.cookie = ++client->next_cookie;
+
+    ret = simd_client_submit(client, &desc, &cqe);
+    if (ret == PCIE_SIM_SUCCESS)
+        ret = (pcie_sim_error_t)cqe.status;
+    if (ret == PCIE_SIM_SUCCESS)
+        *stats = client->region->stats;
+
+    pthread_mutex_unlock(&client->lock);
+    return ret;
+}
+
+/*
+ * Fetch the daemon-side extended statistics; the daemon fills its whole
+ * structure and the caller gets as much as it asked for
+ */
+pcie_sim_error_t simd_client_get_stats_ex(struct simd_client *client,
+                                          struct pcie_sim_stats_ex *stats)
+{
+    struct simd_desc desc;
+    struct simd_cqe cqe;
+    pcie_sim_error_t ret;
+    uint32_t size;
+
+    if (!client || !stats)
+        return PCIE_SIM_ERROR_PARAM;
+
+    pthread_mutex_lock(&client->lock);
+
+    client->region->stats_ex.since_epoch =
+        pcie_sim_stats_ex_since(stats, pcie_sim_stats_ex_size(stats->hdr.size));
+
+    memset(&desc, 0, sizeof(desc));
+    desc.opcode = SIMD_OP_GET_STATS_EX;
+    desc.cookie = ++client->next_cookie;
+
+    ret = simd_client_submit(client, &desc, &cqe);
+    if (ret == PCIE_SIM_SUCCESS)
+        ret = (pcie_sim_error_t)cqe.status;
+    if (ret == PCIE_SIM_SUCCESS) {
+        size = pcie_sim_stats_ex_size(stats->hdr.size);
+        if (size > client->region->stats_ex.hdr.size)
+            size = client->region->stats_ex.hdr.size;
+        memcpy(stats, &client->region->stats_ex, size);
+        stats->hdr.size = size;
+    }
+
+    pthread_mutex_unlock(&client->lock);
+    return ret;
+}
+
+/*
+ * Reset the daemon-side device statistics and report the new epoch
+ */
+pcie_sim_error_t simd_client_reset_stats(struct simd_client *client, uint64_t *epoch)
+{
+    struct simd_desc desc;
+    struct simd_cqe cqe;
+    pcie_sim_error_t ret;
+
+    if (!client || !epoch)
+        return PCIE_SIM_ERROR_PARAM;
+
+    pthread_mutex_lock(&client->lock);
+
+    memset(&desc, 0, sizeof(desc));
+    desc.opcode = SIMD_OP_RESET_STATS;
+    desc.cookie = ++client->next_cookie;
+
+    ret = simd_client_submit(client, &desc, &cqe);
+    if (ret == PCIE_SIM_SUCCESS)
+        ret = (pcie_sim_error_t)cqe.status;
+    if (ret == PCIE_SIM_SUCCESS)
+        *epoch = client->region->epoch;
+
+    pthread_mutex_unlock(&client->lock);
+    return ret;
+}
+
+#endif /* !_WIN32 */
@@ -28,6 +28,9 @@
 #ifdef _WIN32
 
 #include "api.h"
+#include "backend.h"
+#include "mmio_sim.h"
+#include "clock.h"
 #include <windows.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -44,9 +47,13 @@
 struct windows_device_state {
     BOOL active;
     HANDLE mutex;
-    struct pcie_sim_stats stats;
-    LARGE_INTEGER frequency;
+    struct pcie_sim_stats_page stats;           /* Current epoch, read lock-free too */
+    struct pcie_sim_transfer_stats stats_prev;  /* Final counters of epoch - 1 */
+    struct pcie_sim_latency_sq stats_prev_sq;
+    struct pcie_sim_phase_stats phases[PCIE_SIM_PHASES];    /* Current epoch */
     char device_name[64];
+    CRITICAL_SECTION mmio_lock;     /* Serializes BAR0 accesses */
+    struct pcie_sim_bar0 bar0;
 };
 
 /* Global device state array */
@@ -69,22 +76,23 @@ static int windows_sim_init(void)
             /* Cleanup on failure */
             for (int j = 0; j < i; j++) {
                 CloseHandle(g_devices[j].mutex);
+                DeleteCriticalSection(&g_devices[j].mmio_lock);
             }
             DeleteCriticalSection(&g_global_lock);
             return -1;
         }
 
         /* Initialize statistics */
-        memset(&g_devices[i].stats, 0, sizeof(g_devices[i].stats));
-        g_devices[i].stats.min_latency_ns = UINT64_MAX;
-
-        /* Get high-resolution timer frequency */
-        if (!QueryPerformanceFrequency(&g_devices[i].frequency)) {
-            g_devices[i].frequency.QuadPart = 1000000; /* Fallback to microsecond resolution */
-        }
+        pcie_sim_stats_page_init(&g_devices[i].stats);
+        memset(&g_devices[i].stats_prev, 0, sizeof(g_devices[i].stats_prev));
+        memset(&g_devices[i].stats_prev_sq, 0, sizeof(g_devices[i].stats_prev_sq));
+        memset(g_devices[i].phases, 0, sizeof(g_devices[i].phases));
 
         snprintf(g_devices[i].device_name, sizeof(g_devices[i].device_name),
                 "\\\\.\\PCIeSimulator%d", i);
+
+        InitializeCriticalSection(&g_devices[i].mmio_lock);
+        pcie_sim_bar0_init(&g_devices[i].bar0);
     }
 
     g_initialized = TRUE;
@@ -103,6 +111,7 @@ static void windows_sim_cleanup(void)
         if (g_devices[i].mutex) {
             CloseHandle(g_devices[i].mutex);
             g_devices[i].mutex = NULL;
+            DeleteCriticalSection(&g_devices[i].mmio_lock);
         }
         g_devices[i].active = FALSE;
     }
@@ -112,19 +121,6 @@ static void windows_sim_cleanup(void)
     DeleteCriticalSection(&g_global_lock);
 }
 
-/* Get high-resolution timestamp in nanoseconds */
-static uint64_t get_timestamp_ns(struct windows_device_state *dev)
-{
-    LARGE_INTEGER counter;
-    if (!QueryPerformanceCounter(&counter)) {
-        /* Fallback to GetTickCount64 if high-res timer fails */
-        return GetTickCount64() * 1000000ULL; /* Convert ms to ns */
-    }
-
-    /* Convert to nanoseconds */
-    return (counter.QuadPart * 1000000000ULL) / dev->frequency.QuadPart;
-}
-
 /* Simulate transfer latency with realistic delay */
 static void simulate_transfer_delay(uint32_t size)
 {
@@ -137,24 +133,7 @@ static void simulate_transfer_delay(uint32_t size)
 
     uint32_t total_delay_us = base_delay_us + throughput_delay_us;
 
-    /* Use Windows Sleep for millisecond delays, busy wait for microseconds */
-    if (total_delay_us >= 1000) {
-        Sleep(total_delay_us / 1000);
-        total_delay_us %= 1000;
-    }
-
-    if (total_delay_us > 0) {
-        /* Busy wait for sub-millisecond precision */
-        LARGE_INTEGER start, current, freq;
-        QueryPerformanceFrequency(&freq);
-        QueryPerformanceCounter(&start);
-
-        LONGLONG target_ticks = (total_delay_us * freq.QuadPart) / 1000000;
-
-        do {
-            QueryPerformanceCounter(&current);
-        } while ((current.QuadPart - start.QuadPart) < target_ticks);
-    }
+    pcie_sim_delay_ns(total_delay_us * 1000ULL);
 }
 
 /* Windows implementation of pcie_sim_open */
@@ -177,6 +156,7 @@ pcie_sim_error_t pcie_sim_open_impl(int device_id, pcie_sim_handle_t *handle)
 
     /* Mark device as active */
     g_devices[device_id].active = TRUE;
+    pcie_sim_bar0_init(&g_devices[device_id].bar0);
 
     LeaveCriticalSection(&g_global_lock);
 
@@ -213,11 +193,17 @@ pcie_sim_error_t pcie_sim_close_impl(pcie_sim_handle_t handle)
     return PCIE_SIM_SUCCESS;
 }
 
-/* Windows implementation of pcie_sim_transfer */
-pcie_sim_error_t pcie_sim_transfer_impl(pcie_sim_handle_t handle, void *buffer,
-                                       size_t size, uint32_t direction,
-                                       uint64_t *latency_ns)
+/*
+ * Simulated transfer. Waiting for the device mutex is queue wait; reading
+ * the caller's data is the copy in, filling it the copy out, and the
+ * modeled delay the wire time.
+ */
+static pcie_sim_error_t windows_sim_transfer(pcie_sim_handle_t handle, void *buffer,
+                                             size_t size, uint32_t direction,
+                                             uint64_t *latency_ns, uint64_t *phase_ns)
 {
+    uint64_t phases[PCIE_SIM_PHASES] = { 0 };
+
     if (!handle || !buffer || size == 0 || size > (1024 * 1024))
         return PCIE_SIM_ERROR_PARAM;
 
@@ -231,11 +217,14 @@ pcie_sim_error_t pcie_sim_transfer_impl(pcie_sim_handle_t handle, void *buffer,
     if (!dev->active)
         return PCIE_SIM_ERROR_DEVICE;
 
+    uint64_t submit_time = pcie_sim_clock_ticks();
+
     /* Lock device for transfer */
     if (WaitForSingleObject(dev->mutex, 5000) != WAIT_OBJECT_0)
         return PCIE_SIM_ERROR_TIMEOUT;
 
-    uint64_t start_time = get_timestamp_ns(dev);
+    uint64_t start_time = pcie_sim_clock_ticks();
+    phases[PCIE_SIM_PHASE_QUEUE] = pcie_sim_clock_to_ns(start_time - submit_time);
 
     /* Simulate the transfer operation */
     if (direction == PCIE_SIM_TO_DEVICE) {
@@ -252,37 +241,51 @@ pcie_sim_error_t pcie_sim_transfer_impl(pcie_sim_handle_t handle, void *buffer,
         memset(buffer, 0xAA, size); /* Fill with test pattern */
     }
 
+    uint64_t wire_time = pcie_sim_clock_ticks();
+    phases[direction == PCIE_SIM_TO_DEVICE ? PCIE_SIM_PHASE_COPY_IN : PCIE_SIM_PHASE_COPY_OUT] =
+        pcie_sim_clock_to_ns(wire_time - start_time);
+
     /* Simulate realistic transfer delay */
     simulate_transfer_delay((uint32_t)size);
 
-    uint64_t end_time = get_timestamp_ns(dev);
-    uint64_t transfer_latency = end_time - start_time;
+    uint64_t end_time = pcie_sim_clock_ticks();
+    uint64_t transfer_latency = pcie_sim_clock_to_ns(end_time - start_time);
+    phases[PCIE_SIM_PHASE_WIRE] = pcie_sim_clock_to_ns(end_time - wire_time);
 
     /* Update statistics */
-    dev->stats.total_transfers++;
-    dev->stats.total_bytes += size;
-
-    if (transfer_latency < dev->stats.min_latency_ns)
-        dev->stats.min_latency_ns = transfer_latency;
-    if (transfer_latency > dev->stats.max_latency_ns)
-        dev->stats.max_latency_ns = transfer_latency;
-
-    /* Update running average */
-    if (dev->stats.total_transfers == 1) {
-        dev->stats.avg_latency_ns = transfer_latency;
-    } else {
-        dev->stats.avg_latency_ns =
-            (dev->stats.avg_latency_ns * (dev->stats.total_transfers - 1) + transfer_latency) /
-            dev->stats.total_transfers;
-    }
+    pcie_sim_stats_page_begin(&dev->stats);
+    pcie_sim_stats_page_account(&dev->stats, direction, size, transfer_latency);
+    pcie_sim_stats_page_end(&dev->stats);
+    pcie_sim_stats_phases(dev->phases, phases);
 
     if (latency_ns)
         *latency_ns = transfer_latency;
+    if (phase_ns)
+        memcpy(phase_ns, phases, sizeof(phases));
 
     ReleaseMutex(dev->mutex);
     return PCIE_SIM_SUCCESS;
 }
 
+/* Windows implementation of pcie_sim_transfer */
+pcie_sim_error_t pcie_sim_transfer_impl(pcie_sim_handle_t handle, void *buffer,
+                                       size_t size, uint32_t direction,
+                                       uint64_t *latency_ns)
+{
+    return windows_sim_transfer(handle, buffer, size, direction, latency_ns, NULL);
+}
+
+/* Windows implementation of pcie_sim_transfer_ex */
+pcie_sim_error_t pcie_sim_transfer_ex_impl(pcie_sim_handle_t handle, void *buffer,
+                                          size_t size, uint32_t direction,
+                                          uint64_t *latency_ns, uint64_t *phase_ns)
+{
+    if (!phase_ns)
+        return PCIE_SIM_ERROR_PARAM;
+
+    return windows_sim_transfer(handle, buffer, size, direction, latency_ns, phase_ns);
+}
+
 /* Windows implementation of pcie_sim_get_stats */
 pcie_sim_error_t pcie_sim_get_stats_impl(pcie_sim_handle_t handle,
                                          struct pcie_sim_stats *stats)
@@ -304,16 +307,92 @@ pcie_sim_error_t pcie_sim_get_stats_impl(pcie_sim_handle_t handle,
     if (WaitForSingleObject(dev->mutex, 1000) != WAIT_OBJECT_0)
         return PCIE_SIM_ERROR_TIMEOUT;
 
-    *stats = dev->stats;
+    pcie_sim_stats_summary(&dev->stats.xfer, &dev->stats.latency_sq, stats);
+
+    ReleaseMutex(dev->mutex);
+    return PCIE_SIM_SUCCESS;
+}
+
+/* Windows implementation of pcie_sim_get_stats_ex; no rings, so no queue stats */
+pcie_sim_error_t pcie_sim_get_stats_ex_impl(pcie_sim_handle_t handle,
+                                            struct pcie_sim_stats_ex *stats)
+{
+    struct pcie_sim_stats_ex ex;
+    uint32_t size;
+
+    if (!handle || !stats)
+        return PCIE_SIM_ERROR_PARAM;
+
+    size = pcie_sim_stats_ex_size(stats->hdr.size);
+    if (!size)
+        return PCIE_SIM_ERROR_PARAM;
+
+    struct pcie_sim_handle *h = (struct pcie_sim_handle *)handle;
+
+    if (h->device_id < 0 || h->device_id >= MAX_DEVICES)
+        return PCIE_SIM_ERROR_PARAM;
+
+    struct windows_device_state *dev = &g_devices[h->device_id];
+
+    if (!dev->active)
+        return PCIE_SIM_ERROR_DEVICE;
+
+    if (WaitForSingleObject(dev->mutex, 1000) != WAIT_OBJECT_0)
+        return PCIE_SIM_ERROR_TIMEOUT;
+
+    memset(&ex, 0, sizeof(ex));
+    ex.since_epoch = pcie_sim_stats_ex_since(stats, size);
+    if (pcie_sim_stats_since(&dev->stats, &dev->stats_prev, &dev->stats_prev_sq,
+                             ex.since_epoch, &ex.xfer, &ex.latency_sq) != 0) {
+        ReleaseMutex(dev->mutex);
+        return PCIE_SIM_ERROR_PARAM;
+    }
+    ex.epoch = dev->stats.epoch;
+    ex.prev = dev->stats_prev;
+    ex.prev_latency_sq = dev->stats_prev_sq;
+    memcpy(ex.phases, dev->phases, sizeof(ex.phases));
 
     ReleaseMutex(dev->mutex);
+
+    if (!ex.since_epoch)
+        ex.since_epoch = ex.epoch;
+    ex.hdr.size = size;
+    ex.hdr.version = PCIE_SIM_STATS_VERSION;
+    memcpy(stats, &ex, size);
+    return PCIE_SIM_SUCCESS;
+}
+
+/* Windows implementation of pcie_sim_stats_map */
+pcie_sim_error_t pcie_sim_stats_map_impl(pcie_sim_handle_t handle,
+                                         const struct pcie_sim_stats_page **page)
+{
+    if (!handle || !page)
+        return PCIE_SIM_ERROR_PARAM;
+
+    struct pcie_sim_handle *h = (struct pcie_sim_handle *)handle;
+
+    if (h->device_id < 0 || h->device_id >= MAX_DEVICES)
+        return PCIE_SIM_ERROR_PARAM;
+
+    if (!g_devices[h->device_id].active)
+        return PCIE_SIM_ERROR_DEVICE;
+
+    *page = &g_devices[h->device_id].stats;
     return PCIE_SIM_SUCCESS;
 }
 
 /* Windows implementation of pcie_sim_reset_stats */
 pcie_sim_error_t pcie_sim_reset_stats_impl(pcie_sim_handle_t handle)
 {
-    if (!handle)
+    uint64_t epoch;
+
+    return pcie_sim_reset_stats_epoch_impl(handle, &epoch);
+}
+
+/* Windows implementation of pcie_sim_reset_stats_epoch */
+pcie_sim_error_t pcie_sim_reset_stats_epoch_impl(pcie_sim_handle_t handle, uint64_t *epoch)
+{
+    if (!handle || !epoch)
         return PCIE_SIM_ERROR_PARAM;
 
     struct pcie_sim_handle *h = (struct pcie_sim_handle *)handle;
@@ -330,17 +409,299 @@ pcie_sim_error_t pcie_sim_reset_stats_impl(pcie_sim_handle_t handle)
     if (WaitForSingleObject(dev->mutex, 1000) != WAIT_OBJECT_0)
         return PCIE_SIM_ERROR_TIMEOUT;
 
-    memset(&dev->stats, 0, sizeof(dev->stats));
-    dev->stats.min_latency_ns = UINT64_MAX;
+    pcie_sim_stats_page_begin(&dev->stats);
+    pcie_sim_stats_new_epoch(&dev->stats, &dev->stats_prev, &dev->stats_prev_sq);
+    pcie_sim_stats_page_end(&dev->stats);
+    memset(dev->phases, 0, sizeof(dev->phases));
+    *epoch = dev->stats.epoch;
 
     ReleaseMutex(dev->mutex);
     return PCIE_SIM_SUCCESS;
 }
 
+/* BAR0 hooks: DMA addresses are pointers in the calling process */
+static int windows_sim_bar0_dma(void *ctx, uint64_t addr, uint32_t size,
+                                uint32_t direction, uint64_t *latency_ns)
+{
+    return pcie_sim_transfer_impl(ctx, (void *)(uintptr_t)addr, size,
+                                  direction, latency_ns) == PCIE_SIM_SUCCESS ? 0 : -1;
+}
+
+static int windows_sim_bar0_stats(void *ctx, struct pcie_sim_stats *stats)
+{
+    return pcie_sim_get_stats_impl(ctx, stats) == PCIE_SIM_SUCCESS ? 0 : -1;
+}
+
+static const struct pcie_sim_bar0_ops windows_sim_bar0_ops = {
+    windows_sim_bar0_dma,
+    windows_sim_bar0_stats,
+    NULL,
+    pcie_sim_clock_now_ns,
+};
+
+/* Validate a handle for register access and lock its BAR0 */
+static pcie_sim_error_t windows_sim_bar0_lock(pcie_sim_handle_t handle,
+                                              struct windows_device_state **dev)
+{
+    if (!handle)
+        return PCIE_SIM_ERROR_PARAM;
+
+    struct pcie_sim_handle *h = (struct pcie_sim_handle *)handle;
+
+    if (h->device_id < 0 || h->device_id >= MAX_DEVICES)
+        return PCIE_SIM_ERROR_PARAM;
+
+    *dev = &g_devices[h->device_id];
+
+    if (!(*dev)->active)
+        return PCIE_SIM_ERROR_DEVICE;
+
+    EnterCriticalSection(&(*dev)->mmio_lock);
+    return PCIE_SIM_SUCCESS;
+}
+
+/* Windows implementation of pcie_sim_mmio_read32 */
+pcie_sim_error_t pcie_sim_mmio_read32_impl(pcie_sim_handle_t handle,
+                                           uint32_t offset, uint32_t *value)
+{
+    struct windows_device_state *dev;
+    pcie_sim_error_t ret;
+
+    if (!value)
+        return PCIE_SIM_ERROR_PARAM;
+
+    if (!pcie_sim_bar0_valid(offset)) {
+        *value = 0xFFFFFFFF;
+        return PCIE_SIM_ERROR_PARAM;
+    }
+
+    ret = windows_sim_bar0_lock(handle, &dev);
+    if (ret != PCIE_SIM_SUCCESS)
+        return ret;
+    *value = pcie_sim_bar0_read(&dev->bar0, offset, &windows_sim_bar0_ops, handle);
+    LeaveCriticalSection(&dev->mmio_lock);
+
+    return PCIE_SIM_SUCCESS;
+}
+
+/* Windows implementation of pcie_sim_mmio_write32 */
+pcie_sim_error_t pcie_sim_mmio_write32_impl(pcie_sim_handle_t handle,
+                                            uint32_t offset, uint32_t value)
+{
+    struct windows_device_state *dev;
+    pcie_sim_error_t ret;
+
+    if (!pcie_sim_bar0_valid(offset))
+        return PCIE_SIM_ERROR_PARAM;
+
+    ret = windows_sim_bar0_lock(handle, &dev);
+    if (ret != PCIE_SIM_SUCCESS)
+        return ret;
+    pcie_sim_bar0_write(&dev->bar0, offset, value, &windows_sim_bar0_ops, handle);
+    LeaveCriticalSection(&dev->mmio_lock);
+
+    return PCIE_SIM_SUCCESS;
+}
+
+/* Windows implementation of pcie_sim_mmio_flush */
+pcie_sim_error_t pcie_sim_mmio_flush_impl(pcie_sim_handle_t handle)
+{
+    struct windows_device_state *dev;
+    pcie_sim_error_t ret;
+
+    ret = windows_sim_bar0_lock(handle, &dev);
+    if (ret != PCIE_SIM_SUCCESS)
+        return ret;
+    pcie_sim_bar0_flush(&dev->bar0, &windows_sim_bar0_ops);
+    LeaveCriticalSection(&dev->mmio_lock);
+
+    return PCIE_SIM_SUCCESS;
+}
+
+/* Windows implementation of pcie_sim_mmio_configure */
+pcie_sim_error_t pcie_sim_mmio_configure_impl(pcie_sim_handle_t handle,
+                                              const struct pcie_sim_mmio_config *config)
+{
+    struct windows_device_state *dev;
+    pcie_sim_error_t ret;
+
+    if (!config)
+        return PCIE_SIM_ERROR_PARAM;
+
+    ret = windows_sim_bar0_lock(handle, &dev);
+    if (ret != PCIE_SIM_SUCCESS)
+        return ret;
+    pcie_sim_bar0_flush(&dev->bar0, &windows_sim_bar0_ops);
+    dev->bar0.cost = *config;
+    LeaveCriticalSection(&dev->mmio_lock);
+
+    return PCIE_SIM_SUCCESS;
+}
+
+/* Windows implementation of pcie_sim_mmio_get_stats */
+pcie_sim_error_t pcie_sim_mmio_get_stats_impl(pcie_sim_handle_t handle,
+                                              struct pcie_sim_mmio_stats *stats)
+{
+    struct windows_device_state *dev;
+    pcie_sim_error_t ret;
+
+    if (!stats)
+        return PCIE_SIM_ERROR_PARAM;
+
+    ret = windows_sim_bar0_lock(handle, &dev);
+    if (ret != PCIE_SIM_SUCCESS)
+        return ret;
+    *stats = dev->bar0.stats;
+    LeaveCriticalSection(&dev->mmio_lock);
+
+    return PCIE_SIM_SUCCESS;
+}
+
+/* Windows implementation of pcie_sim_mmio_reset_stats */
+pcie_sim_error_t pcie_sim_mmio_reset_stats_impl(pcie_sim_handle_t handle)
+{
+    struct windows_device_state *dev;
+    pcie_sim_error_t ret;
+
+    ret = windows_sim_bar0_lock(handle, &dev);
+    if (ret != PCIE_SIM_SUCCESS)
+        return ret;
+    pcie_sim_bar0_reset_stats(&dev->bar0);
+    LeaveCriticalSection(&dev->mmio_lock);
+
+    return PCIE_SIM_SUCCESS;
+}
+
+/* Windows implementation of pcie_sim_mmio_read_trace */
+pcie_sim_error_t pcie_sim_mmio_read_trace_impl(pcie_sim_handle_t handle,
+                                               struct pcie_sim_mmio_trace_entry *entries,
+                                               size_t max_entries, size_t *count)
+{
+    struct windows_device_state *dev;
+    pcie_sim_error_t ret;
+
+    if (!entries || !count)
+        return PCIE_SIM_ERROR_PARAM;
+
+    ret = windows_sim_bar0_lock(handle, &dev);
+    if (ret != PCIE_SIM_SUCCESS)
+        return ret;
+    *count = pcie_sim_bar0_read_trace(&dev->bar0, entries, max_entries);
+    LeaveCriticalSection(&dev->mmio_lock);
+
+    return PCIE_SIM_SUCCESS;
+}
+
 /* Windows cleanup function - call at program exit */
 void pcie_sim_windows_cleanup(void)
 {
     windows_sim_cleanup();
 }
 
+/* Windows implementation of pcie_sim_snapshot; a NULL buffer only sizes it */
+pcie_sim_error_t pcie_sim_snapshot_impl(pcie_sim_handle_t handle, void *buffer,
+                                        size_t size, size_t *used)
+{
+    struct pcie_sim_snapshot_writer w;
+    struct windows_device_state *dev;
+    struct pcie_sim_stats *stats;
+    void *xfer, *sq;
+    pcie_sim_error_t ret;
+
+    if (!used)
+        return PCIE_SIM_ERROR_PARAM;
+
+    ret = windows_sim_bar0_lock(handle, &dev);
+    if (ret != PCIE_SIM_SUCCESS)
+        return ret;
+
+    if (WaitForSingleObject(dev->mutex, 1000) != WAIT_OBJECT_0) {
+        LeaveCriticalSection(&dev->mmio_lock);
+        return PCIE_SIM_ERROR_TIMEOUT;
+    }
+
+    /* Write-combined data still in flight is not device state yet */
+    pcie_sim_bar0_flush(&dev->bar0, &windows_sim_bar0_ops);
+
+    pcie_sim_snapshot_begin(&w, buffer, size);
+    stats = pcie_sim_snapshot_add(&w, PCIE_SIM_SNAP_STATS, sizeof(*stats));
+    if (stats)
+        pcie_sim_stats_summary(&dev->stats.xfer, &dev->stats.latency_sq, stats);
+    xfer = pcie_sim_snapshot_add(&w, PCIE_SIM_SNAP_TRANSFER_STATS, sizeof(dev->stats.xfer));
+    if (xfer)
+        memcpy(xfer, &dev->stats.xfer, sizeof(dev->stats.xfer));
+    sq = pcie_sim_snapshot_add(&w, PCIE_SIM_SNAP_LATENCY_SQ, sizeof(dev->stats.latency_sq));
+    if (sq)
+        memcpy(sq, &dev->stats.latency_sq, sizeof(dev->stats.latency_sq));
+    pcie_sim_bar0_save(&dev->bar0, &w);
+    *used = pcie_sim_snapshot_end(&w);
+
+    ReleaseMutex(dev->mutex);
+    LeaveCriticalSection(&dev->mmio_lock);
+
+    return !buffer || *used <= size ? PCIE_SIM_SUCCESS : PCIE_SIM_ERROR_MEMORY;
+}
+
+/* Windows implementation of pcie_sim_restore */
+pcie_sim_error_t pcie_sim_restore_impl(pcie_sim_handle_t handle, const void *buffer,
+                                       size_t size)
+{
+    const struct pcie_sim_snapshot_section *s = NULL;
+    struct windows_device_state *dev;
+    pcie_sim_error_t ret;
+
+    if (!buffer || pcie_sim_snapshot_check(buffer, size) != 0)
+        return PCIE_SIM_ERROR_PARAM;
+
+    ret = windows_sim_bar0_lock(handle, &dev);
+    if (ret != PCIE_SIM_SUCCESS)
+        return ret;
+
+    if (WaitForSingleObject(dev->mutex, 1000) != WAIT_OBJECT_0) {
+        LeaveCriticalSection(&dev->mmio_lock);
+        return PCIE_SIM_ERROR_TIMEOUT;
+    }
+
+    /* Full counters, when present, follow and replace the summary */
+    pcie_sim_stats_page_begin(&dev->stats);
+    while ((s = pcie_sim_snapshot_next(buffer, s)) != NULL) {
+        if (s->type == PCIE_SIM_SNAP_STATS) {
+            struct pcie_sim_stats stats;
+
+            pcie_sim_snapshot_copy(&stats, sizeof(stats), s);
+            pcie_sim_stats_from_summary(&dev->stats.xfer, &dev->stats.latency_sq, &stats);
+        } else if (s->type == PCIE_SIM_SNAP_TRANSFER_STATS) {
+            pcie_sim_snapshot_copy(&dev->stats.xfer, sizeof(dev->stats.xfer), s);
+        } else if (s->type == PCIE_SIM_SNAP_LATENCY_SQ) {
+            pcie_sim_snapshot_copy(&dev->stats.latency_sq, sizeof(dev->stats.latency_sq), s);
+        }
+    }
+    pcie_sim_stats_page_end(&dev->stats);
+    pcie_sim_bar0_load(&dev->bar0, buffer);
+
+    ReleaseMutex(dev->mutex);
+    LeaveCriticalSection(&dev->mmio_lock);
+
+    return PCIE_SIM_SUCCESS;
+}
+
+/* Windows implementation of pcie_sim_get_memory_stats */
+pcie_sim_error_t pcie_sim_get_memory_stats_impl(pcie_sim_handle_t handle,
+                                                struct pcie_sim_memory_stats *stats)
+{
+    if (!handle || !stats)
+        return PCIE_SIM_ERROR_PARAM;
+
+    struct pcie_sim_handle *h = (struct pcie_sim_handle *)handle;
+
+    if (h->device_id < 0 || h->device_id >= MAX_DEVICES)
+        return PCIE_SIM_ERROR_PARAM;
+
+    pcie_sim_bar0_memory(stats, sizeof(struct windows_device_state),
+                         sizeof(g_devices[0].stats) + sizeof(g_devices[0].stats_prev) +
+                         sizeof(g_devices[0].stats_prev_sq) +
+                         sizeof(g_devices[0].phases));
+    return PCIE_SIM_SUCCESS;
+}
+
 #endif /* _WIN32 */
\ No newline at end of file
@@ -15,7 +15,8 @@ namespace PCIeSimulator {
 
 CSVLogger::CSVLogger(const std::string& filename)
     : filename_(filename), header_written_(false), record_count_(0),
-      session_start_(std::chrono::high_resolution_clock::now()) {
+      session_start_ticks_(pcie_sim_clock_ticks()),
+      session_start_wall_(std::chrono::system_clock::now()) {
 
     file_.open(filename_, std::ios::out | std::ios::trunc);
     if (!file_.is_open()) {
@@ -41,9 +42,16 @@ void CSVLogger::write_header() {
     }
 }
 
-std::string CSVLogger::format_timestamp(const std::chrono::high_resolution_clock::time_point& tp) const {
-    auto time_t = std::chrono::system_clock::to_time_t(
-        std::chrono::system_clock::now() + (tp - std::chrono::high_resolution_clock::now()));
+std::chrono::system_clock::time_point CSVLogger::wall_time(uint64_t ticks) const {
+    // Records logged before the session started are pinned to its start
+    uint64_t ns = ticks > session_start_ticks_ ?
+        pcie_sim_clock_to_ns(ticks - session_start_ticks_) : 0;
+    return session_start_wall_ + std::chrono::duration_cast<std::chrono::system_clock::duration>(
+        std::chrono::nanoseconds(ns));
+}
+
+std::string CSVLogger::format_timestamp(const std::chrono::system_clock::time_point& tp) const {
+    auto time_t = std::chrono::system_clock::to_time_t(tp);
     auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(tp.time_since_epoch()) % 1000;
 
     std::stringstream ss;
@@ -52,14 +60,13 @@ std::string CSVLogger::format_timestamp(const std::chrono::high_resolution_clock
     return ss.str();
 }
 
-void CSVLogger::log_transfer(const TransferRecord& record) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    if (!file_.is_open()) return;
-
+// Ticks become wall time here, off the transfer path; callers hold mutex_
+void CSVLogger::write_record(const TransferRecord& record) {
+    auto tp = wall_time(record.timestamp);
     auto session_time_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
-        record.timestamp - session_start_).count();
+        tp - session_start_wall_).count();
 
-    file_ << format_timestamp(record.timestamp) << ","
+    file_ << format_timestamp(tp) << ","
           << session_time_ms << ","
           << record.device_id << ","
           << record.transfer_size << ","
@@ -68,7 +75,13 @@ void CSVLogger::log_transfer(const TransferRecord& record) {
           << record.direction << ","
           << record.error_status << ","
           << record.thread_id << std::endl;
+}
+
+void CSVLogger::log_transfer(const TransferRecord& record) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!file_.is_open()) return;
 
+    write_record(record);
     record_count_++;
 }
 
@@ -76,7 +89,7 @@ void CSVLogger::log_transfer(uint32_t device_id, uint32_t transfer_size, double
                            double throughput_mbps, const std::string& direction,
                            const std::string& error_status, uint32_t thread_id) {
     TransferRecord record;
-    record.timestamp = std::chrono::high_resolution_clock::now();
+    record.timestamp = pcie_sim_clock_ticks();
     record.device_id = device_id;
     record.transfer_size = transfer_size;
     record.latency_us = latency_us;
@@ -93,18 +106,7 @@ void CSVLogger::log_transfers(const std::vector<TransferRecord>& records) {
     if (!file_.is_open()) return;
 
     for (const auto& record : records) {
-        auto session_time_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
-            record.timestamp - session_start_).count();
-
-        file_ << format_timestamp(record.timestamp) << ","
-              << session_time_ms << ","
-              << record.device_id << ","
-              << record.transfer_size << ","
-              << std::fixed << std::setprecision(3) << record.latency_us << ","
-              << std::fixed << std::setprecision(2) << record.throughput_mbps << ","
-              << record.direction << ","
-              << record.error_status << ","
-              << record.thread_id << std::endl;
+        write_record(record);
     }
 
     record_count_ += records.size();
@@ -121,7 +123,7 @@ void CSVLogger::log_session_start(const std::string& test_config) {
     std::lock_guard<std::mutex> lock(mutex_);
     if (!file_.is_open()) return;
 
-    file_ << "# Session Start: " << format_timestamp(session_start_) << std::endl;
+    file_ << "# Session Start: " << format_timestamp(session_start_wall_) << std::endl;
     file_ << "# Configuration: " << test_config << std::endl;
     file_ << "# Columns: timestamp, session_time_ms, device_id, transfer_size, "
           << "latency_us, throughput_mbps, direction, error_status, thread_id" << std::endl;
@@ -131,9 +133,9 @@ void CSVLogger::log_session_end(const std::string& summary) {
     std::lock_guard<std::mutex> lock(mutex_);
     if (!file_.is_open()) return;
 
-    auto session_end = std::chrono::high_resolution_clock::now();
+    auto session_end = wall_time(pcie_sim_clock_ticks());
     auto session_duration_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
-        session_end - session_start_).count();
+        session_end - session_start_wall_).count();
 
     file_ << "# Session End: " << format_timestamp(session_end) << std::endl;
     file_ << "# Duration: " << session_duration_ms << " ms" << std::endl;
@@ -16,11 +16,14 @@
 #include <mutex>
 #include <vector>
 #include <memory>
+#include <cstdint>
+
+#include "../lib/clock.h"
 
 namespace PCIeSimulator {
 
 struct TransferRecord {
-    std::chrono::high_resolution_clock::time_point timestamp;
+    uint64_t timestamp;         // pcie_sim_clock_ticks() when the transfer was logged
     uint32_t device_id;
     uint32_t transfer_size;
     double latency_us;
@@ -29,7 +32,7 @@ struct TransferRecord {
     std::string error_status;
     uint32_t thread_id;
 
-    TransferRecord() : device_id(0), transfer_size(0), latency_us(0.0),
+    TransferRecord() : timestamp(0), device_id(0), transfer_size(0), latency_us(0.0),
                       throughput_mbps(0.0), direction("TO_DEVICE"),
                       error_status("SUCCESS"), thread_id(0) {}
 };
@@ -41,10 +44,14 @@ private:
     std::string filename_;
     bool header_written_;
     size_t record_count_;
-    std::chrono::high_resolution_clock::time_point session_start_;
+    // Records carry clock ticks; they become wall time relative to these
+    uint64_t session_start_ticks_;
+    std::chrono::system_clock::time_point session_start_wall_;
 
     void write_header();
-    std::string format_timestamp(const std::chrono::high_resolution_clock::time_point& tp) const;
+    void write_record(const TransferRecord& record);
+    std::chrono::system_clock::time_point wall_time(uint64_t ticks) const;
+    std::string format_timestamp(const std::chrono::system_clock::time_point& tp) const;
 
 public:
     explicit CSVLogger(const std::string& filename);